@@ -0,0 +1,159 @@
+/** @file
+ *
+ * @brief Compile-time field enumeration for aggregate types, using structured
+ * bindings (similar in spirit to Boost PFR).
+ *
+ * The number of fields in an aggregate is computed by attempting aggregate
+ * initialization with an increasing number of "convert to anything" initializers.
+ * Given the field count, a structured binding declaration ties each field into a
+ * @c std::tuple of references, which allows a serialization format to be applied
+ * field by field without any handwritten code per type.
+ *
+ * @note Aggregates with C style array members are not supported, since brace elision
+ * during the aggregate initialization attempts results in an incorrect field count
+ * (a @c std::array member is fine). Aggregates with base classes are not supported.
+ * A maximum of 16 fields is supported.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef AGGREGATE_FIELDS_HPP_INCLUDED
+#define AGGREGATE_FIELDS_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <tuple>
+#include <type_traits> // std::is_aggregate_v, std::remove_cvref_t
+
+namespace chops {
+
+namespace detail {
+
+// only used in unevaluated contexts, converts to a reference of any type
+struct any_init {
+  template <typename T>
+  operator T&() const noexcept;
+};
+
+template <typename T, typename ... Inits>
+consteval std::size_t count_fields() noexcept {
+  if constexpr (requires { T { Inits{}..., any_init{} }; }) {
+    return count_fields<T, Inits..., any_init>();
+  }
+  else {
+    return sizeof...(Inits);
+  }
+}
+
+} // end detail namespace
+
+/**
+ * @brief Maximum number of aggregate fields supported by @c tie_fields.
+ */
+inline constexpr std::size_t max_aggregate_fields = 16u;
+
+/**
+ * @brief Concept for an aggregate type whose fields can be enumerated.
+ */
+template <typename T>
+concept field_enumerable = std::is_aggregate_v<std::remove_cvref_t<T>> &&
+                           !std::is_array_v<std::remove_cvref_t<T>>;
+
+/**
+ * @brief Number of fields in an aggregate type.
+ */
+template <field_enumerable T>
+inline constexpr std::size_t aggregate_field_count = detail::count_fields<std::remove_cvref_t<T>>();
+
+/**
+ * @brief Return a @c std::tuple of references to each field of an aggregate object.
+ *
+ * If the object is @c const, the tuple contains @c const references.
+ *
+ * @param val Aggregate object.
+ *
+ * @return @c std::tuple of references, in declaration order of the fields.
+ *
+ */
+template <field_enumerable T>
+constexpr auto tie_fields(T& val) noexcept {
+  constexpr std::size_t n = aggregate_field_count<T>;
+  static_assert(n <= max_aggregate_fields, "Too many fields in aggregate for tie_fields");
+  if constexpr (n == 0u) {
+    return std::tuple<>{};
+  }
+  else if constexpr (n == 1u) {
+    auto& [f1] = val;
+    return std::tie(f1);
+  }
+  else if constexpr (n == 2u) {
+    auto& [f1, f2] = val;
+    return std::tie(f1, f2);
+  }
+  else if constexpr (n == 3u) {
+    auto& [f1, f2, f3] = val;
+    return std::tie(f1, f2, f3);
+  }
+  else if constexpr (n == 4u) {
+    auto& [f1, f2, f3, f4] = val;
+    return std::tie(f1, f2, f3, f4);
+  }
+  else if constexpr (n == 5u) {
+    auto& [f1, f2, f3, f4, f5] = val;
+    return std::tie(f1, f2, f3, f4, f5);
+  }
+  else if constexpr (n == 6u) {
+    auto& [f1, f2, f3, f4, f5, f6] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6);
+  }
+  else if constexpr (n == 7u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7);
+  }
+  else if constexpr (n == 8u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8);
+  }
+  else if constexpr (n == 9u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9);
+  }
+  else if constexpr (n == 10u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10);
+  }
+  else if constexpr (n == 11u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11);
+  }
+  else if constexpr (n == 12u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12);
+  }
+  else if constexpr (n == 13u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13);
+  }
+  else if constexpr (n == 14u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14);
+  }
+  else if constexpr (n == 15u) {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15);
+  }
+  else {
+    auto& [f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16] = val;
+    return std::tie(f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16);
+  }
+}
+
+} // end namespace
+
+#endif
+
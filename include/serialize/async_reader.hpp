@@ -0,0 +1,488 @@
+/** @file
+ *
+ * @brief Pull-based decoding of values from a stream of bytes that arrives incrementally,
+ * e.g. from a socket, using C++ 20 coroutines.
+ *
+ * An @c async_reader reads from a source into a window of bytes. Reading a value is
+ * awaited, and waits on the source for more bytes only when the buffered bytes do not
+ * hold a complete value, so a protocol is decoded as linear code instead of as a state
+ * machine:
+ * @code
+ *   chops::async_task<bool> session(chops::async_reader<tcp_source, std::endian::big>& rdr) {
+ *     hello h;
+ *     if (co_await rdr.read_framed<std::uint32_t, hello_fmt>(h) != chops::decode_error::none) {
+ *       co_return false;
+ *     }
+ *     for (;;) {
+ *       // ...
+ *     }
+ *   }
+ * @endcode
+ *
+ * When the bytes of a value are already buffered, awaiting a read decodes it directly,
+ * without creating a coroutine, so the cost of a read is only paid when it has to wait.
+ *
+ * Values are decoded in place from the window, there is no copy into a per message buffer.
+ * Bytes are only moved when the unread bytes at the end of the window, i.e. the start of
+ * a partially received value, are moved to the front to make room for more bytes.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef ASYNC_READER_HPP_INCLUDED
+#define ASYNC_READER_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+#include "serialize/extract_append.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint32_t
+#include <coroutine>
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <vector>
+#include <span>
+#include <concepts>
+#include <utility> // std::exchange, std::move, std::forward
+#include <algorithm> // std::max, std::copy
+#include <bit> // std::endian
+#include <cassert>
+
+namespace chops {
+
+/**
+ * @brief A lazily started coroutine producing a value, which can be awaited by another
+ * coroutine, or started and polled from non-coroutine code.
+ *
+ * Awaiting a task starts it, and the awaiting coroutine is resumed when the task
+ * completes. An exception thrown from the task is rethrown from the @c co_await (or from
+ * @c result).
+ *
+ * @tparam T Type of the value returned with @c co_return.
+ *
+ */
+template <std::movable T>
+class [[nodiscard]] async_task {
+public:
+  struct promise_type;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  // whichever of the task completing and the awaiting coroutine suspending happens second
+  // resumes the awaiting coroutine, so a task that completes without waiting does not
+  // nest a stack frame per co_await
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(handle_type h) noexcept {
+      auto& p = h.promise();
+      if (p.m_handoff.exchange(true, std::memory_order_acq_rel)) {
+        p.m_cont.resume();
+      }
+    }
+    void await_resume() const noexcept { }
+  };
+
+  struct promise_type {
+    std::optional<T>        m_val;
+    std::exception_ptr      m_err;
+    std::coroutine_handle<> m_cont;
+    std::atomic<bool>       m_handoff {false};
+
+    async_task get_return_object() noexcept { return async_task(handle_type::from_promise(*this)); }
+    std::suspend_always initial_suspend() const noexcept { return { }; }
+    final_awaiter final_suspend() const noexcept { return { }; }
+    template <std::convertible_to<T> U>
+    void return_value(U&& val) { m_val.emplace(std::forward<U>(val)); }
+    void unhandled_exception() noexcept { m_err = std::current_exception(); }
+  };
+
+private:
+  handle_type m_h;
+
+  explicit async_task(handle_type h) noexcept : m_h(h) { }
+
+public:
+  async_task(async_task&& rhs) noexcept : m_h(std::exchange(rhs.m_h, { })) { }
+  async_task& operator=(async_task&& rhs) noexcept {
+    if (this != &rhs) {
+      if (m_h) {
+        m_h.destroy();
+      }
+      m_h = std::exchange(rhs.m_h, { });
+    }
+    return *this;
+  }
+  ~async_task() {
+    if (m_h) {
+      m_h.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return m_h.done(); }
+  bool await_suspend(std::coroutine_handle<> cont) {
+    m_h.promise().m_cont = cont;
+    m_h.resume();
+    return !m_h.promise().m_handoff.exchange(true, std::memory_order_acq_rel);
+  }
+  T await_resume() { return std::move(result()); }
+
+/**
+ * @brief Run the task from non-coroutine code, until it completes or first waits.
+ */
+  void start() { m_h.resume(); }
+/**
+ * @brief Return @c true if the task has completed.
+ */
+  bool done() const noexcept { return m_h.done(); }
+/**
+ * @brief Return the value of a completed task, rethrowing any exception from the task.
+ */
+  T& result() {
+    assert(m_h.done());
+    if (m_h.promise().m_err) {
+      std::rethrow_exception(m_h.promise().m_err);
+    }
+    return *m_h.promise().m_val;
+  }
+};
+
+/**
+ * @brief Concept for a source of bytes for an @c async_reader.
+ *
+ * @c read_some is passed the free space of the window, and returns an awaitable (e.g. an
+ * @c async_task, or an awaiter that suspends until a socket is readable) that produces the
+ * number of bytes read into the start of the space, zero at the end of the stream.
+ */
+template <typename S>
+concept async_byte_source = requires (S& src, std::span<std::byte> buf) {
+  { src.read_some(buf).await_resume() } -> std::convertible_to<std::size_t>;
+};
+
+namespace detail {
+
+// awaitable that first tries to complete from the bytes already buffered, and only when it
+// has to wait creates the coroutine of the slow path, so no coroutine frame is allocated
+// for values that are already buffered; fast returns an empty optional to wait
+template <typename R, typename Fast, typename Slow>
+class fast_path_awaiter {
+private:
+  Fast                         m_fast;
+  Slow                         m_slow;
+  std::optional<R>             m_res;
+  std::optional<async_task<R>> m_task;
+
+public:
+  fast_path_awaiter(Fast fast, Slow slow) : m_fast(std::move(fast)), m_slow(std::move(slow)) { }
+
+  bool await_ready() {
+    m_res = m_fast();
+    return m_res.has_value();
+  }
+  bool await_suspend(std::coroutine_handle<> cont) {
+    m_task.emplace(m_slow());
+    return m_task->await_suspend(cont);
+  }
+  R await_resume() { return m_res ? std::move(*m_res) : m_task->await_resume(); }
+};
+
+} // end detail namespace
+
+/**
+ * @brief Decode values from a source of bytes, awaiting more bytes whenever the buffered
+ * bytes do not hold a complete value.
+ *
+ * Values are decoded from untrusted input: a value of a fixed size format, or a frame (see
+ * @c marshall_framed), is decoded through a @c read_cursor once all of its bytes are
+ * buffered. A value of a variable size format is first validated (see @c chops::validate),
+ * which needs no allocations, and is validated again after more bytes arrive if it is
+ * incomplete. Once valid it is unmarshalled once. Frames are therefore preferred for large
+ * values that arrive in many small reads.
+ *
+ * @tparam Source Type meeting @c async_byte_source, which must outlive the reader.
+ *
+ * @tparam Endian Endianness of the serialized values.
+ *
+ */
+template <async_byte_source Source, std::endian Endian = std::endian::little>
+class async_reader {
+private:
+  Source&                m_src;
+  std::vector<std::byte> m_buf;
+  std::size_t            m_begin;
+  std::size_t            m_end;
+  std::size_t            m_max;
+  bool                   m_eof;
+
+  // room for at least num_bytes unread bytes, then read once from the source
+  async_task<bool> read_more(std::size_t num_bytes) {
+    if (m_buf.size() - m_begin < num_bytes || m_end == m_buf.size()) {
+      std::copy(m_buf.begin() + static_cast<std::ptrdiff_t>(m_begin),
+                m_buf.begin() + static_cast<std::ptrdiff_t>(m_end), m_buf.begin());
+      m_end -= m_begin;
+      m_begin = 0u;
+      if (m_buf.size() < num_bytes || m_end == m_buf.size()) {
+        m_buf.resize(std::max(num_bytes, m_buf.size() * 2u));
+      }
+    }
+    std::span<std::byte> space(m_buf.data() + m_end, m_buf.size() - m_end);
+    std::size_t n = co_await m_src.read_some(space);
+    assert(n <= space.size());
+    m_end += n;
+    m_eof = (n == 0u);
+    co_return n != 0u;
+  }
+
+  std::span<const std::byte> unread(std::size_t num_bytes) const noexcept {
+    return { m_buf.data() + m_begin, num_bytes };
+  }
+
+  template <typename R, typename Fast, typename Slow>
+  static auto make_awaiter(Fast fast, Slow slow) {
+    return detail::fast_path_awaiter<R, Fast, Slow>(std::move(fast), std::move(slow));
+  }
+
+  // a truncated value is only final once the source has ended
+  std::optional<decode_error> ready(decode_error err) const noexcept {
+    if (err == decode_error::truncated && !m_eof) {
+      return { };
+    }
+    return err;
+  }
+
+  async_task<bool> fill_wait(std::size_t num_bytes) {
+    while (m_end - m_begin < num_bytes) {
+      if (m_eof) {
+        co_return false;
+      }
+      co_await read_more(num_bytes);
+    }
+    co_return true;
+  }
+
+  async_task<bool> at_end_wait() {
+    bool more = co_await fill_wait(1u);
+    co_return !more;
+  }
+
+  template <typename Fmt, typename T>
+  async_task<decode_error> read_wait(T& val) {
+    if constexpr (fixed_size_format<Fmt>) {
+      bool ok = co_await fill_wait(format_traits<Fmt>::fixed_size);
+      if (!ok) {
+        co_return decode_error::truncated;
+      }
+      co_return try_read<Fmt>(val);
+    }
+    else {
+      for (;;) {
+        auto err = try_read<Fmt>(val);
+        if (err != decode_error::truncated || m_eof) {
+          co_return err;
+        }
+        co_await read_more(m_end - m_begin + 1u);
+      }
+    }
+  }
+
+  template <typename CastLen, typename Fmt, typename T>
+  async_task<decode_error> read_framed_wait(T& val) {
+    bool ok = co_await fill_wait(sizeof(CastLen));
+    if (!ok) {
+      co_return decode_error::truncated;
+    }
+    auto len = static_cast<std::size_t>(extract_val<Endian, CastLen>(m_buf.data() + m_begin));
+    if (len > m_max) {
+      co_return decode_error::invalid_value;
+    }
+    ok = co_await fill_wait(sizeof(CastLen) + len);
+    if (!ok) {
+      co_return decode_error::truncated;
+    }
+    co_return try_read_framed<CastLen, Fmt>(val);
+  }
+
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+
+/**
+ * @brief Construct a reader.
+ *
+ * @param src Source of bytes.
+ *
+ * @param buf_size Initial size of the window, which grows as needed for larger values.
+ *
+ * @param max_value_size Largest serialized value (or frame) accepted, so that untrusted
+ * input cannot cause unbounded buffering.
+ */
+  explicit async_reader(Source& src, std::size_t buf_size = 65536u, std::size_t max_value_size = 1u << 24) :
+    m_src(src), m_buf(std::max(buf_size, std::size_t{1u})), m_begin(0u), m_end(0u),
+    m_max(max_value_size), m_eof(false) { }
+
+  async_reader(const async_reader&) = delete;
+  async_reader& operator=(const async_reader&) = delete;
+
+/**
+ * @brief Wait until at least a number of bytes are buffered.
+ *
+ * @return An awaitable producing @c false if the source ends first.
+ */
+  auto fill(std::size_t num_bytes) {
+    return make_awaiter<bool>([this, num_bytes] () -> std::optional<bool> {
+        if (m_end - m_begin >= num_bytes || m_eof) {
+          return m_end - m_begin >= num_bytes;
+        }
+        return { };
+      },
+      [this, num_bytes] { return fill_wait(num_bytes); });
+  }
+
+/**
+ * @brief Return the buffered bytes that have not been consumed.
+ */
+  std::span<const std::byte> buffered() const noexcept { return unread(m_end - m_begin); }
+/**
+ * @brief Consume buffered bytes, e.g. after decoding them directly from @c buffered.
+ */
+  void consume(std::size_t num_bytes) noexcept {
+    assert(num_bytes <= m_end - m_begin);
+    m_begin += num_bytes;
+    if (m_begin == m_end) {
+      m_begin = 0u;
+      m_end = 0u;
+    }
+  }
+
+/**
+ * @brief Wait until a byte is buffered or the source ends.
+ *
+ * @return An awaitable producing @c true if the source has ended and all bytes are
+ * consumed, i.e. the stream ended cleanly between values.
+ */
+  auto at_end() {
+    return make_awaiter<bool>([this] () -> std::optional<bool> {
+        if (m_end != m_begin || m_eof) {
+          return m_end == m_begin;
+        }
+        return { };
+      },
+      [this] { return at_end_wait(); });
+  }
+
+/**
+ * @brief Decode a value from the buffered bytes only, without waiting.
+ *
+ * @return As for @c read, where @c decode_error::truncated means that the value is not
+ * completely buffered (yet). No bytes are consumed on error.
+ */
+  template <typename Fmt, typename T>
+    requires unmarshallable_with<Fmt, read_cursor<Endian>, T> &&
+             unmarshallable_with<Fmt, extract_buffer<Endian>, T>
+  decode_error try_read(T& val) {
+    if constexpr (fixed_size_format<Fmt>) {
+      constexpr auto sz = format_traits<Fmt>::fixed_size;
+      if (m_end - m_begin < sz) {
+        return decode_error::truncated;
+      }
+      read_cursor<Endian> cur(unread(sz));
+      auto err = try_unmarshall<Fmt>(cur, val);
+      if (err == decode_error::none) {
+        consume(sz);
+      }
+      return err;
+    }
+    else {
+      read_cursor<Endian> cur(buffered());
+      auto err = validate<Fmt>(cur);
+      if (err == decode_error::none) {
+        auto sz = static_cast<std::size_t>(cur.data() - (m_buf.data() + m_begin));
+        if (sz > m_max) {
+          return decode_error::invalid_value;
+        }
+        extract_buffer<Endian> src(unread(sz));
+        unmarshall<Fmt>(src, val);
+        consume(sz);
+        return decode_error::none;
+      }
+      if (err == decode_error::truncated && m_end - m_begin > m_max) {
+        return decode_error::invalid_value;
+      }
+      return err;
+    }
+  }
+
+/**
+ * @brief Read a value, waiting for its bytes as needed.
+ *
+ * If the value is already buffered it is decoded when awaited, without creating a
+ * coroutine.
+ *
+ * @return An awaitable producing @c decode_error::none on success,
+ * @c decode_error::truncated if the source ends before the value is complete,
+ * @c decode_error::invalid_value if the value exceeds the maximum value size, otherwise
+ * the first error encountered. No bytes are consumed on error.
+ */
+  template <typename Fmt, typename T>
+    requires unmarshallable_with<Fmt, read_cursor<Endian>, T> &&
+             unmarshallable_with<Fmt, extract_buffer<Endian>, T>
+  auto read(T& val) {
+    return make_awaiter<decode_error>([this, &val] { return ready(try_read<Fmt>(val)); },
+                                      [this, &val] { return read_wait<Fmt>(val); });
+  }
+
+/**
+ * @brief Decode a frame written by @c marshall_framed from the buffered bytes only,
+ * without waiting.
+ *
+ * @return As for @c read_framed, where @c decode_error::truncated also means that the
+ * frame is not completely buffered (yet).
+ */
+  template <std::unsigned_integral CastLen, typename Fmt, typename T>
+    requires unmarshallable_with<Fmt, read_cursor<Endian>, T>
+  decode_error try_read_framed(T& val) {
+    if (m_end - m_begin < sizeof(CastLen)) {
+      return decode_error::truncated;
+    }
+    auto len = static_cast<std::size_t>(extract_val<Endian, CastLen>(m_buf.data() + m_begin));
+    if (len > m_max) {
+      return decode_error::invalid_value;
+    }
+    if (m_end - m_begin < sizeof(CastLen) + len) {
+      return decode_error::truncated;
+    }
+    read_cursor<Endian> cur(unread(sizeof(CastLen) + len));
+    cur.advance(sizeof(CastLen));
+    auto err = try_unmarshall<Fmt>(cur, val);
+    if (err == decode_error::none && cur.remaining() != 0u) {
+      err = decode_error::trailing_bytes;
+    }
+    if (err == decode_error::none) {
+      consume(sizeof(CastLen) + len);
+    }
+    return err;
+  }
+
+/**
+ * @brief Read a frame written by @c marshall_framed, waiting for the length and then for
+ * all of the bytes of the frame before decoding the value.
+ *
+ * @return As for @c read, or @c decode_error::trailing_bytes if the value does not use
+ * all of the bytes of the frame.
+ */
+  template <std::unsigned_integral CastLen, typename Fmt, typename T>
+    requires unmarshallable_with<Fmt, read_cursor<Endian>, T>
+  auto read_framed(T& val) {
+    return make_awaiter<decode_error>([this, &val] { return ready(try_read_framed<CastLen, Fmt>(val)); },
+                                      [this, &val] { return read_framed_wait<CastLen, Fmt>(val); });
+  }
+};
+
+} // end namespace
+
+#endif
+
@@ -0,0 +1,174 @@
+/** @file
+ *
+ * @brief A writer that coalesces many small messages into one buffer of frames, passing
+ * the batch to a sink when a size, count, or age threshold is reached.
+ *
+ * Each message is appended as a frame (see @c marshall_framed), so the batch can be sent
+ * with a single write and split by the receiver with @c index_frames. The sink is also
+ * given a span for each message, e.g. to track acknowledgements. The buffer is reused
+ * for the next batch, so a steady state writer does not allocate.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef BATCH_WRITER_HPP_INCLUDED
+#define BATCH_WRITER_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint32_t
+#include <vector>
+#include <span>
+#include <chrono>
+#include <concepts>
+#include <utility> // std::move
+#include <bit> // std::endian
+
+namespace chops {
+
+/**
+ * @brief Thresholds at which a @c batch_writer flushes, whichever is reached first.
+ */
+struct batch_limits {
+  std::size_t              max_bytes = 65536u; // flush once the batch is at least this size
+  std::size_t              max_count = 1024u;  // flush once the batch has this many messages
+  std::chrono::nanoseconds max_delay = std::chrono::milliseconds(1); // age of the first message
+};
+
+/**
+ * @brief Coalesce framed messages into batches, passing each batch to a sink.
+ *
+ * Example usage:
+ * @code
+ *   auto sink = [&sock] (std::span<const std::byte> batch, std::span<const std::span<const std::byte>> msgs) {
+ *     sock.send(batch);
+ *     // msgs[i] is the serialized bytes of the i'th message in the batch
+ *   };
+ *   chops::batch_writer<decltype(sink), std::uint32_t, std::endian::big> writer(sink, { 16384u, 256u });
+ *   writer.append<msg_fmt>(m);
+ *   // periodically, e.g. from an event loop timer
+ *   writer.poll();
+ * @endcode
+ *
+ * The age threshold is checked when a message is appended and in @c poll, there is no
+ * internal timer thread.
+ *
+ * @tparam Sink Callable with a span of the batch bytes and a span of the message spans,
+ * which are only valid during the call.
+ *
+ * @tparam CastLen Type of the frame length of each message.
+ *
+ * @tparam Endian Endianness of the serialized messages.
+ *
+ * @tparam Clock Clock used for the age threshold.
+ *
+ */
+template <typename Sink, std::unsigned_integral CastLen = std::uint32_t,
+          std::endian Endian = std::endian::little, typename Clock = std::chrono::steady_clock>
+  requires std::invocable<Sink&, std::span<const std::byte>, std::span<const std::span<const std::byte>>>
+class batch_writer {
+private:
+  Sink                                              m_sink;
+  batch_limits                                      m_limits;
+  expandable_buffer<std::vector<std::byte>, Endian> m_buf;
+  std::vector<std::size_t>                          m_ends; // end offset of each message
+  std::vector<std::span<const std::byte>>           m_msgs;
+  typename Clock::time_point                        m_first;
+
+  bool due(typename Clock::time_point now) const noexcept {
+    return m_ends.size() >= m_limits.max_count || size() >= m_limits.max_bytes ||
+           now - m_first >= m_limits.max_delay;
+  }
+
+public:
+  explicit batch_writer(Sink sink, batch_limits limits = { }) :
+    m_sink(std::move(sink)), m_limits(limits), m_buf(), m_ends(), m_msgs(), m_first() {
+    m_buf.get_buf().reserve(limits.max_bytes);
+  }
+
+/**
+ * @brief Append a message to the batch, flushing if a threshold is reached.
+ *
+ * If marshalling the message throws, the batch is left as it was before the call.
+ *
+ * @return The index of the message within its batch.
+ */
+  template <typename Fmt, typename T>
+    requires marshallable_with<Fmt, expandable_buffer<std::vector<std::byte>, Endian>, T>
+  std::size_t append(const T& val) {
+    auto idx = m_ends.size();
+    if (idx == 0u) {
+      m_first = Clock::now();
+    }
+    auto old_sz = m_buf.size();
+    try {
+      marshall_framed<CastLen, Fmt>(m_buf, val);
+    }
+    catch (...) {
+      // drop the partial frame, so the batch still contains only complete frames
+      m_buf.resize(old_sz);
+      if (idx == 0u) {
+        m_first = typename Clock::time_point { };
+      }
+      throw;
+    }
+    m_ends.push_back(m_buf.size());
+    if (due(idx == 0u ? m_first : Clock::now())) {
+      flush();
+    }
+    return idx;
+  }
+
+/**
+ * @brief Flush the batch if it is older than the age threshold.
+ *
+ * @return @c true if the batch was flushed.
+ */
+  bool poll() {
+    if (m_ends.empty() || Clock::now() - m_first < m_limits.max_delay) {
+      return false;
+    }
+    flush();
+    return true;
+  }
+
+/**
+ * @brief Pass the batch, if not empty, to the sink, and start a new batch.
+ */
+  void flush() {
+    if (m_ends.empty()) {
+      return;
+    }
+    const std::byte* base = m_buf.data();
+    std::size_t begin {0u};
+    m_msgs.clear();
+    for (auto end : m_ends) {
+      m_msgs.emplace_back(base + begin + sizeof(CastLen), end - begin - sizeof(CastLen));
+      begin = end;
+    }
+    m_sink(std::span<const std::byte>(base, m_buf.size()), std::span<const std::span<const std::byte>>(m_msgs));
+    m_buf.resize(0u);
+    m_ends.clear();
+  }
+
+/**
+ * @brief Return the number of messages in the current batch.
+ */
+  std::size_t count() const noexcept { return m_ends.size(); }
+/**
+ * @brief Return the number of bytes in the current batch.
+ */
+  std::size_t size() const noexcept { return m_ends.empty() ? 0u : m_ends.back(); }
+};
+
+} // end namespace
+
+#endif
+
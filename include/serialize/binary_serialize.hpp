@@ -21,11 +21,10 @@
  * @note The design of the binary marshall and unmarshall functions is a good fit
  * for a C++ metaprogamming implementation (using variadic templates). In particular,
  * the primary design concept is a mapping of two (and sometimes three) types to a 
- * single value. A typelist would allow a single function (or method) call to operate
- * on multiple values, instead of being forced to call the @c marshall or @c unmarshall
- * function once for each value (or sequence). However, the first release uses the 
- * simpler (no metaprogramming, no variadic templates) implementation with a hope that
- * a more sophisticated version will be available in the future.
+ * single value. Formats are expressed as types: a cast type (e.g. @c std::uint16_t) or
+ * a format directive such as @c seq_fmt, @c opt_fmt, or @c fields_fmt, which nest to
+ * describe a complete message. The @c format_traits specializations contain the
+ * serialization logic for each directive.
  *
  * The marshalling classes and functions are designed for networking (or file I/O), 
  * where binary data marshalling and unmarshalling is needed to send and receive 
@@ -70,17 +69,18 @@
  * where the number of elements is placed before the element sequence in the stream of
  * bytes. 
  *
- * Application defined types can be associated with a @c marshall and @c unmarshall 
- * function overload, providing a convenient way to reuse the same lower-level 
- * marshalling code. Specifically, a type @c MyType can be used in a sequence or in 
- * a @c std::optional or as part of a higher level @c struct or @c class type without needing 
- * to duplicate the marshalling calls within the @c MyType @c marshall and @c unmarshall 
- * functions.
+ * Application defined aggregate types can be associated with a format through the
+ * @c serialize_format trait, typically a @c fields_fmt listing the format of each field.
+ * The fields are enumerated through structured bindings, so no handwritten @c marshall
+ * or @c unmarshall code is needed. Specifically, a type @c MyType can be used in a sequence
+ * or in a @c std::optional or as part of a higher level @c struct or @c class type without
+ * needing to duplicate the marshalling calls for the @c MyType fields.
  * 
- * @c std::variant and @c std::any are not directly supported and require value extraction 
- * by the application. (Supporting @c std::variant or @c std::any might be a future 
- * enhancement if a good design is proposed.) @c std::wstring and other non-char strings are 
- * also not directly supported, and require additional calls from the application.
+ * @c std::variant is supported through the @c variant_fmt directive, serialized as a
+ * discriminator (the alternative index) followed by the active alternative. @c std::any is
+ * not directly supported and requires value extraction by the application. @c std::wstring
+ * and other non-char strings are also not directly supported, and require additional calls
+ * from the application.
  *
  * Central to the design of these marshalling and unmarshalling functions is a mapping of 
  * two types to a single value. For marshalling, the two types are the native type (e.g. 
@@ -118,55 +118,1903 @@
 
 #include "buffer/shared_buffer.hpp"
 #include "serialize/extract_append.hpp"
+#include "serialize/aggregate_fields.hpp"
 
 #include <cstddef> // std::byte, std::size_t, std::nullptr_t
 #include <cstdint> // std::uint32_t, etc
 #include <optional>
+#include <variant>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <cstring> // std::memcpy
+#include <algorithm> // std::copy_n, std::max
 #include <type_traits>
 #include <iterator> // value type of iterator
 #include <array>
+#include <tuple>
+#include <limits> // std::numeric_limits
+#include <stdexcept> // std::length_error
+#include <utility> // std::index_sequence, std::in_range
+#include <span>
+#include <ranges>
+#include <bit> // std::endian, std::bit_cast
+#include <chrono>
+#include <ratio>
 #include <cassert>
 #include <concepts>
+#include <memory> // std::make_obj_using_allocator
+#include <memory_resource>
+#include <version> // __cpp_lib_expected
 
-#include <iostream> // debugging
+#ifdef __cpp_lib_expected
+#include <expected>
+#endif
+
+namespace chops {
+
+template <typename Ctr>
+concept supports_expandable_buffer =
+  std::same_as<typename Ctr::value_type, std::byte> &&
+  requires (Ctr ctr) {
+    { ctr.size() } -> std::integral;
+    ctr.resize(std::size_t{});
+    { ctr.data() } -> std::same_as<std::byte*>;
+  };
+
+template <typename Ctr>
+concept supports_endian_expandable_buffer =
+  supports_expandable_buffer<Ctr> &&
+  requires (Ctr ctr) {
+    typename Ctr::endian_type;
+  };
+
+/**
+ * @brief @c true if a buffer processes bytes as they are appended, so that bytes already
+ * appended can not be rewritten or removed with @c resize.
+ *
+ * A buffer adaptor such as @c crc32c_buffer, @c hashing_buffer, or @c compressing_buffer
+ * declares a @c static @c constexpr @c bool @c append_only member set to @c true.
+ */
+template <typename Buf>
+inline constexpr bool is_append_only = false;
+
+template <typename Buf>
+  requires requires { { Buf::append_only } -> std::convertible_to<bool>; }
+inline constexpr bool is_append_only<Buf> = Buf::append_only;
+
+/**
+ * @brief Wrap a container of @c std::bytes, adding the endianness of the serialized
+ * data as part of the buffer type.
+ *
+ * The @c endian_type is a @c std::integral_constant holding the @c std::endian value,
+ * so that the endianness is available at compile time to the serialize functions.
+ *
+ */
+template <supports_expandable_buffer Ctr = chops::mutable_shared_buffer,
+         std::endian Endian = std::endian::little>
+class expandable_buffer {
+private:
+  Ctr      m_ctr;
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+  using value_type = std::byte;
+  constexpr Ctr& get_buf() noexcept { return m_ctr; }
+  constexpr std::size_t size() noexcept { return m_ctr.size(); }
+  constexpr std::byte* data() noexcept { return m_ctr.data(); }
+  constexpr void resize(std::size_t sz) { m_ctr.resize(sz); }
+};
+
+/**
+ * @brief Adapt a @c std::array so that a fixed size @c std::byte array can be used with
+ * the @c chops::marshall function template as the @c Buf template parameter.
+ *
+ * This class provides three methods (@c size, @c resize, @c data) as required
+ * by the @c Buf parameter type in the @c chops::marshall function template.
+ *
+ * The logical size of the buffer is tracked. If @c resize is called and there
+ * is not enough room in the buffer a @c std::length_error is thrown.
+ *
+ */
+template <std::size_t N>
+class fixed_size_byte_array {
+public:
+  using value_type = std::byte;
+/**
+ * @brief Default construct the @ fixed_size_byte_array.
+ *
+ */
+  constexpr fixed_size_byte_array() noexcept : m_buf(), m_size(0u) { }
+
+/**
+ * @brief Return the size of the data which has been written into the buffer.
+ *
+ * @return The size of the data which has been written into the buffer, which is
+ * modified through the @c resize method.
+ *
+ */
+  constexpr std::size_t size() const noexcept {
+    return m_size;
+  }
+/**
+ * @brief Increase the logical size, allowing bytes to be appended.
+ *
+ * @param sz New logical size.
+ *
+ * @throw std::length_error If @c sz is larger than the array.
+ */
+  constexpr void resize(std::size_t sz) {
+    if (sz > N) {
+      throw std::length_error("fixed_size_byte_array capacity exceeded");
+    }
+    m_size = sz;
+  }
+/**
+ * @brief Return a pointer to the beginning of the buffer.
+ *
+ * @return A pointer to the beginning of the buffer.
+ */
+  constexpr std::byte* data() noexcept {
+    return m_buf.data();
+  }
+/**
+ * @brief Return a reference to the underlying @c std::array.
+ */
+  constexpr const std::array<std::byte, N>& get_array() const noexcept {
+    return m_buf;
+  }
+/**
+ * @brief Logically reset so that new data can be written into the buffer
+ * at the beginning.
+ */
+  constexpr void clear() noexcept {
+    m_size = 0u;
+  }
+
+private:
+  std::array<std::byte, N> m_buf;
+  std::size_t              m_size;
+};
+
+/**
+ * @brief A lightweight write position over pre-sized memory, with no size bookkeeping
+ * beyond a pointer, usable as the @c Buf parameter of the @c chops::marshall function
+ * templates.
+ *
+ * After a sizing pass (see @c encoded_size) or with a capacity guarantee (see
+ * @c max_encoded_size), the @c resize calls made while serializing are redundant. A
+ * @c write_cursor @c resize only moves the write position, and the end of the memory is
+ * checked with an assert (i.e. only in debug builds). All format directives are available,
+ * since the @c write_cursor satisfies the same buffer concept as @c expandable_buffer.
+ *
+ * Example usage, serializing directly into a @c std::vector after a single resize:
+ * @code
+ *   std::vector<std::byte> vec;
+ *   auto cur = chops::make_write_cursor<std::endian::big>(vec, chops::encoded_size<msg_fmt>(msg));
+ *   chops::marshall<msg_fmt>(cur, msg);
+ * @endcode
+ *
+ */
+template <std::endian Endian = std::endian::little>
+class write_cursor {
+private:
+  std::byte* m_begin;
+  std::byte* m_cur;
+  std::byte* m_end;
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+  using value_type = std::byte;
+
+  constexpr write_cursor(std::byte* buf, std::size_t capacity) noexcept :
+    m_begin(buf), m_cur(buf), m_end(buf + capacity) { }
+  constexpr explicit write_cursor(std::span<std::byte> buf) noexcept :
+    write_cursor(buf.data(), buf.size()) { }
+
+/**
+ * @brief Return the number of bytes written.
+ */
+  constexpr std::size_t size() const noexcept { return static_cast<std::size_t>(m_cur - m_begin); }
+/**
+ * @brief Move the write position, the new size must be within the capacity.
+ */
+  constexpr void resize(std::size_t sz) noexcept {
+    assert(sz <= capacity());
+    m_cur = m_begin + sz;
+  }
+/**
+ * @brief Return a pointer to the beginning of the memory.
+ */
+  constexpr std::byte* data() noexcept { return m_begin; }
+/**
+ * @brief Return the total number of bytes that can be written.
+ */
+  constexpr std::size_t capacity() const noexcept { return static_cast<std::size_t>(m_end - m_begin); }
+};
+
+/**
+ * @brief Expand a buffer once and return a @c write_cursor over the new bytes.
+ *
+ * @param buf Buffer to expand, any type satisfying @c supports_expandable_buffer (e.g.
+ * @c std::vector<std::byte> or @c chops::mutable_shared_buffer).
+ *
+ * @param num_bytes Number of bytes to append to the buffer.
+ *
+ * @return A @c write_cursor with a capacity of @c num_bytes.
+ *
+ * @note If fewer bytes than @c num_bytes are written, the buffer should be resized to
+ * the original size plus the cursor @c size.
+ */
+template <std::endian Endian, supports_expandable_buffer Ctr>
+constexpr write_cursor<Endian> make_write_cursor(Ctr& buf, std::size_t num_bytes) {
+  auto old_sz = static_cast<std::size_t>(buf.size());
+  buf.resize(old_sz + num_bytes);
+  return write_cursor<Endian>(buf.data() + old_sz, num_bytes);
+}
+
+template <typename Src>
+concept supports_endian_extract_buffer =
+  requires (Src src) {
+    typename Src::endian_type;
+    { src.data() } -> std::same_as<const std::byte*>;
+    { src.remaining() } -> std::integral;
+    src.advance(std::size_t{});
+  };
+
+/**
+ * @brief A read position within a buffer of serialized @c std::bytes, used as the
+ * @c Src parameter of the @c chops::unmarshall function templates.
+ *
+ * The buffer is not owned, and must outlive the @c extract_buffer. Reading past the
+ * end of the buffer is a precondition violation, checked with an assert.
+ *
+ */
+template <std::endian Endian = std::endian::little>
+class extract_buffer {
+private:
+  const std::byte* m_ptr;
+  const std::byte* m_end;
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+
+  constexpr extract_buffer(const std::byte* buf, std::size_t sz) noexcept :
+    m_ptr(buf), m_end(buf + sz) { }
+  constexpr explicit extract_buffer(std::span<const std::byte> buf) noexcept :
+    m_ptr(buf.data()), m_end(buf.data() + buf.size()) { }
+
+/**
+ * @brief Return a pointer to the current read position.
+ */
+  constexpr const std::byte* data() const noexcept { return m_ptr; }
+/**
+ * @brief Return the number of bytes remaining after the current read position.
+ */
+  constexpr std::size_t remaining() const noexcept { return static_cast<std::size_t>(m_end - m_ptr); }
+/**
+ * @brief Move the read position forward.
+ *
+ * @param sz Number of bytes to skip past.
+ */
+  constexpr void advance(std::size_t sz) noexcept {
+    assert(sz <= remaining());
+    m_ptr += sz;
+  }
+};
+
+/**
+ * @brief Errors reported when unmarshalling through a @c read_cursor.
+ */
+enum class decode_error {
+  none = 0,
+  truncated,            // fewer bytes remain than the format requires
+  count_too_large,      // a sequence count exceeds the maximum count of the format
+  invalid_discriminant, // a variant discriminant does not match an alternative
+  invalid_value,        // a value is not valid for the format (e.g. an optional flag other than 0 or 1)
+  trailing_bytes,       // bytes remain after a complete message
+  checksum_mismatch     // a frame checksum does not match the bytes read
+};
+
+/**
+ * @brief A bounds-checked read position within a buffer of serialized @c std::bytes,
+ * for decoding untrusted input.
+ *
+ * A @c read_cursor can be used anywhere an @c extract_buffer can. Instead of a
+ * precondition that the buffer contains all of the serialized bytes, each fixed size
+ * run (a fixed size value, or all of the elements of a sequence of fixed size elements)
+ * is checked once against the remaining bytes. Sequence counts, optional flags, and
+ * variant discriminants are also checked.
+ *
+ * The first error is recorded and is sticky: the cursor then reports no remaining bytes,
+ * decoding stops without reading further, and no exceptions are thrown. The value being
+ * decoded is left in a valid but unspecified state.
+ *
+ * Example usage:
+ * @code
+ *   chops::read_cursor<std::endian::big> cur(frame);
+ *   msg m;
+ *   if (chops::try_unmarshall<msg_fmt>(cur, m) != chops::decode_error::none) {
+ *     // reject the frame
+ *   }
+ * @endcode
+ *
+ */
+template <std::endian Endian = std::endian::little>
+class read_cursor {
+private:
+  const std::byte* m_ptr;
+  const std::byte* m_end;
+  decode_error     m_err;
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+
+  constexpr read_cursor(const std::byte* buf, std::size_t sz) noexcept :
+    m_ptr(buf), m_end(buf + sz), m_err(decode_error::none) { }
+  constexpr explicit read_cursor(std::span<const std::byte> buf) noexcept :
+    read_cursor(buf.data(), buf.size()) { }
+
+/**
+ * @brief Return a pointer to the current read position.
+ */
+  constexpr const std::byte* data() const noexcept { return m_ptr; }
+/**
+ * @brief Return the number of bytes remaining, zero once an error has occurred.
+ */
+  constexpr std::size_t remaining() const noexcept { return static_cast<std::size_t>(m_end - m_ptr); }
+/**
+ * @brief Move the read position forward, after a successful @c ensure.
+ */
+  constexpr void advance(std::size_t sz) noexcept {
+    assert(sz <= remaining());
+    m_ptr += sz;
+  }
+/**
+ * @brief Check that a number of bytes can be read, recording @c decode_error::truncated
+ * if not.
+ *
+ * @return @c true if no error has occurred and @c sz bytes remain.
+ */
+  constexpr bool ensure(std::size_t sz) noexcept {
+    if (m_err == decode_error::none && sz <= remaining()) {
+      return true;
+    }
+    fail(decode_error::truncated);
+    return false;
+  }
+/**
+ * @brief Record an error, if one has not already been recorded, and stop reading.
+ */
+  constexpr void fail(decode_error err) noexcept {
+    if (m_err == decode_error::none) {
+      m_err = err;
+    }
+    m_ptr = m_end;
+  }
+/**
+ * @brief Return @c true if no error has occurred.
+ */
+  constexpr bool ok() const noexcept { return m_err == decode_error::none; }
+/**
+ * @brief Return the first error that occurred, or @c decode_error::none.
+ */
+  constexpr decode_error error() const noexcept { return m_err; }
+};
+
+/**
+ * @brief Concept for an extract buffer that reports decoding errors instead of relying
+ * on preconditions, e.g. @c read_cursor.
+ */
+template <typename Src>
+concept checked_extract_buffer =
+  supports_endian_extract_buffer<Src> &&
+  requires (Src src) {
+    { src.ensure(std::size_t{}) } -> std::same_as<bool>;
+    src.fail(decode_error::none);
+    { src.ok() } -> std::same_as<bool>;
+    { src.error() } -> std::same_as<decode_error>;
+  };
+
+/**
+ * @brief @c true if a pointer returned by the @c data method of an extract buffer stays
+ * valid while later bytes are read, so that a format can view decoded bytes in place.
+ *
+ * A buffer that moves or frees bytes already read (e.g. @c decompressing_cursor, which
+ * reuses its window) declares a @c static @c constexpr @c bool @c stable_data member
+ * set to @c false.
+ */
+template <typename Src>
+inline constexpr bool has_stable_data = true;
+
+template <typename Src>
+  requires requires { { Src::stable_data } -> std::convertible_to<bool>; }
+inline constexpr bool has_stable_data<Src> = Src::stable_data;
+
+/**
+ * @brief Concept for an extract buffer that supplies a @c std::pmr::memory_resource for
+ * the objects created while decoding.
+ */
+template <typename Src>
+concept has_memory_resource =
+  supports_endian_extract_buffer<Src> &&
+  requires (const Src src) {
+    { src.resource() } -> std::same_as<std::pmr::memory_resource*>;
+  };
+
+/**
+ * @brief An extract buffer (e.g. @c extract_buffer or @c read_cursor) combined with a
+ * @c std::pmr::memory_resource, so that decoding allocates from an arena.
+ *
+ * Elements inserted into a sequence or associative container are constructed with the
+ * allocator of the container (so a @c std::pmr::vector of @c std::pmr::string allocates
+ * each string from the resource of the vector). Other objects created while decoding (the
+ * value of a @c std::optional, a @c std::variant alternative, an element that is an
+ * aggregate with allocator-aware fields) are constructed with the buffer memory resource.
+ * The top level object can be constructed with @c make_using_resource.
+ *
+ * Example usage, with all of the allocations for a message freed at once:
+ * @code
+ *   std::pmr::monotonic_buffer_resource arena;
+ *   chops::resource_buffer src(chops::read_cursor<std::endian::big>(frame), &arena);
+ *   auto m = chops::make_using_resource<msg>(&arena);
+ *   chops::unmarshall<msg_fmt>(src, m);
+ * @endcode
+ *
+ */
+template <supports_endian_extract_buffer Src>
+class resource_buffer : public Src {
+private:
+  std::pmr::memory_resource* m_res;
+public:
+  resource_buffer(const Src& src, std::pmr::memory_resource* res) noexcept : Src(src), m_res(res) { }
+
+/**
+ * @brief Return the memory resource used for objects created while decoding.
+ */
+  std::pmr::memory_resource* resource() const noexcept { return m_res; }
+};
+
+/**
+ * @brief Format directive for a sequence (e.g. @c std::vector, @c std::list,
+ * @c std::string), serialized as a count followed by each element.
+ *
+ * @tparam CastCnt Unsigned integer type of the count, e.g. @c std::uint16_t for a 16 bit count.
+ *
+ * @tparam ElemFmt Format of each element, either a cast type such as @c std::int32_t or
+ * another format directive.
+ *
+ * @tparam MaxCnt Maximum number of elements, by default the maximum value of the count type.
+ * This bounds the @c max_encoded_size of the format, and is checked when serializing, a
+ * larger sequence throws @c std::length_error.
+ *
+ */
+template <typename CastCnt, typename ElemFmt,
+          std::size_t MaxCnt = std::numeric_limits<CastCnt>::max()>
+  requires std::unsigned_integral<CastCnt> && (!std::same_as<CastCnt, bool>) &&
+           (std::in_range<CastCnt>(MaxCnt))
+struct seq_fmt { };
+
+/**
+ * @brief Format directive for an associative container (e.g. @c std::map,
+ * @c std::unordered_map, @c std::multimap), serialized as a count followed by each
+ * key and value pair.
+ *
+ * Ordered containers are serialized in key order. Unmarshalling reserves capacity in
+ * unordered containers from the count, and inserts into ordered containers with an end
+ * hint, which is amortized constant time per element when the keys are sorted, avoiding
+ * repeated tree searches and rebalancing.
+ *
+ * @note Sets are handled by @c seq_fmt, which performs the same reserve and end hinted
+ * insertion.
+ *
+ * @tparam CastCnt Unsigned integer type of the count.
+ *
+ * @tparam KeyFmt Format of each key.
+ *
+ * @tparam ValFmt Format of each mapped value.
+ *
+ * @tparam MaxCnt Maximum number of elements, by default the maximum value of the count type,
+ * as in @c seq_fmt. A larger count is rejected with @c decode_error::count_too_large when
+ * decoding, and throws @c std::length_error when serializing.
+ *
+ */
+template <typename CastCnt, typename KeyFmt, typename ValFmt,
+          std::size_t MaxCnt = std::numeric_limits<CastCnt>::max()>
+  requires std::unsigned_integral<CastCnt> && (!std::same_as<CastCnt, bool>) &&
+           (std::in_range<CastCnt>(MaxCnt))
+struct map_fmt { };
+
+/**
+ * @brief Format directive for a @c std::optional, serialized as a flag value (1 or 0)
+ * followed by the value if present.
+ *
+ * @tparam CastBool Integral type of the flag, e.g. @c std::uint8_t.
+ *
+ * @tparam ValFmt Format of the contained value.
+ *
+ */
+template <integral_or_byte CastBool, typename ValFmt>
+struct opt_fmt { };
+
+/**
+ * @brief Format directive for a @c std::variant, serialized as a discriminator (the index
+ * of the active alternative) followed by the alternative value.
+ *
+ * Unmarshalling dispatches through a compile-time generated table of per-alternative
+ * decoders indexed by the discriminator, so the cost does not grow with the number of
+ * alternatives.
+ *
+ * @tparam CastDisc Unsigned integer type of the discriminator, e.g. @c std::uint8_t.
+ *
+ * @tparam AltFmts Format of each alternative, in the same order as the @c std::variant
+ * alternatives.
+ *
+ */
+template <typename CastDisc, typename ... AltFmts>
+  requires std::unsigned_integral<CastDisc> && (!std::same_as<CastDisc, bool>) &&
+           (sizeof...(AltFmts) > 0u) && (std::in_range<CastDisc>(sizeof...(AltFmts) - 1u))
+struct variant_fmt { };
+
+/**
+ * @brief Format directive for an enum (scoped or unscoped), serialized as an integral
+ * cast type, which can be the underlying type or a narrower type.
+ *
+ * An optional maximum enumerator value can be specified, in which case the valid range
+ * is zero through the maximum. At compile time it is checked that the maximum fits in
+ * the cast type, and at runtime each value is checked (with an assert) against the range.
+ * Validation and checked decoding reject serialized values outside the range before
+ * they are converted to the enum type. Without a maximum, checked decoding rejects
+ * serialized values outside the range of the underlying type of the enum (validation
+ * alone can not, since the enum type is not known from the format).
+ *
+ * Example usage:
+ * @code
+ *   enum class color : int { red, green, blue };
+ *   chops::marshall<chops::enum_fmt<std::uint8_t, color::blue>>(buf, color::green);
+ * @endcode
+ *
+ * @tparam CastVal Integral type used in the byte buffer.
+ *
+ * @tparam MaxVal Optional maximum enumerator value.
+ *
+ */
+template <integral_or_byte CastVal, auto ... MaxVal>
+  requires (sizeof...(MaxVal) <= 1u) && (std::is_enum_v<decltype(MaxVal)> && ...)
+struct enum_fmt { };
+
+/**
+ * @brief Format directive for a @c std::chrono::duration or @c std::chrono::time_point,
+ * serialized as a tick count of an integral cast type.
+ *
+ * The tick period in the byte buffer can differ from the period of the application type,
+ * in which case the unit conversion (a ratio computed at compile time) is performed with
+ * @c std::chrono::duration_cast. A time point is serialized as the duration since its
+ * clock epoch.
+ *
+ * Example usage - serialize a @c std::chrono::system_clock::time_point as 64 bit
+ * microseconds:
+ * @code
+ *   chops::marshall<chops::chrono_fmt<std::int64_t, std::micro>>(buf, std::chrono::system_clock::now());
+ * @endcode
+ *
+ * @tparam CastRep Integral type of the tick count in the byte buffer.
+ *
+ * @tparam WirePeriod A @c std::ratio tick period in the byte buffer, if @c void the period
+ * of the application type is used.
+ *
+ */
+template <std::integral CastRep, typename WirePeriod = void>
+struct chrono_fmt { };
+
+/**
+ * @brief Format directive for a tuple-like type (@c std::tuple, @c std::pair, or any type
+ * supporting @c std::tuple_size and @c std::get), serialized element by element with no
+ * count prefix.
+ *
+ * Consecutive fixed size elements are appended with a single buffer resize. If every
+ * element format has a fixed size, the total size is known at compile time.
+ *
+ * @tparam ElemFmts Format of each element.
+ *
+ */
+template <typename ... ElemFmts>
+struct tuple_fmt { };
+
+/**
+ * @brief Format directive for a fixed size array (e.g. @c std::array), serialized as
+ * exactly @c N elements with no count prefix.
+ *
+ * When the in-memory representation of contiguous elements matches the serialized
+ * representation (e.g. a cast type of the same size as an integral or enum element type),
+ * bulk copy and swap loops are used instead of per element calls.
+ *
+ * @tparam N Number of elements.
+ *
+ * @tparam ElemFmt Format of each element.
+ *
+ */
+template <std::size_t N, typename ElemFmt>
+struct array_fmt { };
+
+/**
+ * @brief Format directive for an aggregate (@c struct or @c class with public fields
+ * and no constructors), with one format per field in declaration order.
+ *
+ * Field enumeration is performed through structured bindings, so no handwritten
+ * @c marshall or @c unmarshall code is needed for the aggregate. Consecutive fixed size
+ * fields are appended with a single buffer resize, and if every field format has a fixed
+ * size the whole aggregate is serialized with one resize.
+ *
+ * @tparam FieldFmts Format of each field, e.g. @c std::int32_t or @c seq_fmt or a
+ * nested @c fields_fmt.
+ *
+ */
+template <typename ... FieldFmts>
+struct fields_fmt { };
+
+/**
+ * @brief Customization point associating a format with an application type.
+ *
+ * Specialize with a nested @c type declaration (typically a @c fields_fmt), after which
+ * the type can be marshalled and unmarshalled without specifying the format:
+ * @code
+ *   struct loc { int latitude; int longitude; short altitude; };
+ *   template <>
+ *   struct chops::serialize_format<loc> {
+ *     using type = chops::fields_fmt<std::int32_t, std::int32_t, std::int16_t>;
+ *   };
+ *   // ...
+ *   chops::marshall(buf, my_loc);
+ * @endcode
+ *
+ */
+template <typename T>
+struct serialize_format { };
+
+template <typename T>
+using serialize_format_t = typename serialize_format<T>::type;
+
+template <typename T>
+concept has_serialize_format = requires { typename serialize_format<std::remove_cvref_t<T>>::type; };
+
+/**
+ * @brief Serialization logic for each format directive.
+ *
+ * A fixed size format provides @c is_fixed_size as @c true, @c fixed_size, and static
+ * @c append and @c extract function templates operating on raw @c std::byte pointers. A
+ * variable size format provides @c is_fixed_size as @c false, @c max_size (which is
+ * @c unbounded_size if there is no bound), and static @c encoded_size, @c marshall and
+ * @c unmarshall function templates operating on values and buffers.
+ *
+ * All of the serialization logic is @c constexpr, so that messages can be serialized
+ * at compile time (see @c serialize_to_array).
+ *
+ */
+template <typename Fmt>
+struct format_traits;
+
+/**
+ * @brief Maximum size value of a format which has no bound on the serialized size.
+ */
+inline constexpr std::size_t unbounded_size = std::numeric_limits<std::size_t>::max();
+
+template <typename Fmt>
+concept fixed_size_format = format_traits<Fmt>::is_fixed_size;
+
+template <typename T, std::size_t N>
+concept tuple_like_of_size = requires { std::tuple_size<std::remove_cvref_t<T>>::value; } &&
+                             (std::tuple_size_v<std::remove_cvref_t<T>> == N);
+
+namespace detail {
+
+template <integral_or_byte CastTypeVal, typename T, supports_endian_expandable_buffer Buf>
+constexpr Buf& serialize_val(Buf& buf, const T& val) {
+  auto old_sz = buf.size();
+  buf.resize(old_sz + sizeof(CastTypeVal));
+  append_val<Buf::endian_type::value>(buf.data()+old_sz, static_cast<CastTypeVal>(val));
+  return buf;
+}
+
+// a checked source records an error, otherwise enough bytes is a precondition
+template <supports_endian_extract_buffer Src>
+constexpr bool has_bytes(Src& src, std::size_t sz) noexcept {
+  if constexpr (checked_extract_buffer<Src>) {
+    return src.ensure(sz);
+  }
+  else {
+    assert(sz <= src.remaining());
+    return true;
+  }
+}
+
+template <supports_endian_extract_buffer Src>
+constexpr bool decode_ok(const Src& src) noexcept {
+  if constexpr (checked_extract_buffer<Src>) {
+    return src.ok();
+  }
+  else {
+    return true;
+  }
+}
+
+template <supports_endian_extract_buffer Src>
+constexpr void fail_decode(Src& src, [[maybe_unused]] decode_error err) noexcept {
+  if constexpr (checked_extract_buffer<Src>) {
+    src.fail(err);
+  }
+  else {
+    assert(err == decode_error::none); // invalid serialized data is a precondition violation
+  }
+}
+
+template <integral_or_byte CastTypeVal, supports_endian_extract_buffer Src>
+constexpr CastTypeVal unserialize_val(Src& src) {
+  if (!has_bytes(src, sizeof(CastTypeVal))) {
+    return CastTypeVal{};
+  }
+  auto val = extract_val<Src::endian_type::value, CastTypeVal>(src.data());
+  src.advance(sizeof(CastTypeVal));
+  return val;
+}
+
+template <typename Fmt, typename T>
+constexpr std::size_t encoded_size_fmt(const T& val) {
+  using traits = format_traits<Fmt>;
+  if constexpr (traits::is_fixed_size) {
+    return traits::fixed_size;
+  }
+  else {
+    return traits::encoded_size(val);
+  }
+}
+
+template <typename Fmt, supports_endian_expandable_buffer Buf, typename T>
+constexpr Buf& marshall_fmt(Buf& buf, const T& val) {
+  using traits = format_traits<Fmt>;
+  if constexpr (traits::is_fixed_size) {
+    auto old_sz = buf.size();
+    buf.resize(old_sz + traits::fixed_size);
+    traits::template append<Buf::endian_type::value>(buf.data()+old_sz, val);
+    return buf;
+  }
+  else {
+    return traits::marshall(buf, val);
+  }
+}
+
+// fixed size formats with restricted values (e.g. an enum with a maximum) provide an
+// is_valid check on the serialized bytes, all other fixed size formats are always valid
+template <typename Fmt, std::endian Endian>
+constexpr bool valid_fixed(const std::byte* buf) noexcept {
+  if constexpr (requires { format_traits<Fmt>::template is_valid<Endian>(buf); }) {
+    return format_traits<Fmt>::template is_valid<Endian>(buf);
+  }
+  else {
+    return true;
+  }
+}
+
+template <typename Fmt, std::endian Endian>
+constexpr bool valid_fixed_run(const std::byte* buf, std::size_t num) noexcept {
+  if constexpr (requires { format_traits<Fmt>::template is_valid<Endian>(buf); }) {
+    for (std::size_t i {0u}; i < num; ++i) {
+      if (!format_traits<Fmt>::template is_valid<Endian>(buf + i * format_traits<Fmt>::fixed_size)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// when decoding, the serialized bytes can also be checked against the type decoded into
+// (e.g. an enum wire value against the range of the underlying type) with is_valid_as
+template <typename Fmt, std::endian Endian, typename T>
+constexpr bool valid_fixed_as(const std::byte* buf) noexcept {
+  if constexpr (requires { format_traits<Fmt>::template is_valid_as<Endian, T>(buf); }) {
+    return format_traits<Fmt>::template is_valid_as<Endian, T>(buf);
+  }
+  else {
+    return valid_fixed<Fmt, Endian>(buf);
+  }
+}
+
+template <typename Fmt, std::endian Endian, typename T>
+constexpr bool valid_fixed_run_as(const std::byte* buf, std::size_t num) noexcept {
+  if constexpr (requires { format_traits<Fmt>::template is_valid_as<Endian, T>(buf); }) {
+    for (std::size_t i {0u}; i < num; ++i) {
+      if (!format_traits<Fmt>::template is_valid_as<Endian, T>(buf + i * format_traits<Fmt>::fixed_size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  else {
+    return valid_fixed_run<Fmt, Endian>(buf, num);
+  }
+}
+
+template <typename Fmt, checked_extract_buffer Src>
+constexpr void validate_fmt(Src& src) {
+  using traits = format_traits<Fmt>;
+  if constexpr (traits::is_fixed_size) {
+    if (!has_bytes(src, traits::fixed_size)) {
+      return;
+    }
+    if (!valid_fixed<Fmt, Src::endian_type::value>(src.data())) {
+      fail_decode(src, decode_error::invalid_value);
+      return;
+    }
+    src.advance(traits::fixed_size);
+  }
+  else {
+    traits::validate(src);
+  }
+}
+
+template <typename Fmt, supports_endian_extract_buffer Src, typename T>
+constexpr Src& unmarshall_fmt(Src& src, T& val) {
+  using traits = format_traits<Fmt>;
+  if constexpr (traits::is_fixed_size) {
+    if (!has_bytes(src, traits::fixed_size)) {
+      return src;
+    }
+    if constexpr (checked_extract_buffer<Src>) {
+      if (!valid_fixed_as<Fmt, Src::endian_type::value, T>(src.data())) {
+        fail_decode(src, decode_error::invalid_value);
+        return src;
+      }
+    }
+    src.advance(traits::template extract<Src::endian_type::value>(src.data(), val));
+    return src;
+  }
+  else {
+    return traits::unmarshall(src, val);
+  }
+}
+
+// true if the elements of a contiguous sequence have the same representation as the
+// serialized values, so a bulk copy and swap loop can be used
+template <typename ElemFmt, typename Ctr>
+constexpr bool is_bulk_convertible() noexcept {
+  if constexpr (std::ranges::contiguous_range<Ctr> && fixed_size_format<ElemFmt>) {
+    using T = std::ranges::range_value_t<Ctr>;
+    if constexpr (requires { format_traits<ElemFmt>::template is_bulk_rep<T>; }) {
+      return format_traits<ElemFmt>::template is_bulk_rep<T>;
+    }
+    else {
+      return false;
+    }
+  }
+  else {
+    return false;
+  }
+}
+
+template <std::endian Endian, integral_or_byte CastVal, typename T>
+constexpr std::size_t append_bulk(std::byte* buf, const T* vals, std::size_t num) noexcept {
+  static_assert(sizeof(T) == sizeof(CastVal) && std::is_trivially_copyable_v<T>);
+  if constexpr (integral_or_byte<T>) {
+    return append_vals<Endian>(buf, vals, num);
+  }
+  else {
+    if constexpr (Endian == std::endian::native || sizeof(T) == 1u) {
+      if (!std::is_constant_evaluated()) {
+        if (num != 0u) {
+          std::memcpy(buf, vals, num * sizeof(T));
+        }
+        return num * sizeof(T);
+      }
+    }
+    for (std::size_t i = 0u; i < num; ++i) {
+      append_val<Endian>(buf + i * sizeof(T), std::bit_cast<CastVal>(vals[i]));
+    }
+    return num * sizeof(T);
+  }
+}
+
+template <std::endian Endian, integral_or_byte CastVal, typename T>
+constexpr std::size_t extract_bulk(const std::byte* buf, T* vals, std::size_t num) noexcept {
+  static_assert(sizeof(T) == sizeof(CastVal) && std::is_trivially_copyable_v<T>);
+  if constexpr (integral_or_byte<T>) {
+    return extract_vals<Endian>(buf, vals, num);
+  }
+  else {
+    if constexpr (Endian == std::endian::native || sizeof(T) == 1u) {
+      if (!std::is_constant_evaluated()) {
+        if (num != 0u) {
+          std::memcpy(vals, buf, num * sizeof(T));
+        }
+        return num * sizeof(T);
+      }
+    }
+    for (std::size_t i = 0u; i < num; ++i) {
+      vals[i] = std::bit_cast<T>(extract_val<Endian, CastVal>(buf + i * sizeof(T)));
+    }
+    return num * sizeof(T);
+  }
+}
+
+template <typename T>
+struct is_duration : std::false_type { };
+template <typename Rep, typename Period>
+struct is_duration<std::chrono::duration<Rep, Period>> : std::true_type { };
+
+template <typename T>
+struct is_time_point : std::false_type { };
+template <typename Clock, typename Dur>
+struct is_time_point<std::chrono::time_point<Clock, Dur>> : std::true_type { };
+
+template <typename T>
+concept chrono_type = is_duration<T>::value || is_time_point<T>::value;
+
+template <typename T>
+concept integral_or_enum = integral_or_byte<T> || std::is_enum_v<T>;
+
+template <typename Fmt>
+consteval std::size_t fixed_size_or_zero() noexcept {
+  if constexpr (fixed_size_format<Fmt>) {
+    return format_traits<Fmt>::fixed_size;
+  }
+  else {
+    return 0u;
+  }
+}
+
+// saturating arithmetic, so that an overflowing maximum size becomes unbounded_size
+constexpr std::size_t sat_add(std::size_t a, std::size_t b) noexcept {
+  return (a > unbounded_size - b) ? unbounded_size : a + b;
+}
+
+constexpr std::size_t sat_mul(std::size_t a, std::size_t b) noexcept {
+  return (a != 0u && b > unbounded_size / a) ? unbounded_size : a * b;
+}
+
+// a count beyond the maximum of a format would be truncated when serialized, and would
+// overrun a buffer sized with max_encoded_size, so it is checked in all builds
+template <std::unsigned_integral CastCnt, std::size_t MaxCnt = std::numeric_limits<CastCnt>::max()>
+constexpr void check_count(std::size_t cnt) {
+  static_assert(std::in_range<CastCnt>(MaxCnt));
+  if (cnt > MaxCnt) {
+    throw std::length_error("sequence count exceeds the maximum count of the format");
+  }
+}
+
+// number of bytes written by append_var_int
+template <std::unsigned_integral T>
+constexpr std::size_t var_int_size(T val) noexcept {
+  std::size_t sz {1u};
+  for (; val > 127u; val >>= 7) {
+    ++sz;
+  }
+  return sz;
+}
+
+// the converse of append_var_int; unlike extract_var_int, each byte is checked against the
+// remaining bytes, and an encoding longer than the type is an error
+template <std::unsigned_integral T, supports_endian_extract_buffer Src>
+constexpr T unserialize_var_int(Src& src) {
+  constexpr unsigned num_bits = std::numeric_limits<T>::digits;
+  T val {0u};
+  for (unsigned shift {0u}; shift < num_bits; shift += 7u) {
+    if (!has_bytes(src, 1u)) {
+      return 0u;
+    }
+    auto b = std::to_integer<unsigned>(*src.data());
+    src.advance(1u);
+    if (num_bits - shift < 7u && (b & 127u) >= (1u << (num_bits - shift))) {
+      break; // more bits than the type
+    }
+    val |= static_cast<T>(static_cast<T>(b & 127u) << shift);
+    if ((b & 128u) == 0u) {
+      return val;
+    }
+  }
+  fail_decode(src, decode_error::invalid_value);
+  return 0u;
+}
+
+// a sequence container that can be decoded into in place, elements must be real objects
+// (e.g. not the proxies of std::vector<bool>)
+template <typename Ctr>
+concept resizable_sequence = std::ranges::sized_range<Ctr> &&
+  std::is_lvalue_reference_v<std::ranges::range_reference_t<Ctr>> &&
+  requires (Ctr& ctr) { ctr.resize(std::size_t{}); };
+
+// a count read from a checked source only reserves up to the number of remaining bytes
+template <supports_endian_extract_buffer Src, typename Cnt>
+constexpr std::size_t reserve_count(const Src& src, Cnt cnt) noexcept {
+  if constexpr (checked_extract_buffer<Src>) {
+    return std::min(static_cast<std::size_t>(cnt), src.remaining());
+  }
+  else {
+    return static_cast<std::size_t>(cnt);
+  }
+}
+
+// construct an object using an allocator, including the fields of an aggregate, since
+// an aggregate is not itself allocator-aware
+template <typename T, typename Alloc>
+T construct_with(const Alloc& alloc) {
+  if constexpr (std::uses_allocator_v<T, Alloc>) {
+    return std::make_obj_using_allocator<T>(alloc);
+  }
+  else if constexpr (field_enumerable<T>) {
+    if constexpr (aggregate_field_count<T> != 0u && aggregate_field_count<T> <= max_aggregate_fields) {
+      using fields = decltype(tie_fields(std::declval<T&>()));
+      return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+        return T { construct_with<std::remove_cvref_t<std::tuple_element_t<Is, fields>>>(alloc)... };
+      } (std::make_index_sequence<aggregate_field_count<T>>{});
+    }
+    else {
+      return T { };
+    }
+  }
+  else {
+    return T { };
+  }
+}
+
+// a new object while decoding, using the memory resource of the buffer if there is one
+template <typename T, supports_endian_extract_buffer Src>
+constexpr T make_value(const Src& src) {
+  if constexpr (has_memory_resource<Src>) {
+    return construct_with<T>(std::pmr::polymorphic_allocator<>(src.resource()));
+  }
+  else {
+    return T { };
+  }
+}
+
+// a new element of a container, using the allocator of the container if the element is
+// allocator-aware
+template <typename T, supports_endian_extract_buffer Src, typename Ctr>
+constexpr T make_elem(const Src& src, const Ctr& ctr) {
+  if constexpr (requires { ctr.get_allocator(); }) {
+    if constexpr (std::uses_allocator_v<T, decltype(ctr.get_allocator())>) {
+      return std::make_obj_using_allocator<T>(ctr.get_allocator());
+    }
+    else {
+      return make_value<T>(src);
+    }
+  }
+  else {
+    return make_value<T>(src);
+  }
+}
+
+template <typename Fmt>
+consteval std::size_t max_size_of() noexcept {
+  if constexpr (fixed_size_format<Fmt>) {
+    return format_traits<Fmt>::fixed_size;
+  }
+  else {
+    return format_traits<Fmt>::max_size;
+  }
+}
+
+} // end detail namespace
+
+// cast type, the fundamental fixed size format
+template <integral_or_byte CastVal>
+struct format_traits<CastVal> {
+  static constexpr bool is_fixed_size = true;
+  static constexpr std::size_t fixed_size = sizeof(CastVal);
+
+  using bulk_type = CastVal;
+  template <typename T>
+  static constexpr bool is_bulk_rep = detail::integral_or_enum<T> && !std::same_as<T, bool> &&
+                                      !std::same_as<CastVal, bool> && sizeof(T) == sizeof(CastVal);
+
+  template <std::endian Endian, detail::integral_or_enum T>
+  static constexpr std::size_t append(std::byte* buf, const T& val) noexcept {
+    return append_val<Endian>(buf, static_cast<CastVal>(val));
+  }
+  template <std::endian Endian, detail::integral_or_enum T>
+  static constexpr std::size_t extract(const std::byte* buf, T& val) noexcept {
+    val = static_cast<T>(extract_val<Endian, CastVal>(buf));
+    return sizeof(CastVal);
+  }
+};
+
+template <typename CastVal, auto ... MaxVal>
+struct format_traits<enum_fmt<CastVal, MaxVal...>> {
+  static constexpr bool is_fixed_size = true;
+  static constexpr std::size_t fixed_size = sizeof(CastVal);
+
+  static constexpr bool has_max = sizeof...(MaxVal) != 0u;
+
+  // std::numeric_limits is not specialized for std::byte
+  using cast_int = std::conditional_t<std::same_as<CastVal, std::byte>, unsigned char, CastVal>;
+
+  // only without a maximum, since otherwise each value must be checked
+  using bulk_type = CastVal;
+  template <typename T>
+  static constexpr bool is_bulk_rep = std::is_enum_v<T> && !has_max && sizeof(T) == sizeof(CastVal);
+
+  // widen to the largest integer of the same signedness, so that the comparisons
+  // below work for every cast and underlying type, including std::byte and char
+  template <typename I>
+  static constexpr auto widen(I v) noexcept {
+    if constexpr (std::is_signed_v<I>) {
+      return static_cast<std::intmax_t>(v);
+    }
+    else {
+      return static_cast<std::uintmax_t>(v);
+    }
+  }
+
+  template <typename T>
+  static consteval bool check_max() noexcept {
+    if constexpr (has_max) {
+      static_assert((std::same_as<decltype(MaxVal), T> && ...), "Maximum value must be of the enum type");
+      using U = std::underlying_type_t<T>;
+      constexpr U max_u = (static_cast<U>(MaxVal), ...);
+      static_assert(std::cmp_greater_equal(widen(max_u), 0), "Maximum enum value must not be negative");
+      static_assert(std::cmp_less_equal(widen(max_u), widen(std::numeric_limits<cast_int>::max())),
+                    "Maximum enum value does not fit in the cast type");
+    }
+    return true;
+  }
+
+  // with a maximum the valid range is zero through the maximum, otherwise any value
+  // representable in both the cast type and the underlying type
+  template <typename T, typename I>
+  static constexpr bool in_range_of(I v) noexcept {
+    using U = std::underlying_type_t<T>;
+    const auto w = widen(v);
+    if constexpr (has_max) {
+      return std::cmp_greater_equal(w, 0) && std::cmp_less_equal(w, widen((static_cast<U>(MaxVal), ...)));
+    }
+    else {
+      return std::cmp_greater_equal(w, widen(std::numeric_limits<U>::min())) &&
+             std::cmp_less_equal(w, widen(std::numeric_limits<U>::max())) &&
+             std::cmp_greater_equal(w, widen(std::numeric_limits<cast_int>::min())) &&
+             std::cmp_less_equal(w, widen(std::numeric_limits<cast_int>::max()));
+    }
+  }
+
+  template <typename T>
+  static constexpr bool in_range(T val) noexcept {
+    return in_range_of<T>(static_cast<std::underlying_type_t<T>>(val));
+  }
+
+  // the wire value is compared before any conversion, so negative or too wide values
+  // are not truncated into range
+  template <std::endian Endian>
+    requires (has_max)
+  static constexpr bool is_valid(const std::byte* buf) noexcept {
+    return in_range_of<decltype((MaxVal, ...))>(extract_val<Endian, CastVal>(buf));
+  }
+  // without a maximum the range depends on the enum type decoded into
+  template <std::endian Endian, typename T>
+    requires std::is_enum_v<T>
+  static constexpr bool is_valid_as(const std::byte* buf) noexcept {
+    static_assert(check_max<T>());
+    return in_range_of<T>(extract_val<Endian, CastVal>(buf));
+  }
+
+  template <std::endian Endian, typename T>
+    requires std::is_enum_v<T>
+  static constexpr std::size_t append(std::byte* buf, const T& val) noexcept {
+    static_assert(check_max<T>());
+    assert(in_range(val));
+    return append_val<Endian>(buf, static_cast<CastVal>(val));
+  }
+  template <std::endian Endian, typename T>
+    requires std::is_enum_v<T>
+  static constexpr std::size_t extract(const std::byte* buf, T& val) noexcept {
+    static_assert(check_max<T>());
+    // checked decoding has already rejected a wire value outside the range (is_valid_as)
+    val = static_cast<T>(extract_val<Endian, CastVal>(buf));
+    return sizeof(CastVal);
+  }
+};
+
+template <typename CastRep, typename WirePeriod>
+struct format_traits<chrono_fmt<CastRep, WirePeriod>> {
+  static constexpr bool is_fixed_size = true;
+  static constexpr std::size_t fixed_size = sizeof(CastRep);
+
+  template <typename Dur>
+  using wire_duration = std::chrono::duration<typename Dur::rep,
+    std::conditional_t<std::is_void_v<WirePeriod>, typename Dur::period, WirePeriod>>;
+
+  template <typename T>
+  static constexpr auto as_duration(const T& val) noexcept {
+    if constexpr (detail::is_time_point<T>::value) {
+      return val.time_since_epoch();
+    }
+    else {
+      return val;
+    }
+  }
+
+  template <typename Dur>
+  static constexpr bool is_bulk_dur() noexcept {
+    if constexpr (std::is_void_v<WirePeriod>) {
+      return std::integral<typename Dur::rep> && sizeof(typename Dur::rep) == sizeof(CastRep);
+    }
+    else {
+      return std::integral<typename Dur::rep> && sizeof(typename Dur::rep) == sizeof(CastRep) &&
+             std::ratio_equal_v<typename Dur::period, WirePeriod>;
+    }
+  }
+
+  // no unit conversion and the tick count has the same size as the cast type
+  using bulk_type = CastRep;
+  template <typename T>
+  static constexpr bool is_bulk_rep = [] {
+    if constexpr (detail::chrono_type<T>) {
+      return is_bulk_dur<typename T::duration>();
+    }
+    else {
+      return false;
+    }
+  } ();
+
+  template <std::endian Endian, detail::chrono_type T>
+  static constexpr std::size_t append(std::byte* buf, const T& val) noexcept {
+    auto dur = as_duration(val);
+    auto cnt = std::chrono::duration_cast<wire_duration<decltype(dur)>>(dur).count();
+    return append_val<Endian>(buf, static_cast<CastRep>(cnt));
+  }
+  template <std::endian Endian, detail::chrono_type T>
+  static constexpr std::size_t extract(const std::byte* buf, T& val) noexcept {
+    using dur_type = typename T::duration;
+    using wire_type = wire_duration<dur_type>;
+    auto dur = std::chrono::duration_cast<dur_type>(
+        wire_type(static_cast<typename wire_type::rep>(extract_val<Endian, CastRep>(buf))));
+    val = T(dur);
+    return sizeof(CastRep);
+  }
+};
+
+template <typename CastCnt, typename ElemFmt, std::size_t MaxCnt>
+struct format_traits<seq_fmt<CastCnt, ElemFmt, MaxCnt>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size =
+    detail::sat_add(sizeof(CastCnt), detail::sat_mul(MaxCnt, detail::max_size_of<ElemFmt>()));
+
+  template <std::ranges::sized_range Ctr>
+  static constexpr std::size_t encoded_size(const Ctr& ctr) {
+    if constexpr (fixed_size_format<ElemFmt>) {
+      return sizeof(CastCnt) + std::ranges::size(ctr) * format_traits<ElemFmt>::fixed_size;
+    }
+    else {
+      std::size_t sz { sizeof(CastCnt) };
+      for (const auto& elem : ctr) {
+        sz += detail::encoded_size_fmt<ElemFmt>(elem);
+      }
+      return sz;
+    }
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+  static constexpr Buf& marshall(Buf& buf, const Ctr& ctr) {
+    auto cnt = static_cast<std::size_t>(std::ranges::size(ctr));
+    detail::check_count<CastCnt, MaxCnt>(cnt);
+    if constexpr (fixed_size_format<ElemFmt>) {
+      // single resize for the count and all of the elements
+      using elem_traits = format_traits<ElemFmt>;
+      constexpr auto endian = Buf::endian_type::value;
+      auto old_sz = buf.size();
+      buf.resize(old_sz + sizeof(CastCnt) + cnt * elem_traits::fixed_size);
+      std::byte* ptr = buf.data() + old_sz;
+      ptr += append_val<endian>(ptr, static_cast<CastCnt>(cnt));
+      if constexpr (detail::is_bulk_convertible<ElemFmt, Ctr>()) {
+        detail::append_bulk<endian, typename elem_traits::bulk_type>(ptr, std::ranges::data(ctr), cnt);
+      }
+      else {
+        for (const auto& elem : ctr) {
+          ptr += elem_traits::template append<endian>(ptr, elem);
+        }
+      }
+    }
+    else {
+      detail::serialize_val<CastCnt>(buf, cnt);
+      for (const auto& elem : ctr) {
+        detail::marshall_fmt<ElemFmt>(buf, elem);
+      }
+    }
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr) { typename Ctr::value_type; ctr.clear(); ctr.end(); }
+  // the container is decoded into, rather than replaced: a resizable container keeps its
+  // capacity and its existing elements (and their own capacity) are reused
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    if (static_cast<std::size_t>(cnt) > MaxCnt) {
+      ctr.clear();
+      detail::fail_decode(src, decode_error::count_too_large);
+      return src;
+    }
+    if constexpr (fixed_size_format<ElemFmt>) {
+      // all of the elements are checked as one run, then extracted without further checks
+      using elem_traits = format_traits<ElemFmt>;
+      constexpr auto endian = Src::endian_type::value;
+      std::size_t run = detail::sat_mul(cnt, elem_traits::fixed_size);
+      if (!detail::has_bytes(src, run)) {
+        ctr.clear();
+        return src;
+      }
+      if constexpr (checked_extract_buffer<Src>) {
+        if (!detail::valid_fixed_run_as<ElemFmt, endian, typename Ctr::value_type>(src.data(), cnt)) {
+          ctr.clear();
+          detail::fail_decode(src, decode_error::invalid_value);
+          return src;
+        }
+      }
+      const std::byte* ptr = src.data();
+      if constexpr (detail::resizable_sequence<Ctr>) {
+        ctr.resize(cnt);
+        if constexpr (detail::is_bulk_convertible<ElemFmt, Ctr>()) {
+          detail::extract_bulk<endian, typename elem_traits::bulk_type>(ptr, std::ranges::data(ctr), cnt);
+        }
+        else {
+          for (auto& elem : ctr) {
+            ptr += elem_traits::template extract<endian>(ptr, elem);
+          }
+        }
+      }
+      else {
+        ctr.clear();
+        if constexpr (requires { ctr.reserve(std::size_t{}); }) {
+          ctr.reserve(cnt);
+        }
+        for (CastCnt i {0u}; i < cnt; ++i) {
+          typename Ctr::value_type elem { };
+          ptr += elem_traits::template extract<endian>(ptr, elem);
+          ctr.insert(ctr.end(), std::move(elem));
+        }
+      }
+      src.advance(run);
+    }
+    else {
+      std::size_t num_reused {0u};
+      if constexpr (detail::resizable_sequence<Ctr>) {
+        num_reused = std::min(std::ranges::size(ctr), static_cast<std::size_t>(cnt));
+        ctr.resize(num_reused);
+        for (auto& elem : ctr) {
+          detail::unmarshall_fmt<ElemFmt>(src, elem);
+        }
+      }
+      else {
+        ctr.clear();
+      }
+      // an untrusted count cannot reserve more elements than there are bytes remaining
+      if constexpr (requires { ctr.reserve(std::size_t{}); }) {
+        ctr.reserve(num_reused + detail::reserve_count(src, cnt - num_reused));
+      }
+      for (std::size_t i {num_reused}; i < cnt && detail::decode_ok(src); ++i) {
+        auto elem = detail::make_elem<typename Ctr::value_type>(src, ctr);
+        detail::unmarshall_fmt<ElemFmt>(src, elem);
+        ctr.insert(ctr.end(), std::move(elem));
+      }
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    if (static_cast<std::size_t>(cnt) > MaxCnt) {
+      detail::fail_decode(src, decode_error::count_too_large);
+      return;
+    }
+    if constexpr (fixed_size_format<ElemFmt>) {
+      std::size_t run = detail::sat_mul(cnt, format_traits<ElemFmt>::fixed_size);
+      if (!detail::has_bytes(src, run)) {
+        return;
+      }
+      if (!detail::valid_fixed_run<ElemFmt, Src::endian_type::value>(src.data(), cnt)) {
+        detail::fail_decode(src, decode_error::invalid_value);
+        return;
+      }
+      src.advance(run);
+    }
+    else {
+      for (CastCnt i {0u}; i < cnt && src.ok(); ++i) {
+        detail::validate_fmt<ElemFmt>(src);
+      }
+    }
+  }
+};
+
+template <typename CastCnt, typename KeyFmt, typename ValFmt, std::size_t MaxCnt>
+struct format_traits<map_fmt<CastCnt, KeyFmt, ValFmt, MaxCnt>> {
+  static constexpr bool is_fixed_size = false;
+
+  // each element is a std::pair, so encoding is a sequence of key and value tuples
+  using seq_traits = format_traits<seq_fmt<CastCnt, tuple_fmt<KeyFmt, ValFmt>, MaxCnt>>;
+
+  static constexpr std::size_t max_size = seq_traits::max_size;
+
+  template <std::ranges::sized_range Ctr>
+    requires requires { typename Ctr::key_type; typename Ctr::mapped_type; }
+  static constexpr std::size_t encoded_size(const Ctr& ctr) {
+    return seq_traits::encoded_size(ctr);
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+    requires requires { typename Ctr::key_type; typename Ctr::mapped_type; }
+  static constexpr Buf& marshall(Buf& buf, const Ctr& ctr) {
+    return seq_traits::marshall(buf, ctr);
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr, typename Ctr::key_type k, typename Ctr::mapped_type v) {
+      ctr.clear();
+      ctr.emplace_hint(ctr.end(), std::move(k), std::move(v));
+    }
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    ctr.clear();
+    if (static_cast<std::size_t>(cnt) > MaxCnt) {
+      detail::fail_decode(src, decode_error::count_too_large);
+      return src;
+    }
+    if constexpr (requires { ctr.reserve(std::size_t{}); }) {
+      ctr.reserve(detail::reserve_count(src, cnt));
+    }
+    for (CastCnt i {0u}; i < cnt && detail::decode_ok(src); ++i) {
+      auto key = detail::make_elem<typename Ctr::key_type>(src, ctr);
+      auto val = detail::make_elem<typename Ctr::mapped_type>(src, ctr);
+      detail::unmarshall_fmt<KeyFmt>(src, key);
+      detail::unmarshall_fmt<ValFmt>(src, val);
+      ctr.emplace_hint(ctr.end(), std::move(key), std::move(val));
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    seq_traits::validate(src);
+  }
+};
+
+template <typename CastBool, typename ValFmt>
+struct format_traits<opt_fmt<CastBool, ValFmt>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size = detail::sat_add(sizeof(CastBool), detail::max_size_of<ValFmt>());
+
+  template <typename T>
+  static constexpr std::size_t encoded_size(const std::optional<T>& val) {
+    return sizeof(CastBool) + (val.has_value() ? detail::encoded_size_fmt<ValFmt>(*val) : 0u);
+  }
+
+  template <supports_endian_expandable_buffer Buf, typename T>
+  static constexpr Buf& marshall(Buf& buf, const std::optional<T>& val) {
+    detail::serialize_val<CastBool>(buf, val.has_value() ? 1 : 0);
+    if (val.has_value()) {
+      detail::marshall_fmt<ValFmt>(buf, *val);
+    }
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, typename T>
+  static constexpr Src& unmarshall(Src& src, std::optional<T>& val) {
+    auto flag = detail::unserialize_val<CastBool>(src);
+    if (flag == static_cast<CastBool>(0)) {
+      val.reset();
+      return src;
+    }
+    if (flag != static_cast<CastBool>(1)) {
+      val.reset();
+      detail::fail_decode(src, decode_error::invalid_value);
+      return src;
+    }
+    if (!val.has_value()) {
+      if constexpr (has_memory_resource<Src>) {
+        val.emplace(detail::make_value<T>(src));
+      }
+      else {
+        val.emplace();
+      }
+    }
+    return detail::unmarshall_fmt<ValFmt>(src, *val);
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto flag = detail::unserialize_val<CastBool>(src);
+    if (flag == static_cast<CastBool>(0)) {
+      return;
+    }
+    if (flag != static_cast<CastBool>(1)) {
+      detail::fail_decode(src, decode_error::invalid_value);
+      return;
+    }
+    detail::validate_fmt<ValFmt>(src);
+  }
+};
+
+template <typename CastDisc, typename ... AltFmts>
+struct format_traits<variant_fmt<CastDisc, AltFmts...>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size =
+    detail::sat_add(sizeof(CastDisc), std::max({ detail::max_size_of<AltFmts>()... }));
+
+  template <std::size_t I>
+  using alt_fmt = std::tuple_element_t<I, std::tuple<AltFmts...>>;
+
+  template <typename Buf, typename Var>
+  using encode_fn = Buf& (*)(Buf&, const Var&);
+
+  template <typename Src, typename Var>
+  using decode_fn = Src& (*)(Src&, Var&);
+
+  template <typename Buf, typename Var>
+  static constexpr std::array<encode_fn<Buf, Var>, sizeof...(AltFmts)> encode_table =
+    []<std::size_t ... Is>(std::index_sequence<Is...>) {
+      return std::array<encode_fn<Buf, Var>, sizeof...(AltFmts)> {
+        +[] (Buf& buf, const Var& val) -> Buf& {
+          detail::serialize_val<CastDisc>(buf, Is);
+          return detail::marshall_fmt<alt_fmt<Is>>(buf, *std::get_if<Is>(&val));
+        } ...
+      };
+    } (std::index_sequence_for<AltFmts...>{});
+
+  // each decoder reuses the current alternative if it matches, otherwise constructs the
+  // alternative in place, then fills it in
+  template <typename Src, typename Var>
+  static constexpr std::array<decode_fn<Src, Var>, sizeof...(AltFmts)> decode_table =
+    []<std::size_t ... Is>(std::index_sequence<Is...>) {
+      return std::array<decode_fn<Src, Var>, sizeof...(AltFmts)> {
+        +[] (Src& src, Var& val) -> Src& {
+          if (val.index() == Is) {
+            return detail::unmarshall_fmt<alt_fmt<Is>>(src, *std::get_if<Is>(&val));
+          }
+          if constexpr (has_memory_resource<Src>) {
+            using alt_type = std::variant_alternative_t<Is, Var>;
+            return detail::unmarshall_fmt<alt_fmt<Is>>(src, val.template emplace<Is>(detail::make_value<alt_type>(src)));
+          }
+          else {
+            return detail::unmarshall_fmt<alt_fmt<Is>>(src, val.template emplace<Is>());
+          }
+        } ...
+      };
+    } (std::index_sequence_for<AltFmts...>{});
+
+  template <typename ... Ts>
+    requires (sizeof...(Ts) == sizeof...(AltFmts))
+  static constexpr std::size_t encoded_size(const std::variant<Ts...>& val) {
+    assert(!val.valueless_by_exception());
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      std::size_t sz { sizeof(CastDisc) };
+      ((val.index() == Is ? (sz += detail::encoded_size_fmt<alt_fmt<Is>>(*std::get_if<Is>(&val))) : sz), ...);
+      return sz;
+    } (std::index_sequence_for<AltFmts...>{});
+  }
+
+  template <supports_endian_expandable_buffer Buf, typename ... Ts>
+    requires (sizeof...(Ts) == sizeof...(AltFmts))
+  static constexpr Buf& marshall(Buf& buf, const std::variant<Ts...>& val) {
+    assert(!val.valueless_by_exception());
+    return encode_table<Buf, std::variant<Ts...>>[val.index()](buf, val);
+  }
 
-namespace chops {
+  template <supports_endian_extract_buffer Src, typename ... Ts>
+    requires (sizeof...(Ts) == sizeof...(AltFmts))
+  static constexpr Src& unmarshall(Src& src, std::variant<Ts...>& val) {
+    auto disc = detail::unserialize_val<CastDisc>(src);
+    if (static_cast<std::size_t>(disc) >= sizeof...(AltFmts)) {
+      detail::fail_decode(src, decode_error::invalid_discriminant);
+      return src;
+    }
+    return decode_table<Src, std::variant<Ts...>>[disc](src, val);
+  }
 
-template <typename Ctr>
-concept supports_expandable_buffer = 
-  std::same_as<Ctr::value_type, std::byte> &&
-  requires (Ctr ctr) {
-    { ctr.size() } -> std::integral;
-    ctr.resize(std::size_t{});
-    { ctr.data() } -> std::same_as<std::byte*>;
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto disc = detail::unserialize_val<CastDisc>(src);
+    if (static_cast<std::size_t>(disc) >= sizeof...(AltFmts)) {
+      detail::fail_decode(src, decode_error::invalid_discriminant);
+      return;
+    }
+    [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      ((static_cast<std::size_t>(disc) == Is ? detail::validate_fmt<alt_fmt<Is>>(src) : void()), ...);
+    } (std::index_sequence_for<AltFmts...>{});
   }
+};
 
-template <typename Ctr>
-concept supports_endian_expandable_buffer = 
-  supports_expandable_buffer<Ctr> &&
-  requires (Ctr ctr) { 
-    typename Ctr::endian_type;
+template <typename ... ElemFmts>
+struct format_traits<tuple_fmt<ElemFmts...>> {
+  static constexpr std::size_t num_elems = sizeof...(ElemFmts);
+  static constexpr bool is_fixed_size = (fixed_size_format<ElemFmts> && ...);
+  static constexpr std::size_t fixed_size = (std::size_t{0u} + ... + detail::fixed_size_or_zero<ElemFmts>());
+  static constexpr std::size_t max_size = [] {
+    std::size_t sz {0u};
+    ((sz = detail::sat_add(sz, detail::max_size_of<ElemFmts>())), ...);
+    return sz;
+  } ();
+
+  template <std::size_t I>
+  using elem_fmt = std::tuple_element_t<I, std::tuple<ElemFmts...>>;
+
+  static constexpr std::array<bool, num_elems> fixed_elems { fixed_size_format<ElemFmts>... };
+  static constexpr std::array<std::size_t, num_elems> elem_sizes { detail::fixed_size_or_zero<ElemFmts>()... };
+
+  // number of bytes in the run of consecutive fixed size elements starting at an index
+  static constexpr std::size_t run_size(std::size_t idx) noexcept {
+    std::size_t sz {0u};
+    for (; idx < num_elems && fixed_elems[idx]; ++idx) {
+      sz += elem_sizes[idx];
+    }
+    return sz;
   }
 
-template <supports_expandable_buffer Ctr = chops::mutable_shared_buffer,
-         std::endian Endian = std::endian::little>
-class expandable_buffer {
-private:
-  Ctr      m_ctr;
-public:
-  using endian_type = Endian;
-  using value_type = std::byte;
-  Ctr& get_buf() noexcept { return m_ctr; }
-  std::size_t size() noexcept { return m_ctr.size(); }
-  std::byte* data() noexcept { return m_ctr.data(); }
-  void resize(std::size_t sz) noexcept m_ctr.resize(sz); }
+  template <std::endian Endian, tuple_like_of_size<num_elems> T>
+    requires (is_fixed_size)
+  static constexpr std::size_t append(std::byte* buf, const T& val) noexcept {
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      std::size_t offset {0u};
+      ((offset += format_traits<elem_fmt<Is>>::template append<Endian>(buf + offset, std::get<Is>(val))), ...);
+      return offset;
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+
+  template <std::endian Endian, tuple_like_of_size<num_elems> T>
+    requires (is_fixed_size)
+  static constexpr std::size_t extract(const std::byte* buf, T& val) noexcept {
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      std::size_t offset {0u};
+      ((offset += format_traits<elem_fmt<Is>>::template extract<Endian>(buf + offset, std::get<Is>(val))), ...);
+      return offset;
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+
+  template <std::endian Endian>
+    requires (is_fixed_size)
+  static constexpr bool is_valid(const std::byte* buf) noexcept {
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      std::size_t offset {0u};
+      return ((detail::valid_fixed<elem_fmt<Is>, Endian>(buf + offset) && (offset += elem_sizes[Is], true)) && ...);
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+  template <std::endian Endian, tuple_like_of_size<num_elems> T>
+    requires (is_fixed_size)
+  static constexpr bool is_valid_as(const std::byte* buf) noexcept {
+    using U = std::remove_cvref_t<T>;
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      std::size_t offset {0u};
+      return ((detail::valid_fixed_as<elem_fmt<Is>, Endian, std::remove_cvref_t<std::tuple_element_t<Is, U>>>(buf + offset) &&
+               (offset += elem_sizes[Is], true)) && ...);
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+
+  // a run of fixed size elements is appended after a single resize at the start of the run
+  template <std::size_t I, supports_endian_expandable_buffer Buf, typename E>
+  static constexpr void marshall_elem(Buf& buf, const E& elem, std::byte*& ptr) {
+    if constexpr (fixed_elems[I]) {
+      bool run_start = true;
+      if constexpr (I != 0u) {
+        run_start = !fixed_elems[I - 1u];
+      }
+      if (run_start) {
+        auto old_sz = buf.size();
+        buf.resize(old_sz + run_size(I));
+        ptr = buf.data() + old_sz;
+      }
+      ptr += format_traits<elem_fmt<I>>::template append<Buf::endian_type::value>(ptr, elem);
+    }
+    else {
+      detail::marshall_fmt<elem_fmt<I>>(buf, elem);
+    }
+  }
+
+  template <tuple_like_of_size<num_elems> T>
+  static constexpr std::size_t encoded_size(const T& val) {
+    return [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      return (std::size_t{0u} + ... + detail::encoded_size_fmt<elem_fmt<Is>>(std::get<Is>(val)));
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+
+  template <supports_endian_expandable_buffer Buf, tuple_like_of_size<num_elems> T>
+  static constexpr Buf& marshall(Buf& buf, const T& val) {
+    std::byte* ptr = nullptr;
+    [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      (marshall_elem<Is>(buf, std::get<Is>(val), ptr), ...);
+    } (std::index_sequence_for<ElemFmts...>{});
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, tuple_like_of_size<num_elems> T>
+  static constexpr Src& unmarshall(Src& src, T& val) {
+    [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      (detail::unmarshall_fmt<elem_fmt<Is>>(src, std::get<Is>(val)), ...);
+    } (std::index_sequence_for<ElemFmts...>{});
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    [&]<std::size_t ... Is>(std::index_sequence<Is...>) {
+      (detail::validate_fmt<elem_fmt<Is>>(src), ...);
+    } (std::index_sequence_for<ElemFmts...>{});
+  }
+};
+
+template <std::size_t N, typename ElemFmt>
+struct format_traits<array_fmt<N, ElemFmt>> {
+  static constexpr bool is_fixed_size = fixed_size_format<ElemFmt>;
+  static constexpr std::size_t fixed_size = N * detail::fixed_size_or_zero<ElemFmt>();
+  static constexpr std::size_t max_size = detail::sat_mul(N, detail::max_size_of<ElemFmt>());
+
+  template <std::endian Endian, std::ranges::sized_range Ctr>
+    requires (is_fixed_size)
+  static constexpr std::size_t append(std::byte* buf, const Ctr& arr) noexcept {
+    assert(std::ranges::size(arr) == N);
+    if constexpr (detail::is_bulk_convertible<ElemFmt, Ctr>()) {
+      return detail::append_bulk<Endian, typename format_traits<ElemFmt>::bulk_type>(buf, std::ranges::data(arr), N);
+    }
+    else {
+      std::size_t offset {0u};
+      for (const auto& elem : arr) {
+        offset += format_traits<ElemFmt>::template append<Endian>(buf + offset, elem);
+      }
+      return offset;
+    }
+  }
+
+  template <std::endian Endian, std::ranges::sized_range Ctr>
+    requires (is_fixed_size)
+  static constexpr std::size_t extract(const std::byte* buf, Ctr& arr) noexcept {
+    assert(std::ranges::size(arr) == N);
+    if constexpr (detail::is_bulk_convertible<ElemFmt, Ctr>()) {
+      return detail::extract_bulk<Endian, typename format_traits<ElemFmt>::bulk_type>(buf, std::ranges::data(arr), N);
+    }
+    else {
+      std::size_t offset {0u};
+      for (auto& elem : arr) {
+        offset += format_traits<ElemFmt>::template extract<Endian>(buf + offset, elem);
+      }
+      return offset;
+    }
+  }
+
+  template <std::endian Endian>
+    requires (is_fixed_size)
+  static constexpr bool is_valid(const std::byte* buf) noexcept {
+    return detail::valid_fixed_run<ElemFmt, Endian>(buf, N);
+  }
+  template <std::endian Endian, std::ranges::sized_range Ctr>
+    requires (is_fixed_size)
+  static constexpr bool is_valid_as(const std::byte* buf) noexcept {
+    return detail::valid_fixed_run_as<ElemFmt, Endian, std::ranges::range_value_t<Ctr>>(buf, N);
+  }
+
+  template <std::ranges::sized_range Ctr>
+    requires (!is_fixed_size)
+  static constexpr std::size_t encoded_size(const Ctr& arr) {
+    std::size_t sz {0u};
+    for (const auto& elem : arr) {
+      sz += detail::encoded_size_fmt<ElemFmt>(elem);
+    }
+    return sz;
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+    requires (!is_fixed_size)
+  static constexpr Buf& marshall(Buf& buf, const Ctr& arr) {
+    assert(std::ranges::size(arr) == N);
+    for (const auto& elem : arr) {
+      detail::marshall_fmt<ElemFmt>(buf, elem);
+    }
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, std::ranges::sized_range Ctr>
+    requires (!is_fixed_size)
+  static constexpr Src& unmarshall(Src& src, Ctr& arr) {
+    assert(std::ranges::size(arr) == N);
+    for (auto& elem : arr) {
+      detail::unmarshall_fmt<ElemFmt>(src, elem);
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+    requires (!is_fixed_size)
+  static constexpr void validate(Src& src) {
+    for (std::size_t i {0u}; i < N && src.ok(); ++i) {
+      detail::validate_fmt<ElemFmt>(src);
+    }
+  }
+};
+
+template <typename ... FieldFmts>
+struct format_traits<fields_fmt<FieldFmts...>> {
+  using tuple_traits = format_traits<tuple_fmt<FieldFmts...>>;
+
+  static constexpr bool is_fixed_size = tuple_traits::is_fixed_size;
+  static constexpr std::size_t fixed_size = tuple_traits::fixed_size;
+  static constexpr std::size_t max_size = tuple_traits::max_size;
+
+  template <typename T>
+  static constexpr void check_fields() noexcept {
+    static_assert(aggregate_field_count<T> == sizeof...(FieldFmts),
+      "Number of field formats does not match number of aggregate fields");
+  }
+
+  // whole-struct path, each field is stored at a compile-time offset
+  template <std::endian Endian, field_enumerable T>
+    requires (is_fixed_size)
+  static constexpr std::size_t append(std::byte* buf, const T& val) noexcept {
+    check_fields<T>();
+    auto flds = tie_fields(val);
+    return tuple_traits::template append<Endian>(buf, flds);
+  }
+
+  template <std::endian Endian, field_enumerable T>
+    requires (is_fixed_size)
+  static constexpr std::size_t extract(const std::byte* buf, T& val) noexcept {
+    check_fields<T>();
+    auto flds = tie_fields(val);
+    return tuple_traits::template extract<Endian>(buf, flds);
+  }
+
+  template <std::endian Endian>
+    requires (is_fixed_size)
+  static constexpr bool is_valid(const std::byte* buf) noexcept {
+    return tuple_traits::template is_valid<Endian>(buf);
+  }
+  template <std::endian Endian, field_enumerable T>
+    requires (is_fixed_size)
+  static constexpr bool is_valid_as(const std::byte* buf) noexcept {
+    return tuple_traits::template is_valid_as<Endian, decltype(tie_fields(std::declval<T&>()))>(buf);
+  }
+
+  template <field_enumerable T>
+  static constexpr std::size_t encoded_size(const T& val) {
+    check_fields<T>();
+    auto flds = tie_fields(val);
+    return tuple_traits::encoded_size(flds);
+  }
+
+  template <supports_endian_expandable_buffer Buf, field_enumerable T>
+  static constexpr Buf& marshall(Buf& buf, const T& val) {
+    check_fields<T>();
+    auto flds = tie_fields(val);
+    return tuple_traits::marshall(buf, flds);
+  }
+
+  template <supports_endian_extract_buffer Src, field_enumerable T>
+  static constexpr Src& unmarshall(Src& src, T& val) {
+    check_fields<T>();
+    auto flds = tie_fields(val);
+    return tuple_traits::unmarshall(src, flds);
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    tuple_traits::validate(src);
+  }
 };
 
 /**
+ * @brief Concept that a value of type @c T can be marshalled with format @c Fmt.
+ */
+template <typename Fmt, typename Buf, typename T>
+concept marshallable_with =
+  (fixed_size_format<Fmt> &&
+     requires (std::byte* ptr, const T& val) {
+       format_traits<Fmt>::template append<std::endian::native>(ptr, val);
+     }) ||
+  (!fixed_size_format<Fmt> &&
+     requires (Buf& buf, const T& val) { format_traits<Fmt>::marshall(buf, val); });
+
+/**
+ * @brief Concept that a value of type @c T can be unmarshalled with format @c Fmt.
+ */
+template <typename Fmt, typename Src, typename T>
+concept unmarshallable_with =
+  (fixed_size_format<Fmt> &&
+     requires (const std::byte* ptr, T& val) {
+       format_traits<Fmt>::template extract<std::endian::native>(ptr, val);
+     }) ||
+  (!fixed_size_format<Fmt> &&
+     requires (Src& src, T& val) { format_traits<Fmt>::unmarshall(src, val); });
 
+/**
  * @brief Extract a sequence in network byte order from a @c std::byte buffer into the
  * provided container.
  *
@@ -198,13 +2046,13 @@ Container extract_sequence(const std::byte* buf) noexcept(fill in) {
 
 
 /**
- * @brief Append a sequence of elements, including the count, into a @c std::byte buffer using 
+ * @brief Append a sequence of elements, including the count, into a @c std::byte buffer using
  * the lower level @c append_val function.
  *
- * A sequence is defined as an array of elements of type T, along with the number of 
+ * A sequence is defined as an array of elements of type T, along with the number of
  * elements. When appending to a stream of @c std::bytes, the count is first converted
  * into network byte order and then appended, then the same performed for each element.
- * The number of bits in the count is specified as the type of the count. For example a 
+ * The number of bits in the count is specified as the type of the count. For example a
  * @c std::vector of 16-bit @c ints with an 8-bit count can be appended to the buffer as
  * an 8-bit integer, and then successive 16-bit integers.
  *
@@ -218,7 +2066,7 @@ Container extract_sequence(const std::byte* buf) noexcept(fill in) {
  *
  * @return Total number of bytes appended to the @c std::byte buffer.
  *
- * @pre The buffer must be large enough to contain the size of the count, plus all of 
+ * @pre The buffer must be large enough to contain the size of the count, plus all of
  * the elements in the sequence.
  *
  */
@@ -238,230 +2086,423 @@ std::size_t append_sequence(std::byte* buf, Cnt cnt, Iter start, Iter end) noexc
 */
 
 /**
- * @brief Adapt a @c std::array so that a fixed size @c std::byte array can be used with 
- * the @c chops::marshall function template as the @c Buf template parameter.
+ * @brief Compute the number of bytes a value occupies when serialized with a format.
+ *
+ * For a fixed size format this is a compile-time constant, otherwise the value is
+ * traversed (without serializing). The function is @c constexpr, so the size of a
+ * @c constexpr value can be used as a template argument.
  *
- * This class provides three methods (@c size, @c resize, @c data) as required 
- * by the @c Buf parameter type in the @c chops::marshall function template. 
+ * @tparam Fmt The format, see @c marshall.
  *
- * The logical size of the buffer is tracked. If @c resize is called and there 
- * is not enough room in the buffer an assert is fired.
+ * @param val Value to be serialized.
+ *
+ * @return Number of serialized bytes.
  *
  */
-template <std::size_t N>
-class fixed_size_byte_array {
-public:
+template <typename Fmt, typename T>
+constexpr std::size_t encoded_size(const T& val) {
+  return detail::encoded_size_fmt<Fmt>(val);
+}
+
 /**
- * @brief Default construct the @ fixed_size_byte_array.
+ * @brief Maximum number of bytes any value occupies when serialized with a format.
  *
+ * Sequence counts bound the number of elements (e.g. an 8 bit count implies at most 255
+ * elements, unless a smaller maximum is specified in the @c seq_fmt). If the maximum
+ * overflows a @c std::size_t the value is @c unbounded_size.
  */
-  fixed_size_byte_array() noexcept : m_buf(), m_size(0u) { }
+template <typename Fmt>
+inline constexpr std::size_t max_encoded_size = detail::max_size_of<Fmt>();
 
 /**
- * @brief Return the size of the data which has been written into the buffer.
+ * @brief Concept for a format with a bounded maximum serialized size.
+ */
+template <typename Fmt>
+concept bounded_format = (max_encoded_size<Fmt> != unbounded_size);
+
+/**
+ * @brief A buffer with a capacity guaranteed to hold any value serialized with a bounded
+ * format, with no heap allocation and no runtime growth.
  *
- * @return The size of the data which has been written into the buffer, which is 
- * modified through the @c resize method.
+ * Sequence counts are checked against the maximum count of the format in all builds, so
+ * a value that does not conform to the format throws @c std::length_error instead of
+ * overrunning the buffer.
  *
+ * Example usage:
+ * @code
+ *   chops::bounded_buffer<order_fmt, std::endian::big> buf; // on the stack
+ *   chops::marshall<order_fmt>(buf, my_order);
+ * @endcode
  */
-  std::size_t size() const noexcept {
-    return m_size;
-  }
+template <bounded_format Fmt, std::endian Endian = std::endian::little>
+using bounded_buffer = expandable_buffer<fixed_size_byte_array<max_encoded_size<Fmt>>, Endian>;
+
 /**
- * @brief Increase the logical size, allowing bytes to be appended.
+ * @brief Serialize a value into a @c std::array of @c std::bytes, usable in constant
+ * evaluation so that fixed messages (headers, heartbeats, control frames) can be static
+ * data.
+ *
+ * For a fixed size format the array size is computed from the format. For a variable size
+ * format the size must be supplied, typically through @c encoded_size:
+ * @code
+ *   constexpr heartbeat hb { 1u, 42u };
+ *   constexpr auto hb_frame = chops::serialize_to_array<hb_fmt, std::endian::big>(hb);
+ *
+ *   constexpr hello_msg hello { "client-1", 3u };
+ *   constexpr auto hello_frame = chops::serialize_to_array<hello_fmt, std::endian::big,
+ *                                  chops::encoded_size<hello_fmt>(hello)>(hello);
+ * @endcode
+ *
+ * @tparam Fmt The format, see @c marshall.
+ *
+ * @tparam Endian The endianness of the serialized bytes.
+ *
+ * @tparam N The size of the array, which must equal the serialized size.
+ *
+ * @param val Value to be serialized.
+ *
+ * @return A @c std::array containing the serialized bytes.
  *
- * @param sz New logical size.
  */
-  void resize(std::size_t sz) noexcept {
-    assert(sz <= N);
-    m_size = sz;
-  }
+template <typename Fmt, std::endian Endian = std::endian::little,
+          std::size_t N = detail::fixed_size_or_zero<Fmt>(), typename T>
+constexpr std::array<std::byte, N> serialize_to_array(const T& val) {
+  static_assert(N != 0u, "Array size must be specified for a variable size format");
+  expandable_buffer<fixed_size_byte_array<N>, Endian> buf;
+  detail::marshall_fmt<Fmt>(buf, val);
+  assert(buf.size() == N);
+  return buf.get_buf().get_array();
+}
+
 /**
- * @brief Return a pointer to the beginning of the buffer.
+ * @brief Marshall a value into a buffer of bytes, as specified by a format.
+ *
+ * This is the "basic" @c marshall method, handling fundamental integral values (@c char,
+ * @c short, @c int, @c bool, etc) or a @c std::byte, as well as any value described by a format
+ * directive (sequences, @c std::optional, aggregates). This function template
+ * expands the buffer and appends the value to the buffer, performing byte swapping into the
+ * endianness of the buffer as needed. Single @c char and @c std::byte values will not be byte
+ * swapped.
+ *
+ * Example usage - marshall an @c int as an unsigned 16 bit value:
+ * @code
+ *   chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+ *   // ...
+ *   marshall<std::uint16_t>(buf, my_int);
+ * @endcode
+ *
+ * Example sequence usage - marshall a @c std::vector<int> with a 16 bit count and 32 bit elements:
+ * @code
+ *   marshall<chops::seq_fmt<std::uint16_t, std::int32_t>>(buf, my_vec);
+ * @endcode
+ *
+ * @tparam Fmt The format, either a fixed size integral type to be used for marshalling in the
+ * byte buffer (typically a type such as @c std::int32_t, @c std::uint32_t, @c std::uint16_t,
+ * etc) or a format directive such as @c seq_fmt; this type must always be supplied in the
+ * function call, since it is not deduced from the function arguments.
+ *
+ * @tparam Buf The buffer type, which must contain an array of @c std::bytes, must support
+ * @c size, @c resize, and @c data methods, and must declare an @c endian_type;
+ * @c chops::expandable_buffer satisfies this requirement.
+ *
+ * @tparam T Type of value to be marshalled (typically deduced).
+ *
+ * @param buf Buffer to store marshalled value, @c resize will be called to expand buffer.
+ *
+ * @param val Value to be marshalled.
  *
- * @return A pointer to the beginning of the buffer.
  */
-  std::byte* data() noexcept {
-    return m_buf.data();
-  }
+template <typename Fmt, supports_endian_expandable_buffer Buf, typename T>
+  requires marshallable_with<Fmt, Buf, T>
+constexpr Buf& marshall(Buf& buf, const T& val) {
+  return detail::marshall_fmt<Fmt>(buf, val);
+}
+
 /**
- * @brief Logically reset so that new data can be written into the buffer
- * at the beginning.
+ * @brief Marshall a value of an application type with an associated @c serialize_format.
+ *
+ * @param buf Buffer to store marshalled value.
+ *
+ * @param val Value to be marshalled.
+ *
  */
-  void clear() noexcept {
-    m_size = 0u;
-  }
-  
-private:
-  std::array<std::byte, N> m_buf;
-  std::size_t              m_size;
-};
-
-
-// add a function parameter to the function overload set so that std::vector<std::byte> and 
-// similar can be used for the Buf template parameter
-struct adl_tag { };
-
+template <supports_endian_expandable_buffer Buf, has_serialize_format T>
+constexpr Buf& marshall(Buf& buf, const T& val) {
+  return detail::marshall_fmt<serialize_format_t<T>>(buf, val);
+}
 
-namespace detail {
+/**
+ * @brief Unmarshall a value from a buffer of bytes, as specified by a format.
+ *
+ * This is the converse of @c marshall, and the same formats are used. The value is
+ * decoded into, rather than replaced, so a steady state consumer reusing its objects does
+ * not allocate: a resizable sequence (e.g. @c std::vector, @c std::string) is resized and
+ * its existing elements are decoded in place, using a bulk copy for arithmetic elements,
+ * and an engaged @c std::optional or matching @c std::variant alternative is reused.
+ * Other sequences are cleared before the elements are inserted.
+ *
+ * @tparam Fmt The format, see @c marshall.
+ *
+ * @tparam Src The buffer type, which must support @c data, @c remaining, and @c advance
+ * methods, and must declare an @c endian_type; @c chops::extract_buffer satisfies this
+ * requirement.
+ *
+ * @tparam T Type of value to be unmarshalled (typically deduced).
+ *
+ * @param src Buffer containing the serialized bytes, the read position is advanced.
+ *
+ * @param val Value to be filled in.
+ *
+ * @pre The buffer must contain all of the serialized bytes for the value.
+ *
+ */
+template <typename Fmt, supports_endian_extract_buffer Src, typename T>
+  requires unmarshallable_with<Fmt, Src, T>
+constexpr Src& unmarshall(Src& src, T& val) {
+  return detail::unmarshall_fmt<Fmt>(src, val);
+}
 
-template <integral_or_byte CastTypeVal, integral_or_byte T, 
-          supports_endian_expandable_buf Buf = expandable_buffer>
-constexpr Buf& serialize_val(Buf& buf, const T& val) {
-  auto old_sz = buf.size();
-  buf.resize(old_sz + sizeof(CastTypeVal));
-  append_val<Buf::endian_type>(buf.data()+old_sz, static_cast<CastTypeVal>(val));
-  return buf;
+/**
+ * @brief Unmarshall a value of an application type with an associated @c serialize_format.
+ *
+ * @param src Buffer containing the serialized bytes.
+ *
+ * @param val Value to be filled in.
+ *
+ */
+template <supports_endian_extract_buffer Src, has_serialize_format T>
+constexpr Src& unmarshall(Src& src, T& val) {
+  return detail::unmarshall_fmt<serialize_format_t<T>>(src, val);
 }
 
-template <integral_or_byte CastTypeVal, integral_or_byte T,
-          supports_endian_expandable Buf = chops::mutable_shared_buffer>
-constexpr Buf& serialize(Buf& buf, const T& val) {
-  return serialize_val<CastTypeVal> (buf, val);
+/**
+ * @brief Construct an object with a @c std::pmr::memory_resource, for decoding through a
+ * @c resource_buffer.
+ *
+ * An allocator-aware type is constructed with the resource, and an aggregate has each of
+ * its fields constructed with the resource (recursively), e.g. a @c struct of
+ * @c std::pmr::string and @c std::pmr::vector fields.
+ *
+ */
+template <typename T>
+T make_using_resource(std::pmr::memory_resource* res) {
+  return detail::construct_with<T>(std::pmr::polymorphic_allocator<>(res));
 }
 
-template <integral_or_byte CastTypeSz, integral_or_byte CastTypeVal,
-          integral_or_byte T,
-          supports_endian_expandable Buf = chops::mutable_shared_buffer>
-constexpr Buf& serialize(Buf& buf, const T* seq, std::size_t sz) {
-  serialize_val<CastTypeSz> (buf, sz);
-  for (int i {0}; i < sz; ++i) {
-    serialize_val<CastTypeVal>(buf, seq[i]);
-  }
-  return buf;
+/**
+ * @brief Unmarshall a value from a checked buffer such as @c read_cursor, reporting errors
+ * instead of relying on preconditions.
+ *
+ * @return @c decode_error::none on success, otherwise the first error encountered.
+ *
+ */
+template <typename Fmt, checked_extract_buffer Src, typename T>
+  requires unmarshallable_with<Fmt, Src, T>
+constexpr decode_error try_unmarshall(Src& src, T& val) {
+  detail::unmarshall_fmt<Fmt>(src, val);
+  return src.error();
 }
 
-template <integral_or_byte CastTypeSz,
-          supports_endian_expandable Buf = chops::mutable_shared_buffer>
-constexpr Buf& serialize(Buf& buf, const std::string& str) {
-  return serialize<CastTypeSz, std::byte> (buf, str.data(), std.size());
+/**
+ * @brief Validate the structure of a serialized value in a single pass, without
+ * materializing any objects.
+ *
+ * Counts are checked against the maximum count of the format and against the remaining
+ * bytes, optional flags must be 0 or 1, variant discriminants must select an alternative,
+ * and enum values must be within the maximum of an @c enum_fmt. Fixed size runs are checked
+ * once. A value that validates can then be unmarshalled through an (unchecked)
+ * @c extract_buffer, so the checking and decoding costs are separated and invalid input is
+ * rejected without any allocations.
+ *
+ * @param src Checked buffer such as @c read_cursor, the read position is advanced past the
+ * value (so consecutive values in a buffer can be validated).
+ *
+ * @return @c decode_error::none if the value is valid, otherwise the first error encountered.
+ *
+ */
+template <typename Fmt, checked_extract_buffer Src>
+constexpr decode_error validate(Src& src) {
+  detail::validate_fmt<Fmt>(src);
+  return src.error();
 }
 
-template <integral_or_byte CastTypeBool, integral_or_byte CastTypeVal,
-          integral_or_byte T,
-          supports_endian_expandable Buf = chops::mutable_shared_buffer>
-constexpr Buf& serialize(Buf& buf, const std::optional<T>& val) {
-  if (val) 
-    serialize_val<CastTypeBool> (buf, 1);
-    return serialize_val<CastTypeVal> (buf, *val);
+/**
+ * @brief Validate that a buffer contains exactly one serialized value.
+ *
+ * @return @c decode_error::none if the value is valid and there are no bytes remaining,
+ * @c decode_error::trailing_bytes if bytes remain, otherwise the first error encountered.
+ *
+ */
+template <typename Fmt, std::endian Endian = std::endian::little>
+constexpr decode_error validate(std::span<const std::byte> buf) {
+  read_cursor<Endian> src(buf);
+  if (auto err = validate<Fmt>(src); err != decode_error::none) {
+    return err;
   }
-  serialize_val<CastTypeBool> (buf, 0);
+  return src.remaining() == 0u ? decode_error::none : decode_error::trailing_bytes;
 }
 
+#ifdef __cpp_lib_expected
+/**
+ * @brief Unmarshall a value from a buffer of untrusted bytes, returning the value or the
+ * first error encountered.
+ *
+ * @note Only available when @c std::expected is available (C++ 23).
+ *
+ */
+template <typename Fmt, std::default_initializable T, std::endian Endian = std::endian::little>
+  requires unmarshallable_with<Fmt, read_cursor<Endian>, T>
+constexpr std::expected<T, decode_error> try_unmarshall(std::span<const std::byte> buf) {
+  read_cursor<Endian> src(buf);
+  T val { };
+  if (auto err = try_unmarshall<Fmt>(src, val); err != decode_error::none) {
+    return std::unexpected(err);
+  }
+  return val;
 }
-
+#endif
 
 /**
- * @brief Marshall a single arithmetic value or a @c std::byte into a buffer of bytes.
- *
- * This is the "basic" @c marshall method, handling fundamental arithmetic values (@c char, 
- * @c short, @c int, @c double, @c float, etc) or a @c std::byte, as well as the customization 
- * point for user defined types. This function template calls a lower level function template that
- * expands the buffer and appends the value to the buffer, performing byte swapping into big-endian 
- * format as needed. Single @c char and @c std::byte values will not be byte swapped.
+ * @brief Marshall a value as a frame, i.e. preceded by the number of bytes in the
+ * serialized value.
  *
- * Example usage - marshall an @c int as an unsigned 16 bit value:
- * @code
- *   std::vector<std::byte> buf;
- *   // ...
- *   marshall<std::uint16_t>(buf, my_int);
- * @endcode
+ * Frames can be located without decoding them, see @c index_frames. For a fixed size
+ * format the length is known in advance, otherwise it is back-patched after the value
+ * is marshalled. Bytes appended to an append only buffer (e.g. @c compressing_buffer or
+ * @c crc32c_buffer) can not be back-patched, so for these the length is computed first
+ * with @c encoded_size, which traverses the value twice.
  *
- * Example floating point usage - marshall a @c double:
- * @code
- *   std::vector<std::byte> buf;
- *   // ...
- *   marshall<double>(buf, my_double);
- * @endcode
+ * @tparam CastLen Type of the length.
  *
- * @tparam CastValType The fixed size type to be used for marshalling in the byte buffer,
- * typically a type such as @c std::int32_t, @c std::uint32_t, @c std::uint16_t, @c float,
- * etc; this type must always be supplied in the function call, since it is not
- * deduced from the function arguments. Note that there are no standard typedefs for floating
- * point types - use @c float or @c double as the casting type. 
+ * @throw std::length_error If the serialized value does not fit in a @c CastLen, in which
+ * case the buffer is left at its previous size. This can not happen (and is not checked)
+ * if the @c max_encoded_size of the format fits.
  *
- * @tparam T Type of value to be marshalled (typically deduced).
+ */
+template <std::unsigned_integral CastLen, typename Fmt, supports_endian_expandable_buffer Buf, typename T>
+  requires marshallable_with<Fmt, Buf, T>
+constexpr Buf& marshall_framed(Buf& buf, const T& val) {
+  constexpr auto endian = Buf::endian_type::value;
+  constexpr bool check_len = !bounded_format<Fmt> ||
+                             max_encoded_size<Fmt> > std::numeric_limits<CastLen>::max();
+  if constexpr (fixed_size_format<Fmt>) {
+    static_assert(format_traits<Fmt>::fixed_size <= std::numeric_limits<CastLen>::max());
+    detail::serialize_val<CastLen>(buf, format_traits<Fmt>::fixed_size);
+    return detail::marshall_fmt<Fmt>(buf, val);
+  }
+  else if constexpr (is_append_only<Buf>) {
+    auto len = detail::encoded_size_fmt<Fmt>(val);
+    if constexpr (check_len) {
+      if (len > std::numeric_limits<CastLen>::max()) {
+        throw std::length_error("serialized value does not fit in the frame length type");
+      }
+    }
+    detail::serialize_val<CastLen>(buf, static_cast<CastLen>(len));
+    return detail::marshall_fmt<Fmt>(buf, val);
+  }
+  else {
+    auto hdr = buf.size();
+    detail::serialize_val<CastLen>(buf, CastLen{0u});
+    detail::marshall_fmt<Fmt>(buf, val);
+    auto len = static_cast<std::size_t>(buf.size() - hdr) - sizeof(CastLen);
+    if constexpr (check_len) {
+      if (len > std::numeric_limits<CastLen>::max()) {
+        buf.resize(hdr);
+        throw std::length_error("serialized value does not fit in the frame length type");
+      }
+    }
+    append_val<endian>(buf.data() + hdr, static_cast<CastLen>(len));
+    return buf;
+  }
+}
+
+/**
+ * @brief Locate the frames in a batch of consecutive frames by scanning the lengths,
+ * without decoding the frames.
  *
- * @tparam Buf The buffer type, which must contain an array of @c std::bytes, and must support 
- * @c size, @c resize, and @c data methods; @c chops::mutable_shared_buffer,
- * @c std::vector<std::byte>, and @c chops::fixed_size_byte_array all satisfy this
- * requirement.
+ * @param batch Bytes of the frames, as created by @c marshall_framed.
  *
- * @param buf Buffer to store marshalled value, @c resize will be called to expand buffer.
+ * @param frames Filled in with the bytes of each frame, not including the length.
  *
- * @param val Value to be marshalled.
+ * @return @c decode_error::none, or @c decode_error::truncated if the last frame is
+ * incomplete (the complete frames are still indexed).
  *
  */
-template <typename CastValType, typename T, typename Buf = chops::mutable_shared_buffer,
-          typename = std::enable_if_t<detail::is_arithmetic_or_byte<T>()> >
-Buf& marshall(Buf& buf, const T& val) {
-  return marshall<CastValType>(buf, val, adl_tag { });
+template <std::unsigned_integral CastLen, std::endian Endian = std::endian::little>
+constexpr decode_error index_frames(std::span<const std::byte> batch,
+                                    std::vector<std::span<const std::byte>>& frames) {
+  frames.clear();
+  read_cursor<Endian> cur(batch);
+  while (cur.remaining() > 0u) {
+    auto len = static_cast<std::size_t>(detail::unserialize_val<CastLen>(cur));
+    if (!cur.ensure(len)) {
+      break;
+    }
+    frames.emplace_back(cur.data(), len);
+    cur.advance(len);
+  }
+  return cur.error();
 }
 
 // overloads for specific types
-template <typename CastBoolType, typename Buf = chops::mutable_shared_buffer>
-Buf& marshall(Buf& buf, bool b) {
-  return marshall<CastBoolType>(buf, static_cast<CastBoolType>(b ? 1 : 0));
+template <typename CastBoolType, typename CastValType,
+          supports_endian_expandable_buffer Buf, typename T>
+constexpr Buf& marshall(Buf& buf, const std::optional<T>& val) {
+  return marshall<opt_fmt<CastBoolType, CastValType>>(buf, val);
 }
 
-
-template <typename CastBoolType, typename CastValType, typename T, typename Buf = chops::mutable_shared_buffer>
-Buf& marshall(Buf& buf, const std::optional<T>& val) {
-  marshall<CastBoolType>(buf, val.has_value());
-  if (val.has_value()) {
-    if constexpr (detail::is_arithmetic_or_byte<T>()) {
-      marshall<CastValType>(buf, *val);
-    }
-    else { // *val should be a UDT
-      marshall(buf, *val);
-    }
-  }
-  return buf;
+template <typename CastBoolType, typename CastValType,
+          supports_endian_extract_buffer Src, typename T>
+constexpr Src& unmarshall(Src& src, std::optional<T>& val) {
+  return unmarshall<opt_fmt<CastBoolType, CastValType>>(src, val);
 }
 
 // overload for sequences
-template <typename CastCntType, typename CastValType, typename Iter, typename Buf = chops::mutable_shared_buffer,
-          typename T = typename std::iterator_traits<Iter>::value_type>
-Buf& marshall_seq(Buf& buf, std::size_t num_elems, Iter iter) {
-  marshall<CastCntType>(buf, num_elems);
+template <typename CastCntType, typename CastValType, supports_endian_expandable_buffer Buf,
+          typename Iter>
+constexpr Buf& marshall_seq(Buf& buf, std::size_t num_elems, Iter iter) {
+  detail::serialize_val<CastCntType>(buf, num_elems);
   for (std::size_t i = 0u; i < num_elems; ++i) {
-    if constexpr (detail::is_arithmetic_or_byte<T>()) {
-      marshall<CastValType>(buf, *iter);
-    }
-    else {
-      marshall(buf, *iter);
-    }
+    detail::marshall_fmt<CastValType>(buf, *iter);
     ++iter;
   }
   return buf;
 }
 
 // efficiently append a buffer of bytes to the end of the existing buffer
-template <typename Buf = chops::mutable_shared_buffer>
-Buf& marshall_buf(Buf& buf, std::size_t num_bytes, const std::byte* append_buf) {
+template <supports_expandable_buffer Buf>
+constexpr Buf& marshall_buf(Buf& buf, std::size_t num_bytes, const std::byte* append_buf) {
   auto old_sz = buf.size();
   buf.resize(old_sz + num_bytes);
-  std::memcpy (buf.data()+old_sz, append_buf, num_bytes);
+  if (std::is_constant_evaluated()) {
+    std::copy_n(append_buf, num_bytes, buf.data()+old_sz);
+  }
+  else if (num_bytes != 0u) {
+    std::memcpy (buf.data()+old_sz, append_buf, num_bytes);
+  }
   return buf;
 }
 
-template <typename CastCntType, typename Buf = chops::mutable_shared_buffer>
-Buf& marshall(Buf& buf, std::string_view str) {
-  marshall<CastCntType>(buf, str.size());
-  return marshall_buf(buf, str.size(), cast_ptr_to<std::byte>(str.data()));
+template <std::unsigned_integral CastCntType, supports_endian_expandable_buffer Buf>
+constexpr Buf& marshall(Buf& buf, std::string_view str) {
+  return marshall<seq_fmt<CastCntType, char>>(buf, str);
 }
 
-template <typename CastCntType, typename Buf = chops::mutable_shared_buffer>
-Buf& marshall(Buf& buf, const std::string& str) {
+template <std::unsigned_integral CastCntType, supports_endian_expandable_buffer Buf>
+constexpr Buf& marshall(Buf& buf, const std::string& str) {
   return marshall<CastCntType>(buf, std::string_view(str));
 }
 
-template <typename CastCntType, typename Buf = chops::mutable_shared_buffer>
-Buf& marshall(Buf& buf, const char* str) {
+template <std::unsigned_integral CastCntType, supports_endian_expandable_buffer Buf>
+constexpr Buf& marshall(Buf& buf, const char* str) {
   return marshall<CastCntType>(buf, std::string_view(str));
 }
 
+template <std::unsigned_integral CastCntType, supports_endian_extract_buffer Src>
+constexpr Src& unmarshall(Src& src, std::string& str) {
+  return unmarshall<seq_fmt<CastCntType, char>>(src, str);
+}
+
 } // end namespace
 
 #endif
-
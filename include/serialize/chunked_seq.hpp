@@ -0,0 +1,271 @@
+/** @file
+ *
+ * @brief A sequence format serialized in chunks, so a lazily produced sequence of
+ * unknown length (e.g. a database cursor, a sensor stream, a coroutine generator) can
+ * be serialized in bounded memory.
+ *
+ * Each chunk is an element count followed by the elements, and a zero count ends the
+ * sequence. @c marshall_chunked serializes any input range, including single pass
+ * ranges such as @c std::generator, passing each chunk to a sink once it reaches a
+ * size, so only one chunk is in memory.
+ *
+ * Counts are never back-patched, so the format can be marshalled through buffers that
+ * process bytes as they are appended (e.g. @c crc32c_buffer or @c compressing_buffer).
+ * The chunk counts of a forward range are counted before each chunk is marshalled, and
+ * the elements of a single pass range are staged in a scratch buffer until the count of
+ * their chunk is known, then copied to the output buffer. @c marshall_chunked empties
+ * its buffer after each chunk, so it does not accept such buffers, the sink processes
+ * the bytes of each chunk instead (e.g. with @c crc32c).
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef CHUNKED_SEQ_HPP_INCLUDED
+#define CHUNKED_SEQ_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uintmax_t
+#include <limits>
+#include <ranges>
+#include <vector>
+#include <span>
+#include <concepts>
+#include <utility> // std::move
+#include <algorithm> // std::min, std::max
+
+namespace chops {
+
+/**
+ * @brief Format directive for a sequence serialized as chunks, each an element count
+ * followed by the elements, ending with a zero count.
+ *
+ * Marshalling a range through this format (rather than @c marshall_chunked) creates
+ * chunks of @c ChunkCnt elements. Any chunk sizes are accepted when unmarshalling.
+ *
+ * @tparam CastCnt Unsigned integer type of the count of each chunk.
+ *
+ * @tparam ElemFmt Format of each element.
+ *
+ * @tparam ChunkCnt Number of elements per chunk when marshalling.
+ *
+ * @tparam MaxCnt Maximum total number of elements, checked when unmarshalling, since
+ * the length of the sequence is not otherwise limited.
+ *
+ */
+template <std::unsigned_integral CastCnt, typename ElemFmt,
+          std::size_t ChunkCnt = std::numeric_limits<CastCnt>::max(),
+          std::size_t MaxCnt = std::numeric_limits<std::size_t>::max()>
+  requires (ChunkCnt > 0u) && (std::in_range<CastCnt>(ChunkCnt))
+struct chunked_seq_fmt { };
+
+namespace detail {
+
+template <std::endian Endian>
+using chunk_scratch = expandable_buffer<std::vector<std::byte>, Endian>;
+
+// append the count and the staged elements of a chunk, emptying the scratch buffer
+template <std::unsigned_integral CastCnt, supports_endian_expandable_buffer Buf, typename Scratch>
+constexpr void append_chunk(Buf& buf, std::size_t cnt, Scratch& scratch) {
+  serialize_val<CastCnt>(buf, cnt);
+  marshall_buf(buf, static_cast<std::size_t>(scratch.size()), scratch.data());
+  scratch.resize(0u);
+}
+
+} // end detail namespace
+
+template <std::unsigned_integral CastCnt, typename ElemFmt, std::size_t ChunkCnt, std::size_t MaxCnt>
+struct format_traits<chunked_seq_fmt<CastCnt, ElemFmt, ChunkCnt, MaxCnt>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size = unbounded_size;
+
+  template <std::ranges::input_range Rng>
+    requires std::ranges::input_range<const Rng>
+  static constexpr std::size_t encoded_size(const Rng& rng) {
+    std::size_t sz {0u};
+    std::size_t cnt {0u};
+    for (const auto& elem : rng) {
+      sz += detail::encoded_size_fmt<ElemFmt>(elem);
+      ++cnt;
+    }
+    return sz + ((cnt + ChunkCnt - 1u) / ChunkCnt + 1u) * sizeof(CastCnt);
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::input_range Rng>
+    requires std::ranges::input_range<const Rng>
+  static constexpr Buf& marshall(Buf& buf, const Rng& rng) {
+    if constexpr (std::ranges::forward_range<const Rng>) {
+      using diff_t = std::ranges::range_difference_t<const Rng>;
+      constexpr auto chunk_diff = static_cast<diff_t>(
+          std::min<std::uintmax_t>(ChunkCnt, static_cast<std::uintmax_t>(std::numeric_limits<diff_t>::max())));
+      auto it = std::ranges::begin(rng);
+      auto end = std::ranges::end(rng);
+      while (it != end) {
+        auto chunk_end = std::ranges::next(it, chunk_diff, end);
+        detail::serialize_val<CastCnt>(buf, static_cast<std::size_t>(std::ranges::distance(it, chunk_end)));
+        for (; it != chunk_end; ++it) {
+          detail::marshall_fmt<ElemFmt>(buf, *it);
+        }
+      }
+    }
+    else {
+      detail::chunk_scratch<Buf::endian_type::value> scratch;
+      std::size_t cnt {0u};
+      for (const auto& elem : rng) {
+        detail::marshall_fmt<ElemFmt>(scratch, elem);
+        if (++cnt == ChunkCnt) {
+          detail::append_chunk<CastCnt>(buf, cnt, scratch);
+          cnt = 0u;
+        }
+      }
+      if (cnt != 0u) {
+        detail::append_chunk<CastCnt>(buf, cnt, scratch);
+      }
+    }
+    detail::serialize_val<CastCnt>(buf, 0u);
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr) { typename Ctr::value_type; ctr.clear(); ctr.end(); }
+  // as with seq_fmt, the existing elements of a resizable container are decoded into
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    std::size_t num_old {0u};
+    if constexpr (detail::resizable_sequence<Ctr>) {
+      num_old = std::ranges::size(ctr);
+    }
+    else {
+      ctr.clear();
+    }
+    auto old_iter = ctr.begin();
+    std::size_t total {0u};
+    std::size_t reserved {0u};
+    for (;;) {
+      auto cnt = static_cast<std::size_t>(detail::unserialize_val<CastCnt>(src));
+      if (cnt == 0u || !detail::decode_ok(src)) {
+        break;
+      }
+      if (cnt > MaxCnt - total) {
+        detail::fail_decode(src, decode_error::count_too_large);
+        break;
+      }
+      if constexpr (requires { ctr.reserve(std::size_t{}); }) {
+        // no iterators to existing elements are in use, and capacity grows geometrically,
+        // since reserving exactly for each chunk would reallocate for every chunk
+        auto wanted = total + detail::reserve_count(src, cnt);
+        if (total >= num_old && wanted > reserved) {
+          reserved = std::max(wanted, 2u * reserved);
+          ctr.reserve(reserved);
+        }
+      }
+      for (std::size_t i {0u}; i < cnt && detail::decode_ok(src); ++i, ++total) {
+        if (total < num_old) {
+          detail::unmarshall_fmt<ElemFmt>(src, *old_iter);
+          ++old_iter;
+        }
+        else {
+          auto elem = detail::make_elem<typename Ctr::value_type>(src, ctr);
+          detail::unmarshall_fmt<ElemFmt>(src, elem);
+          ctr.insert(ctr.end(), std::move(elem));
+        }
+      }
+    }
+    if constexpr (detail::resizable_sequence<Ctr>) {
+      if (total < num_old) {
+        ctr.resize(total);
+      }
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    std::size_t total {0u};
+    for (;;) {
+      auto cnt = static_cast<std::size_t>(detail::unserialize_val<CastCnt>(src));
+      if (cnt == 0u || !src.ok()) {
+        return;
+      }
+      if (cnt > MaxCnt - total) {
+        detail::fail_decode(src, decode_error::count_too_large);
+        return;
+      }
+      total += cnt;
+      for (std::size_t i {0u}; i < cnt && src.ok(); ++i) {
+        detail::validate_fmt<ElemFmt>(src);
+      }
+    }
+  }
+};
+
+/**
+ * @brief Marshall a range of any length, including a single pass range such as a
+ * generator, in chunks that are each passed to a sink, in the format of a
+ * @c chunked_seq_fmt<CastCnt, ElemFmt>.
+ *
+ * Example usage:
+ * @code
+ *   chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+ *   chops::marshall_chunked<std::uint16_t, row_fmt>(buf, db_rows(query),
+ *       [&out] (std::span<const std::byte> bytes) { out.write(bytes); }, 65536u);
+ * @endcode
+ *
+ * The elements of each chunk are staged in a scratch buffer, then appended to @c buf
+ * after the chunk count, so memory is bounded by about twice the chunk size.
+ *
+ * @param buf Buffer for one chunk, emptied after each chunk is passed to the sink. Any
+ * existing contents (e.g. a message header) are passed to the sink with the first chunk.
+ * Since the buffer is emptied, it can not be an append only buffer (see @c is_append_only),
+ * a checksum or hash of the bytes is computed in the sink.
+ *
+ * @param rng Range of elements, iterated once.
+ *
+ * @param sink Callable with the bytes of each chunk, which are only valid during the call.
+ *
+ * @param chunk_bytes Size at which a chunk is passed to the sink (a chunk also ends when
+ * its count reaches the maximum of @c CastCnt).
+ *
+ * @return The number of elements.
+ *
+ */
+template <std::unsigned_integral CastCnt, typename ElemFmt, supports_endian_expandable_buffer Buf,
+          std::ranges::input_range Rng, typename Sink>
+  requires std::invocable<Sink&, std::span<const std::byte>> && (!is_append_only<Buf>)
+std::size_t marshall_chunked(Buf& buf, Rng&& rng, Sink&& sink, std::size_t chunk_bytes) {
+  constexpr std::size_t max_chunk = std::numeric_limits<CastCnt>::max();
+  auto flush = [&buf, &sink] {
+    sink(std::span<const std::byte>(buf.data(), static_cast<std::size_t>(buf.size())));
+    buf.resize(0u);
+  };
+  detail::chunk_scratch<Buf::endian_type::value> scratch;
+  scratch.get_buf().reserve(chunk_bytes);
+  std::size_t cnt {0u};
+  std::size_t total {0u};
+  for (auto&& elem : rng) {
+    detail::marshall_fmt<ElemFmt>(scratch, elem);
+    ++total;
+    if (++cnt == max_chunk || static_cast<std::size_t>(scratch.size()) >= chunk_bytes) {
+      detail::append_chunk<CastCnt>(buf, cnt, scratch);
+      flush();
+      cnt = 0u;
+    }
+  }
+  if (cnt != 0u) {
+    detail::append_chunk<CastCnt>(buf, cnt, scratch);
+  }
+  detail::serialize_val<CastCnt>(buf, 0u);
+  flush();
+  return total;
+}
+
+} // end namespace
+
+#endif
+
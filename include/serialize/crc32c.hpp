@@ -0,0 +1,305 @@
+/** @file
+ *
+ * @brief CRC32C (Castagnoli) checksums, computed while marshalling through a
+ * @c crc32c_buffer and verified while unmarshalling through a @c crc32c_cursor.
+ *
+ * The checksum uses the SSE 4.2 (x86) or ARMv8 CRC32 instructions when the compiler
+ * targets them (e.g. @c -msse4.2 or @c -march=native), otherwise a portable slicing-by-8
+ * table implementation. Both produce the same values.
+ *
+ * A checksummed frame is the serialized bytes followed by the 32 bit checksum of those
+ * bytes, in the buffer endianness. The checksum is accumulated as the bytes are written
+ * (or read), a block at a time while the bytes are still in cache, rather than in a
+ * second pass over the completed frame.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef CRC32C_HPP_INCLUDED
+#define CRC32C_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+#include "serialize/extract_append.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <cstring> // std::memcpy
+#include <array>
+#include <span>
+#include <utility> // std::move
+#include <bit> // std::endian
+#include <cassert>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace chops {
+
+namespace detail {
+
+inline constexpr std::uint32_t crc32c_poly = 0x82F63B78u; // reflected
+
+constexpr std::array<std::array<std::uint32_t, 256>, 8> make_crc32c_tables() noexcept {
+  std::array<std::array<std::uint32_t, 256>, 8> tbls { };
+  for (std::uint32_t i {0u}; i < 256u; ++i) {
+    std::uint32_t crc = i;
+    for (int b {0}; b < 8; ++b) {
+      crc = (crc >> 1) ^ ((crc & 1u) ? crc32c_poly : 0u);
+    }
+    tbls[0][i] = crc;
+  }
+  for (std::size_t k {1u}; k < 8u; ++k) {
+    for (std::size_t i {0u}; i < 256u; ++i) {
+      tbls[k][i] = (tbls[k-1u][i] >> 8) ^ tbls[0][tbls[k-1u][i] & 0xFFu];
+    }
+  }
+  return tbls;
+}
+
+inline constexpr auto crc32c_tables = make_crc32c_tables();
+
+// crc is the internal (inverted) state
+constexpr std::uint32_t crc32c_sw(std::uint32_t crc, const std::byte* buf, std::size_t sz) noexcept {
+  const auto& t = crc32c_tables;
+  for (; sz >= 8u; sz -= 8u, buf += 8u) {
+    std::uint32_t lo = crc ^ extract_val<std::endian::little, std::uint32_t>(buf);
+    std::uint32_t hi = extract_val<std::endian::little, std::uint32_t>(buf + 4u);
+    crc = t[7][lo & 0xFFu] ^ t[6][(lo >> 8) & 0xFFu] ^ t[5][(lo >> 16) & 0xFFu] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFFu] ^ t[2][(hi >> 8) & 0xFFu] ^ t[1][(hi >> 16) & 0xFFu] ^ t[0][hi >> 24];
+  }
+  for (; sz > 0u; --sz, ++buf) {
+    crc = (crc >> 8) ^ t[0][(crc ^ std::to_integer<std::uint32_t>(*buf)) & 0xFFu];
+  }
+  return crc;
+}
+
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+inline std::uint32_t crc32c_hw(std::uint32_t crc, const std::byte* buf, std::size_t sz) noexcept {
+  for (; sz >= 8u; sz -= 8u, buf += 8u) {
+    std::uint64_t val;
+    std::memcpy(&val, buf, sizeof(val));
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    crc = static_cast<std::uint32_t>(_mm_crc32_u64(crc, val));
+#elif defined(__SSE4_2__)
+    crc = _mm_crc32_u32(_mm_crc32_u32(crc, static_cast<std::uint32_t>(val)), static_cast<std::uint32_t>(val >> 32));
+#else
+    crc = __crc32cd(crc, val);
+#endif
+  }
+  for (; sz > 0u; --sz, ++buf) {
+#if defined(__SSE4_2__)
+    crc = _mm_crc32_u8(crc, std::to_integer<unsigned char>(*buf));
+#else
+    crc = __crc32cb(crc, std::to_integer<std::uint8_t>(*buf));
+#endif
+  }
+  return crc;
+}
+#endif
+
+} // end detail namespace
+
+/**
+ * @brief Compute or continue a CRC32C checksum.
+ *
+ * @param buf Bytes to checksum.
+ *
+ * @param crc Checksum of the preceding bytes, zero to start a new checksum.
+ *
+ * @return Checksum of the preceding bytes followed by @c buf, e.g.
+ * @c crc32c(b, crc32c(a)) equals the checksum of @c a followed by @c b.
+ *
+ */
+inline std::uint32_t crc32c(std::span<const std::byte> buf, std::uint32_t crc = 0u) noexcept {
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+  return ~detail::crc32c_hw(~crc, buf.data(), buf.size());
+#else
+  return ~detail::crc32c_sw(~crc, buf.data(), buf.size());
+#endif
+}
+
+/**
+ * @brief Number of pending bytes after which a @c crc32c_buffer or @c crc32c_cursor
+ * updates its checksum, small enough that the bytes are still in cache.
+ */
+inline constexpr std::size_t crc32c_block_size = 2048u;
+
+/**
+ * @brief Wrap a buffer for @c chops::marshall, computing a CRC32C checksum of the bytes
+ * as they are appended.
+ *
+ * The checksum is updated when the buffer size is read, at the start of each @c marshall
+ * step, once a block of bytes is pending. Call @c append_checksum after the last
+ * @c marshall of a frame to complete the frame.
+ *
+ * @note All bytes in a resized area must be written before @c size is called again,
+ * which is always the case within @c marshall.
+ *
+ * @tparam Buf Wrapped buffer type, e.g. @c chops::expandable_buffer.
+ *
+ */
+template <supports_endian_expandable_buffer Buf>
+class crc32c_buffer {
+private:
+  Buf           m_buf;
+  std::size_t   m_summed;
+  std::uint32_t m_crc;
+
+  void update() {
+    auto sz = static_cast<std::size_t>(m_buf.size());
+    assert(sz >= m_summed);
+    m_crc = crc32c(std::span<const std::byte>(m_buf.data() + m_summed, sz - m_summed), m_crc);
+    m_summed = sz;
+  }
+
+public:
+  using endian_type = typename Buf::endian_type;
+  using value_type = std::byte;
+  static constexpr bool append_only = true;
+
+  crc32c_buffer() : m_buf(), m_summed(0u), m_crc(0u) { }
+/**
+ * @brief Construct from a buffer, checksumming bytes appended after its current contents.
+ */
+  explicit crc32c_buffer(Buf buf) :
+    m_buf(std::move(buf)), m_summed(static_cast<std::size_t>(m_buf.size())), m_crc(0u) { }
+
+  std::size_t size() {
+    auto sz = static_cast<std::size_t>(m_buf.size());
+    if (sz - m_summed >= crc32c_block_size) {
+      update();
+    }
+    return sz;
+  }
+  void resize(std::size_t sz) {
+    assert(sz >= m_summed);
+    m_buf.resize(sz);
+  }
+  std::byte* data() noexcept { return m_buf.data(); }
+
+/**
+ * @brief Return the checksum of all bytes appended since construction or the last
+ * @c append_checksum.
+ */
+  std::uint32_t checksum() {
+    update();
+    return m_crc;
+  }
+/**
+ * @brief Append the checksum to the buffer, completing a frame, and start the checksum
+ * of the next frame.
+ *
+ * @return The appended checksum.
+ */
+  std::uint32_t append_checksum() {
+    std::uint32_t crc = checksum();
+    auto old_sz = static_cast<std::size_t>(m_buf.size());
+    m_buf.resize(old_sz + sizeof(crc));
+    append_val<endian_type::value>(m_buf.data() + old_sz, crc);
+    m_summed = old_sz + sizeof(crc);
+    m_crc = 0u;
+    return crc;
+  }
+/**
+ * @brief Return the wrapped buffer.
+ */
+  Buf& get_buf() noexcept { return m_buf; }
+};
+
+/**
+ * @brief A bounds-checked read cursor computing a CRC32C checksum of the bytes read, to
+ * verify checksummed frames created with a @c crc32c_buffer.
+ *
+ * The cursor is used as a @c read_cursor, then @c verify reads the trailing checksum of
+ * the frame, recording @c decode_error::checksum_mismatch if it does not match.
+ *
+ * Example usage:
+ * @code
+ *   chops::crc32c_cursor<std::endian::big> cur(frame);
+ *   msg m;
+ *   chops::unmarshall<msg_fmt>(cur, m);
+ *   if (cur.verify() != chops::decode_error::none) {
+ *     // reject the frame
+ *   }
+ * @endcode
+ *
+ */
+template <std::endian Endian = std::endian::little>
+class crc32c_cursor {
+private:
+  read_cursor<Endian> m_cur;
+  const std::byte*    m_summed;
+  std::uint32_t       m_crc;
+
+  void update() noexcept {
+    m_crc = crc32c(std::span<const std::byte>(m_summed, m_cur.data()), m_crc);
+    m_summed = m_cur.data();
+  }
+
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+
+  crc32c_cursor(const std::byte* buf, std::size_t sz) noexcept :
+    m_cur(buf, sz), m_summed(buf), m_crc(0u) { }
+  explicit crc32c_cursor(std::span<const std::byte> buf) noexcept :
+    crc32c_cursor(buf.data(), buf.size()) { }
+
+  const std::byte* data() const noexcept { return m_cur.data(); }
+  std::size_t remaining() const noexcept { return m_cur.remaining(); }
+  void advance(std::size_t sz) noexcept {
+    m_cur.advance(sz);
+    if (static_cast<std::size_t>(m_cur.data() - m_summed) >= crc32c_block_size) {
+      update();
+    }
+  }
+  bool ensure(std::size_t sz) noexcept { return m_cur.ensure(sz); }
+  void fail(decode_error err) noexcept {
+    m_cur.fail(err);
+    m_summed = m_cur.data();
+  }
+  bool ok() const noexcept { return m_cur.ok(); }
+  decode_error error() const noexcept { return m_cur.error(); }
+
+/**
+ * @brief Return the checksum of the bytes read since construction or the last @c verify.
+ */
+  std::uint32_t checksum() noexcept {
+    update();
+    return m_crc;
+  }
+/**
+ * @brief Read the checksum at the end of a frame and compare it to the checksum of the
+ * bytes read, then start the checksum of the next frame.
+ *
+ * @return The first error that occurred, @c decode_error::checksum_mismatch if the
+ * checksums differ.
+ */
+  decode_error verify() noexcept {
+    std::uint32_t crc = checksum();
+    if (!m_cur.ensure(sizeof(crc))) {
+      return error();
+    }
+    if (extract_val<Endian, std::uint32_t>(m_cur.data()) != crc) {
+      fail(decode_error::checksum_mismatch);
+      return error();
+    }
+    m_cur.advance(sizeof(crc));
+    m_summed = m_cur.data();
+    m_crc = 0u;
+    return error();
+  }
+};
+
+} // end namespace
+
+#endif
+
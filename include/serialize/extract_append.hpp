@@ -37,7 +37,8 @@
 #include <array>
 #include <cstddef> // std::byte, std::size_t
 #include <cstdint> // std::uint32_t, etc
-#include <type_traits> // std::is_same
+#include <cstring> // std::memcpy
+#include <type_traits> // std::is_same, std::is_constant_evaluated
 
 
 namespace chops {
@@ -147,6 +148,82 @@ constexpr std::size_t append_val(std::byte* buf, const T& val) noexcept {
   return sizeof(T);
 }
 
+/**
+ * @brief Append an array of integral or @c std::byte values to a @c std::byte buffer,
+ * swapping into the specified endian order as needed.
+ *
+ * This is the bulk form of @c append_val. If no swapping is needed the values are copied
+ * with a single @c std::memcpy, otherwise a tight swap loop is used which compilers
+ * translate into byte swap (or vector shuffle) instructions.
+ *
+ * @tparam BufEndian The endianness of the buffer.
+ *
+ * @tparam T Type of the values to append to the buffer.
+ *
+ * @param buf Pointer to array of @c std::bytes big enough to hold the bytes of all values.
+ *
+ * @param vals Pointer to the values in native endian order.
+ *
+ * @param num Number of values.
+ *
+ * @return Number of bytes copied into the @c std::byte buffer.
+ *
+ * @pre The buffer must already be allocated to hold at least @c num @c * @c sizeof(T) bytes.
+ *
+ */
+template <std::endian BufEndian, integral_or_byte T>
+constexpr std::size_t append_vals(std::byte* buf, const T* vals, std::size_t num) noexcept {
+  if constexpr (BufEndian == std::endian::native || sizeof(T) == 1u) {
+    if (!std::is_constant_evaluated()) {
+      if (num != 0u) {
+        std::memcpy(buf, vals, num * sizeof(T));
+      }
+      return num * sizeof(T);
+    }
+  }
+  for (std::size_t i = 0u; i < num; ++i) {
+    append_val<BufEndian>(buf + i * sizeof(T), vals[i]);
+  }
+  return num * sizeof(T);
+}
+
+/**
+ * @brief Extract an array of values from a @c std::byte buffer into native endianness,
+ * swapping bytes as needed.
+ *
+ * This is the bulk form of @c extract_val, see @c append_vals.
+ *
+ * @tparam BufEndian The endianness of the @c std::byte buffer.
+ *
+ * @tparam T Type of the extracted values.
+ *
+ * @param buf Pointer to an array of @c std::bytes containing the values.
+ *
+ * @param vals Pointer to the output values.
+ *
+ * @param num Number of values.
+ *
+ * @return Number of bytes extracted from the @c std::byte buffer.
+ *
+ * @pre The buffer must contain at least @c num @c * @c sizeof(T) bytes.
+ *
+ */
+template <std::endian BufEndian, integral_or_byte T>
+constexpr std::size_t extract_vals(const std::byte* buf, T* vals, std::size_t num) noexcept {
+  if constexpr (BufEndian == std::endian::native || sizeof(T) == 1u) {
+    if (!std::is_constant_evaluated()) {
+      if (num != 0u) {
+        std::memcpy(vals, buf, num * sizeof(T));
+      }
+      return num * sizeof(T);
+    }
+  }
+  for (std::size_t i = 0u; i < num; ++i) {
+    vals[i] = extract_val<BufEndian, T>(buf + i * sizeof(T));
+  }
+  return num * sizeof(T);
+}
+
 /**
  * @brief Encode an unsigned integer into a variable length buffer of bytes using the MSB (most
  * significant bit) algorithm.
@@ -0,0 +1,296 @@
+/** @file
+ *
+ * @brief A lock-free ring of serialized frames, where producers serialize directly into
+ * the ring and a consumer reads contiguous runs of frames, e.g. for a single @c write.
+ *
+ * A producer reserves space for a frame, marshalls into the reserved bytes through a
+ * @c write_cursor, and commits. The consumer gets a contiguous span of committed frames,
+ * writes it, and releases it. There is no allocation or copying between the producer and
+ * the consumer.
+ *
+ * Frames have the same layout as @c marshall_framed, i.e. a length followed by the
+ * serialized bytes, so a span from the consumer can be written as is, or split with
+ * @c index_frames.
+ *
+ * With a single producer no read-modify-write atomics are used. With multiple producers
+ * space is reserved with a compare and swap, and commits are published in reservation
+ * order: a producer that commits while an earlier reservation is still being written
+ * waits for it, so frames should be serialized promptly after they are reserved.
+ *
+ * When a frame does not fit before the end of the ring it is placed at the start, and
+ * the skipped bytes are never returned to the consumer. The same is done for a reserved
+ * frame that is cancelled, e.g. because marshalling threw, when it can not simply be
+ * returned to the producers.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef FRAME_RING_HPP_INCLUDED
+#define FRAME_RING_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint64_t, std::uint32_t
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <optional>
+#include <span>
+#include <limits>
+#include <stdexcept> // std::length_error
+#include <thread> // std::this_thread::yield
+#include <type_traits> // std::conditional_t
+#include <algorithm> // std::min
+#include <bit> // std::endian, std::bit_ceil
+#include <cassert>
+
+namespace chops {
+
+/**
+ * @brief A bounded ring of serialized frames for one consumer and one or more producers.
+ *
+ * Example usage:
+ * @code
+ *   chops::frame_ring<std::endian::big, std::uint32_t, true> ring(1u << 20);
+ *   // any producer thread
+ *   if (!ring.try_push<msg_fmt>(m)) {
+ *     // ring is full
+ *   }
+ *   // consumer thread
+ *   auto frames = ring.read();
+ *   if (!frames.empty()) {
+ *     ::write(fd, frames.data(), frames.size());
+ *     ring.release(frames.size());
+ *   }
+ * @endcode
+ *
+ * @tparam Endian Endianness of the serialized frames.
+ *
+ * @tparam CastLen Type of the frame length.
+ *
+ * @tparam MultiProducer @c true if more than one thread produces frames.
+ *
+ */
+template <std::endian Endian = std::endian::little, std::unsigned_integral CastLen = std::uint32_t,
+          bool MultiProducer = false>
+class frame_ring {
+private:
+  static constexpr std::size_t cache_line = 64u;
+  static constexpr std::uint64_t no_pad = std::numeric_limits<std::uint64_t>::max();
+
+  using reserve_pos = std::conditional_t<MultiProducer, std::atomic<std::uint64_t>, std::uint64_t>;
+
+  std::unique_ptr<std::byte[]> m_buf;
+  std::size_t                  m_cap;
+  // positions increase without wrapping, the ring index is the position modulo the capacity
+  alignas(cache_line) reserve_pos                m_reserved;   // producers
+  alignas(cache_line) std::atomic<std::uint64_t> m_committed;  // producers, read by the consumer
+  std::atomic<std::uint64_t>                     m_pad_begin;  // start of skipped bytes, no_pad if none
+  std::atomic<std::uint64_t>                     m_pad_end;
+  alignas(cache_line) std::atomic<std::uint64_t> m_head;       // consumer, read by producers
+
+  std::uint64_t lap_end(std::uint64_t pos) const noexcept { return (pos | (m_cap - 1u)) + 1u; }
+
+  // the frame start and the end of the reservation, given the first free position
+  bool place(std::uint64_t pos, std::size_t frame_sz, std::uint64_t& frame_pos, std::uint64_t& end) const noexcept {
+    frame_pos = (lap_end(pos) - pos < frame_sz) ? lap_end(pos) : pos;
+    end = frame_pos + frame_sz;
+    return end - m_head.load(std::memory_order_acquire) <= m_cap;
+  }
+
+  // wait for earlier reservations, record bytes skipped from the start of the reservation
+  // (if any), and publish up to end
+  void publish(std::uint64_t start, std::uint64_t skip_end, std::uint64_t end) noexcept {
+    if constexpr (MultiProducer) {
+      while (m_committed.load(std::memory_order_acquire) != start) {
+        std::this_thread::yield();
+      }
+    }
+    if (skip_end != start) {
+      // one skipped region is tracked, the consumer must first pass the previous one
+      while (m_pad_begin.load(std::memory_order_acquire) != no_pad) {
+        std::this_thread::yield();
+      }
+      m_pad_end.store(skip_end, std::memory_order_relaxed);
+      m_pad_begin.store(start, std::memory_order_relaxed);
+    }
+    m_committed.store(end, std::memory_order_release);
+  }
+
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+
+/**
+ * @brief Space reserved for a frame, filled in through @c cursor, then passed to @c commit.
+ */
+  class slot {
+  public:
+    write_cursor<Endian>& cursor() noexcept { return m_cursor; }
+  private:
+    friend class frame_ring;
+    slot(std::byte* payload, std::size_t sz, std::uint64_t start, std::uint64_t frame_pos) noexcept :
+      m_cursor(payload, sz), m_start(start), m_frame_pos(frame_pos) { }
+    write_cursor<Endian> m_cursor;
+    std::uint64_t        m_start;
+    std::uint64_t        m_frame_pos;
+  };
+
+/**
+ * @brief Construct with a capacity in bytes, rounded up to a power of two.
+ */
+  explicit frame_ring(std::size_t capacity) :
+    m_buf(std::make_unique<std::byte[]>(std::bit_ceil(capacity))), m_cap(std::bit_ceil(capacity)),
+    m_reserved(0u), m_committed(0u), m_pad_begin(no_pad), m_pad_end(0u), m_head(0u) { }
+
+  frame_ring(const frame_ring&) = delete;
+  frame_ring& operator=(const frame_ring&) = delete;
+
+/**
+ * @brief Return the capacity in bytes.
+ */
+  std::size_t capacity() const noexcept { return m_cap; }
+
+/**
+ * @brief Reserve space for a frame, without blocking.
+ *
+ * @param num_bytes Exact number of bytes that will be serialized into the frame, e.g. from
+ * @c encoded_size.
+ *
+ * @return The reserved slot, or an empty @c std::optional if the ring does not currently
+ * have space.
+ *
+ * @throw std::length_error If @c num_bytes does not fit in a @c CastLen, or the frame,
+ * including the length, does not fit in the ring.
+ */
+  std::optional<slot> try_reserve(std::size_t num_bytes) {
+    if (num_bytes > std::numeric_limits<CastLen>::max()) {
+      throw std::length_error("frame size does not fit in the frame length type");
+    }
+    std::size_t frame_sz = sizeof(CastLen) + num_bytes;
+    if (frame_sz > m_cap) {
+      throw std::length_error("frame size exceeds the ring capacity");
+    }
+    std::uint64_t pos;
+    std::uint64_t frame_pos;
+    std::uint64_t end;
+    if constexpr (MultiProducer) {
+      pos = m_reserved.load(std::memory_order_relaxed);
+      do {
+        if (!place(pos, frame_sz, frame_pos, end)) {
+          return { };
+        }
+      } while (!m_reserved.compare_exchange_weak(pos, end, std::memory_order_relaxed));
+    }
+    else {
+      pos = m_reserved;
+      if (!place(pos, frame_sz, frame_pos, end)) {
+        return { };
+      }
+      m_reserved = end;
+    }
+    std::byte* frame = m_buf.get() + (frame_pos & (m_cap - 1u));
+    return { slot(frame + sizeof(CastLen), num_bytes, pos, frame_pos) };
+  }
+
+/**
+ * @brief Publish a filled in frame to the consumer.
+ *
+ * @pre All of the reserved bytes have been written through the slot cursor.
+ */
+  void commit(slot& s) noexcept {
+    assert(s.m_cursor.size() == s.m_cursor.capacity());
+    append_val<Endian>(s.m_cursor.data() - sizeof(CastLen), static_cast<CastLen>(s.m_cursor.size()));
+    publish(s.m_start, s.m_frame_pos, s.m_frame_pos + sizeof(CastLen) + s.m_cursor.size());
+  }
+
+/**
+ * @brief Give up a reserved frame instead of committing it, e.g. when marshalling into it
+ * threw. The frame is never returned to the consumer.
+ *
+ * With a single producer, or when no later frame has been reserved, the space is returned
+ * to the producers. Otherwise the bytes are published as skipped bytes, so later frames
+ * are not blocked. Only one region of skipped bytes is tracked at a time, so this (and a
+ * commit that wraps to the start) may wait for the consumer to pass an earlier region.
+ */
+  void cancel(slot& s) noexcept {
+    auto end = s.m_frame_pos + sizeof(CastLen) + s.m_cursor.capacity();
+    if constexpr (MultiProducer) {
+      auto pos = end;
+      if (!m_reserved.compare_exchange_strong(pos, s.m_start, std::memory_order_relaxed)) {
+        publish(s.m_start, end, end);
+      }
+    }
+    else {
+      m_reserved = s.m_start;
+    }
+  }
+
+/**
+ * @brief Serialize a value into a frame, without blocking.
+ *
+ * If marshalling throws, the reserved frame is cancelled (see @c cancel) and the
+ * exception is rethrown.
+ *
+ * @return @c false if the ring does not currently have space.
+ *
+ * @throw std::length_error As for @c try_reserve.
+ */
+  template <typename Fmt, typename T>
+    requires marshallable_with<Fmt, write_cursor<Endian>, T>
+  bool try_push(const T& val) {
+    auto s = try_reserve(encoded_size<Fmt>(val));
+    if (!s) {
+      return false;
+    }
+    try {
+      marshall<Fmt>(s->cursor(), val);
+    }
+    catch (...) {
+      cancel(*s);
+      throw;
+    }
+    commit(*s);
+    return true;
+  }
+
+/**
+ * @brief Return the committed frames at the read position that are contiguous in memory,
+ * empty if there are none. Called only by the consumer.
+ */
+  std::span<const std::byte> read() noexcept {
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto committed = m_committed.load(std::memory_order_acquire);
+    auto pad = m_pad_begin.load(std::memory_order_relaxed);
+    if (head == pad && head != committed) {
+      head = m_pad_end.load(std::memory_order_relaxed);
+      m_head.store(head, std::memory_order_release);
+      m_pad_begin.store(no_pad, std::memory_order_release);
+      pad = no_pad;
+    }
+    auto end = std::min(committed, lap_end(head));
+    if (pad > head && pad < end) {
+      end = pad;
+    }
+    return { m_buf.get() + (head & (m_cap - 1u)), static_cast<std::size_t>(end - head) };
+  }
+
+/**
+ * @brief Release bytes returned by @c read, making the space available to producers.
+ *
+ * @param num_bytes Number of bytes, which must end on a frame boundary.
+ */
+  void release(std::size_t num_bytes) noexcept {
+    m_head.store(m_head.load(std::memory_order_relaxed) + num_bytes, std::memory_order_release);
+  }
+};
+
+} // end namespace
+
+#endif
+
@@ -0,0 +1,258 @@
+/** @file
+ *
+ * @brief A fast non-cryptographic 64 bit hash of serialized bytes, computed in one call
+ * over a span, incrementally with a @c hash64_state, or while marshalling through a
+ * @c hashing_buffer.
+ *
+ * The hash is XXH64 (from the xxHash family), and the values match the reference
+ * implementation. Four independent accumulators are updated per 32 byte stripe, so the
+ * hash runs at close to memory bandwidth. It is suitable for deduplication and hash
+ * tables, not for security.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef HASH64_HPP_INCLUDED
+#define HASH64_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+#include "serialize/extract_append.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint64_t, std::uint32_t
+#include <array>
+#include <span>
+#include <utility> // std::move
+#include <algorithm> // std::copy_n
+#include <bit> // std::endian, std::rotl
+#include <cassert>
+
+namespace chops {
+
+namespace detail {
+
+inline constexpr std::uint64_t hash_p1 = 11400714785074694791ull;
+inline constexpr std::uint64_t hash_p2 = 14029467366897019727ull;
+inline constexpr std::uint64_t hash_p3 = 1609587929392839161ull;
+inline constexpr std::uint64_t hash_p4 = 9650029242287828579ull;
+inline constexpr std::uint64_t hash_p5 = 2870177450012600261ull;
+inline constexpr std::size_t hash_stripe = 32u;
+
+constexpr std::uint64_t hash_round(std::uint64_t acc, std::uint64_t in) noexcept {
+  return std::rotl(acc + in * hash_p2, 31) * hash_p1;
+}
+
+constexpr std::uint64_t hash_merge(std::uint64_t acc, std::uint64_t val) noexcept {
+  return (acc ^ hash_round(0u, val)) * hash_p1 + hash_p4;
+}
+
+constexpr std::uint64_t load64(const std::byte* buf) noexcept {
+  return extract_val<std::endian::little, std::uint64_t>(buf);
+}
+
+// hash the final (less than a stripe) bytes
+constexpr std::uint64_t hash_finish(std::uint64_t h, const std::byte* buf, std::size_t sz) noexcept {
+  for (; sz >= 8u; sz -= 8u, buf += 8u) {
+    h = std::rotl(h ^ hash_round(0u, load64(buf)), 27) * hash_p1 + hash_p4;
+  }
+  if (sz >= 4u) {
+    h ^= std::uint64_t{extract_val<std::endian::little, std::uint32_t>(buf)} * hash_p1;
+    h = std::rotl(h, 23) * hash_p2 + hash_p3;
+    sz -= 4u;
+    buf += 4u;
+  }
+  for (; sz > 0u; --sz, ++buf) {
+    h ^= std::to_integer<std::uint64_t>(*buf) * hash_p5;
+    h = std::rotl(h, 11) * hash_p1;
+  }
+  h ^= h >> 33;
+  h *= hash_p2;
+  h ^= h >> 29;
+  h *= hash_p3;
+  h ^= h >> 32;
+  return h;
+}
+
+} // end detail namespace
+
+/**
+ * @brief Incremental 64 bit hash, the same value as @c hash64 over all of the bytes
+ * passed to @c update.
+ */
+class hash64_state {
+private:
+  std::array<std::uint64_t, 4>               m_acc;
+  std::array<std::byte, detail::hash_stripe> m_pending;
+  std::size_t                                m_num_pending;
+  std::uint64_t                              m_total;
+  std::uint64_t                              m_seed;
+
+  constexpr void stripe(const std::byte* buf) noexcept {
+    for (std::size_t i {0u}; i < 4u; ++i) {
+      m_acc[i] = detail::hash_round(m_acc[i], detail::load64(buf + i * 8u));
+    }
+  }
+
+public:
+  constexpr explicit hash64_state(std::uint64_t seed = 0u) noexcept :
+    m_acc(), m_pending(), m_num_pending(0u), m_total(0u), m_seed(seed) {
+    reset(seed);
+  }
+
+/**
+ * @brief Start a new hash.
+ */
+  constexpr void reset(std::uint64_t seed = 0u) noexcept {
+    m_acc = { seed + detail::hash_p1 + detail::hash_p2, seed + detail::hash_p2, seed, seed - detail::hash_p1 };
+    m_num_pending = 0u;
+    m_total = 0u;
+    m_seed = seed;
+  }
+/**
+ * @brief Add bytes to the hash.
+ */
+  constexpr void update(std::span<const std::byte> buf) noexcept {
+    const std::byte* ptr = buf.data();
+    std::size_t sz = buf.size();
+    m_total += sz;
+    if (m_num_pending > 0u) {
+      std::size_t n = std::min(sz, detail::hash_stripe - m_num_pending);
+      std::copy_n(ptr, n, m_pending.data() + m_num_pending);
+      m_num_pending += n;
+      ptr += n;
+      sz -= n;
+      if (m_num_pending < detail::hash_stripe) {
+        return;
+      }
+      stripe(m_pending.data());
+      m_num_pending = 0u;
+    }
+    for (; sz >= detail::hash_stripe; sz -= detail::hash_stripe, ptr += detail::hash_stripe) {
+      stripe(ptr);
+    }
+    std::copy_n(ptr, sz, m_pending.data());
+    m_num_pending = sz;
+  }
+/**
+ * @brief Return the hash of the bytes added since construction or the last @c reset,
+ * more bytes may then be added.
+ */
+  constexpr std::uint64_t digest() const noexcept {
+    std::uint64_t h = m_seed + detail::hash_p5;
+    if (m_total >= detail::hash_stripe) {
+      h = std::rotl(m_acc[0], 1) + std::rotl(m_acc[1], 7) + std::rotl(m_acc[2], 12) + std::rotl(m_acc[3], 18);
+      for (auto acc : m_acc) {
+        h = detail::hash_merge(h, acc);
+      }
+    }
+    return detail::hash_finish(h + m_total, m_pending.data(), m_num_pending);
+  }
+};
+
+/**
+ * @brief Compute the 64 bit hash of a span of bytes.
+ */
+constexpr std::uint64_t hash64(std::span<const std::byte> buf, std::uint64_t seed = 0u) noexcept {
+  hash64_state state(seed);
+  state.update(buf);
+  return state.digest();
+}
+
+/**
+ * @brief Number of pending bytes after which a @c hashing_buffer updates its hash.
+ */
+inline constexpr std::size_t hash64_block_size = 2048u;
+
+/**
+ * @brief Wrap a buffer for @c chops::marshall, computing a 64 bit hash of the bytes as
+ * they are appended, e.g. to deduplicate messages without a second pass over the bytes.
+ *
+ * The hash is updated when the buffer size is read, at the start of each @c marshall
+ * step, once a block of bytes is pending (the same as @c crc32c_buffer).
+ *
+ * Example usage:
+ * @code
+ *   chops::hashing_buffer<chops::expandable_buffer<std::vector<std::byte>>> buf;
+ *   buf.restart();
+ *   chops::marshall<msg_fmt>(buf, m);
+ *   if (seen.insert(buf.digest()).second) {
+ *     // first time this message has been serialized
+ *   }
+ * @endcode
+ *
+ * @note All bytes in a resized area must be written before @c size is called again,
+ * which is always the case within @c marshall.
+ *
+ * @tparam Buf Wrapped buffer type, e.g. @c chops::expandable_buffer.
+ *
+ */
+template <supports_endian_expandable_buffer Buf>
+class hashing_buffer {
+private:
+  Buf           m_buf;
+  std::size_t   m_hashed;
+  hash64_state  m_state;
+  std::uint64_t m_seed;
+
+  void update() {
+    auto sz = static_cast<std::size_t>(m_buf.size());
+    assert(sz >= m_hashed);
+    m_state.update(std::span<const std::byte>(m_buf.data() + m_hashed, sz - m_hashed));
+    m_hashed = sz;
+  }
+
+public:
+  using endian_type = typename Buf::endian_type;
+  using value_type = std::byte;
+  static constexpr bool append_only = true;
+
+  explicit hashing_buffer(std::uint64_t seed = 0u) : m_buf(), m_hashed(0u), m_state(seed), m_seed(seed) { }
+/**
+ * @brief Construct from a buffer, hashing bytes appended after its current contents.
+ */
+  explicit hashing_buffer(Buf buf, std::uint64_t seed = 0u) :
+    m_buf(std::move(buf)), m_hashed(static_cast<std::size_t>(m_buf.size())), m_state(seed), m_seed(seed) { }
+
+  std::size_t size() {
+    auto sz = static_cast<std::size_t>(m_buf.size());
+    if (sz - m_hashed >= hash64_block_size) {
+      update();
+    }
+    return sz;
+  }
+  void resize(std::size_t sz) {
+    assert(sz >= m_hashed);
+    m_buf.resize(sz);
+  }
+  std::byte* data() noexcept { return m_buf.data(); }
+
+/**
+ * @brief Return the hash of all bytes appended since construction or the last @c restart.
+ */
+  std::uint64_t digest() {
+    update();
+    return m_state.digest();
+  }
+/**
+ * @brief Start a new hash with the next appended byte.
+ */
+  void restart() {
+    m_hashed = static_cast<std::size_t>(m_buf.size());
+    m_state.reset(m_seed);
+  }
+/**
+ * @brief Return the wrapped buffer.
+ */
+  Buf& get_buf() noexcept { return m_buf; }
+};
+
+} // end namespace
+
+#endif
+
@@ -0,0 +1,488 @@
+/** @file
+ *
+ * @brief A small LZ77 family block codec, a buffer that compresses blocks as they are
+ * serialized, and a read cursor that decompresses blocks as they are unmarshalled, with
+ * the codec as a policy parameter.
+ *
+ * The codec is similar to the LZ4 block format: a sequence of tokens, each holding a
+ * literal length and a match length (4 bits each, extended with 255 valued bytes),
+ * followed by the literals and a 2 byte little endian match offset. Matches are found
+ * with a single 4096 entry hash table, there is no entropy coding. Decompression checks
+ * every length and offset, so malformed input is reported rather than read or written
+ * out of bounds.
+ *
+ * A @c compressing_buffer is used as the @c Buf parameter of @c chops::marshall. Each
+ * block is compressed when it fills, while the bytes are still in cache, rather than in
+ * a separate pass over a completed buffer. A @c decompressing_cursor is used as the
+ * @c Src parameter of @c chops::unmarshall (or @c validate), decompressing one block at
+ * a time as bytes are needed, so memory use is bounded by the block size.
+ *
+ * Both are parameterized on a block codec (see @c block_codec), @c lz_codec by default,
+ * so another codec (e.g. a wrapper around LZ4 or Zstandard) can be plugged in without
+ * changing the stream format or the serialization code.
+ *
+ * The compressed stream is a sequence of blocks, each with an 8 byte header (uncompressed
+ * size, then stored size, as 32 bit values in the buffer endianness). A block that does
+ * not compress is stored as is, flagged by the high bit of the stored size.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef LZ_COMPRESS_HPP_INCLUDED
+#define LZ_COMPRESS_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint32_t
+#include <cstring> // std::memcpy
+#include <array>
+#include <vector>
+#include <span>
+#include <optional>
+#include <algorithm> // std::copy_n
+#include <bit> // std::endian
+#include <concepts>
+#include <utility> // std::move
+#include <cassert>
+
+namespace chops {
+
+namespace detail {
+
+inline constexpr std::size_t lz_min_match = 4u;
+inline constexpr std::size_t lz_max_offset = 65535u;
+inline constexpr unsigned lz_hash_bits = 12u;
+
+inline std::uint32_t lz_load32(const std::byte* ptr) noexcept {
+  std::uint32_t val;
+  std::memcpy(&val, ptr, sizeof(val));
+  return val;
+}
+
+inline std::uint32_t lz_hash(std::uint32_t val) noexcept {
+  return (val * 2654435761u) >> (32u - lz_hash_bits);
+}
+
+inline std::byte* lz_append_len(std::byte* ptr, std::size_t len) noexcept {
+  for (; len >= 255u; len -= 255u) {
+    *ptr++ = std::byte{255u};
+  }
+  *ptr++ = static_cast<std::byte>(len);
+  return ptr;
+}
+
+// literal length, or match length, with the 255 valued extension bytes
+inline bool lz_extract_len(const std::byte*& ptr, const std::byte* end, std::size_t& len) noexcept {
+  if (len != 15u) {
+    return true;
+  }
+  std::uint8_t b;
+  do {
+    if (ptr == end) {
+      return false;
+    }
+    b = std::to_integer<std::uint8_t>(*ptr++);
+    len += b;
+  } while (b == 255u);
+  return true;
+}
+
+inline std::byte* lz_append_seq(std::byte* ptr, const std::byte* lits, std::size_t lit_len,
+                                std::size_t offset, std::size_t match_len) noexcept {
+  std::size_t m = (match_len == 0u) ? 0u : match_len - lz_min_match;
+  std::byte* token = ptr++;
+  *token = static_cast<std::byte>(((lit_len < 15u ? lit_len : 15u) << 4) | (m < 15u ? m : 15u));
+  if (lit_len >= 15u) {
+    ptr = lz_append_len(ptr, lit_len - 15u);
+  }
+  ptr = std::copy_n(lits, lit_len, ptr);
+  if (match_len == 0u) { // last sequence, literals only
+    return ptr;
+  }
+  *ptr++ = static_cast<std::byte>(offset & 0xFFu);
+  *ptr++ = static_cast<std::byte>(offset >> 8);
+  if (m >= 15u) {
+    ptr = lz_append_len(ptr, m - 15u);
+  }
+  return ptr;
+}
+
+} // end detail namespace
+
+/**
+ * @brief Return the maximum size of compressed output for an input size.
+ */
+constexpr std::size_t lz_compress_bound(std::size_t sz) noexcept {
+  return sz + sz / 255u + 16u;
+}
+
+/**
+ * @brief Compress a block of bytes.
+ *
+ * @param src Bytes to compress.
+ *
+ * @param sz Number of bytes to compress.
+ *
+ * @param dst Output, which must have room for @c lz_compress_bound(sz) bytes.
+ *
+ * @return Number of compressed bytes written.
+ *
+ */
+inline std::size_t lz_compress(const std::byte* src, std::size_t sz, std::byte* dst) noexcept {
+  std::array<std::uint32_t, (1u << detail::lz_hash_bits)> table { };
+  std::byte* out = dst;
+  std::size_t anchor {0u};
+  std::size_t pos {0u};
+  while (pos + detail::lz_min_match <= sz) {
+    std::uint32_t val = detail::lz_load32(src + pos);
+    auto& entry = table[detail::lz_hash(val)];
+    std::size_t cand = entry;
+    entry = static_cast<std::uint32_t>(pos);
+    if (cand >= pos || pos - cand > detail::lz_max_offset || detail::lz_load32(src + cand) != val) {
+      ++pos;
+      continue;
+    }
+    std::size_t len = detail::lz_min_match;
+    while (pos + len < sz && src[cand + len] == src[pos + len]) {
+      ++len;
+    }
+    out = detail::lz_append_seq(out, src + anchor, pos - anchor, pos - cand, len);
+    pos += len;
+    anchor = pos;
+  }
+  out = detail::lz_append_seq(out, src + anchor, sz - anchor, 0u, 0u);
+  return static_cast<std::size_t>(out - dst);
+}
+
+/**
+ * @brief Decompress a block of bytes compressed with @c lz_compress.
+ *
+ * @param src Compressed bytes.
+ *
+ * @param sz Number of compressed bytes.
+ *
+ * @param dst Output buffer.
+ *
+ * @param dst_cap Size of the output buffer.
+ *
+ * @return Number of decompressed bytes, or an empty @c std::optional if the input is
+ * malformed or does not fit in the output buffer.
+ *
+ */
+inline std::optional<std::size_t> lz_decompress(const std::byte* src, std::size_t sz,
+                                                std::byte* dst, std::size_t dst_cap) noexcept {
+  const std::byte* ip = src;
+  const std::byte* end = src + sz;
+  std::size_t op {0u};
+  while (ip != end) {
+    auto token = std::to_integer<std::uint8_t>(*ip++);
+    std::size_t lit_len = token >> 4;
+    if (!detail::lz_extract_len(ip, end, lit_len) ||
+        lit_len > static_cast<std::size_t>(end - ip) || lit_len > dst_cap - op) {
+      return { };
+    }
+    std::copy_n(ip, lit_len, dst + op);
+    ip += lit_len;
+    op += lit_len;
+    if (ip == end) {
+      return { op };
+    }
+    if (end - ip < 2) {
+      return { };
+    }
+    std::size_t offset = std::to_integer<std::size_t>(ip[0]) | (std::to_integer<std::size_t>(ip[1]) << 8);
+    ip += 2;
+    std::size_t match_len = token & 15u;
+    if (offset == 0u || offset > op || !detail::lz_extract_len(ip, end, match_len)) {
+      return { };
+    }
+    match_len += detail::lz_min_match;
+    if (match_len > dst_cap - op) {
+      return { };
+    }
+    const std::byte* match = dst + op - offset;
+    if (offset >= match_len) {
+      std::copy_n(match, match_len, dst + op);
+    }
+    else {
+      for (std::size_t i {0u}; i < match_len; ++i) { // overlapping, e.g. a repeated byte
+        dst[op + i] = match[i];
+      }
+    }
+    op += match_len;
+  }
+  return { }; // the last sequence ends with literals
+}
+
+/**
+ * @brief Concept for a block codec, the compression policy of @c compressing_buffer and
+ * @c decompressing_cursor.
+ *
+ * @c bound returns the maximum compressed size for an input size, @c compress compresses
+ * a block into an output with room for @c bound bytes and returns the compressed size,
+ * and @c decompress returns the decompressed size, or an empty @c std::optional if the
+ * input is malformed or does not fit in the output. Decompression must not read or write
+ * out of bounds for any input.
+ */
+template <typename Codec>
+concept block_codec =
+  requires (Codec codec, const std::byte* src, std::byte* dst, std::size_t sz) {
+    { codec.bound(sz) } -> std::same_as<std::size_t>;
+    { codec.compress(src, sz, dst) } -> std::same_as<std::size_t>;
+    { codec.decompress(src, sz, dst, sz) } -> std::same_as<std::optional<std::size_t>>;
+  };
+
+/**
+ * @brief The bundled block codec, @c lz_compress and @c lz_decompress.
+ */
+struct lz_codec {
+  std::size_t bound(std::size_t sz) const noexcept { return lz_compress_bound(sz); }
+  std::size_t compress(const std::byte* src, std::size_t sz, std::byte* dst) const noexcept {
+    return lz_compress(src, sz, dst);
+  }
+  std::optional<std::size_t> decompress(const std::byte* src, std::size_t sz,
+                                        std::byte* dst, std::size_t dst_cap) const noexcept {
+    return lz_decompress(src, sz, dst, dst_cap);
+  }
+};
+
+namespace detail {
+
+inline constexpr std::size_t lz_header_size = 2u * sizeof(std::uint32_t);
+inline constexpr std::uint32_t lz_stored_flag = 0x80000000u;
+
+} // end detail namespace
+
+/**
+ * @brief A buffer for @c chops::marshall that compresses the serialized bytes a block
+ * at a time, as the blocks fill.
+ *
+ * The @c size, @c resize, and @c data methods refer to the uncompressed bytes of the
+ * current block. Each @c marshall step starts by reading the buffer size, and that is
+ * when a full block is compressed and appended to the output container, so a block is
+ * compressed while it is still in cache. Call @c finish after the last @c marshall to
+ * compress the final partial block.
+ *
+ * @note All bytes in a resized area must be written before @c size is called again,
+ * which is always the case within @c marshall (but a @c write_cursor from
+ * @c make_write_cursor must be filled before the next @c marshall call).
+ *
+ * @tparam Ctr Output container for the compressed stream, e.g. @c std::vector<std::byte>.
+ *
+ * @tparam Endian Endianness of the serialized values and of the block headers.
+ *
+ * @tparam Codec Block codec, e.g. @c lz_codec.
+ *
+ */
+template <supports_expandable_buffer Ctr = std::vector<std::byte>,
+          std::endian Endian = std::endian::little,
+          block_codec Codec = lz_codec>
+class compressing_buffer {
+private:
+  Ctr                    m_out;
+  std::vector<std::byte> m_block;
+  std::size_t            m_block_size;
+  std::size_t            m_total;
+  [[no_unique_address]] Codec m_codec;
+
+  void compress_block() {
+    std::size_t raw_sz = m_block.size();
+    assert(raw_sz < detail::lz_stored_flag);
+    auto old_sz = static_cast<std::size_t>(m_out.size());
+    m_out.resize(old_sz + detail::lz_header_size + m_codec.bound(raw_sz));
+    std::byte* hdr = m_out.data() + old_sz;
+    std::byte* payload = hdr + detail::lz_header_size;
+    std::size_t stored_sz = m_codec.compress(m_block.data(), raw_sz, payload);
+    std::uint32_t stored_field = static_cast<std::uint32_t>(stored_sz);
+    if (stored_sz >= raw_sz) { // incompressible, stored as is
+      std::copy_n(m_block.data(), raw_sz, payload);
+      stored_sz = raw_sz;
+      stored_field = static_cast<std::uint32_t>(raw_sz) | detail::lz_stored_flag;
+    }
+    append_val<Endian>(hdr, static_cast<std::uint32_t>(raw_sz));
+    append_val<Endian>(hdr + sizeof(std::uint32_t), stored_field);
+    m_out.resize(old_sz + detail::lz_header_size + stored_sz);
+    m_total += raw_sz;
+    m_block.clear();
+  }
+
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+  using value_type = std::byte;
+  static constexpr bool append_only = true;
+
+/**
+ * @brief Construct with a block size, the number of uncompressed bytes after which a
+ * block is compressed (a single large value may result in a larger block), and a codec.
+ */
+  explicit compressing_buffer(std::size_t block_size = 65536u, Codec codec = Codec()) :
+      m_out(), m_block(), m_block_size(block_size), m_total(0u), m_codec(std::move(codec)) {
+    m_block.reserve(block_size);
+  }
+
+/**
+ * @brief Return the number of bytes in the current block, compressing the block first if
+ * it is full.
+ */
+  std::size_t size() {
+    if (m_block.size() >= m_block_size) {
+      compress_block();
+    }
+    return m_block.size();
+  }
+  void resize(std::size_t sz) { m_block.resize(sz); }
+  std::byte* data() noexcept { return m_block.data(); }
+
+/**
+ * @brief Compress the current block, if not empty, and return the compressed stream.
+ */
+  Ctr& finish() {
+    if (!m_block.empty()) {
+      compress_block();
+    }
+    return m_out;
+  }
+/**
+ * @brief Return the compressed stream, not including the current block.
+ */
+  Ctr& get_buf() noexcept { return m_out; }
+/**
+ * @brief Return the total number of uncompressed bytes serialized.
+ */
+  std::size_t uncompressed_size() const noexcept { return m_total + m_block.size(); }
+};
+
+/**
+ * @brief A bounds-checked read cursor over a compressed stream, decompressing one block
+ * at a time as bytes are needed.
+ *
+ * Values may span blocks. The unread bytes of the current block are kept when the next
+ * block is decompressed, so memory use is bounded by the block size (plus the largest
+ * fixed size run being read). The cursor satisfies @c checked_extract_buffer and reports
+ * errors the same as @c read_cursor, with malformed compressed data reported as
+ * @c decode_error::invalid_value.
+ *
+ * The window is reused as blocks are decompressed, so a pointer returned by @c data is
+ * only valid until the next @c ensure. The cursor declares @c stable_data as @c false,
+ * and formats that would otherwise view bytes in place (e.g. the dictionary of a
+ * @c dict_seq_fmt) copy them instead.
+ *
+ * The compressed stream is not owned, and must outlive the cursor.
+ *
+ * @tparam Endian Endianness of the serialized values and of the block headers.
+ *
+ * @tparam Codec Block codec, the same as used by the @c compressing_buffer.
+ *
+ */
+template <std::endian Endian = std::endian::little, block_codec Codec = lz_codec>
+class decompressing_cursor {
+private:
+  const std::byte*       m_in;
+  const std::byte*       m_in_end;
+  std::vector<std::byte> m_window;
+  std::size_t            m_pos;
+  std::size_t            m_max_block;
+  decode_error           m_err;
+  [[no_unique_address]] Codec m_codec;
+
+  // keep the unread bytes, then append the next decompressed block
+  bool next_block() {
+    if (static_cast<std::size_t>(m_in_end - m_in) < detail::lz_header_size) {
+      fail(m_in == m_in_end ? decode_error::truncated : decode_error::invalid_value);
+      return false;
+    }
+    auto raw_sz = static_cast<std::size_t>(extract_val<Endian, std::uint32_t>(m_in));
+    auto stored_field = extract_val<Endian, std::uint32_t>(m_in + sizeof(std::uint32_t));
+    bool stored = (stored_field & detail::lz_stored_flag) != 0u;
+    auto stored_sz = static_cast<std::size_t>(stored_field & ~detail::lz_stored_flag);
+    m_in += detail::lz_header_size;
+    if (raw_sz > m_max_block || stored_sz > static_cast<std::size_t>(m_in_end - m_in) ||
+        (stored && stored_sz != raw_sz)) {
+      fail(decode_error::invalid_value);
+      return false;
+    }
+    m_window.erase(m_window.begin(), m_window.begin() + static_cast<std::ptrdiff_t>(m_pos));
+    m_pos = 0u;
+    auto old_sz = m_window.size();
+    m_window.resize(old_sz + raw_sz);
+    if (stored) {
+      std::copy_n(m_in, raw_sz, m_window.data() + old_sz);
+    }
+    else if (m_codec.decompress(m_in, stored_sz, m_window.data() + old_sz, raw_sz) != std::optional<std::size_t>(raw_sz)) {
+      fail(decode_error::invalid_value);
+      return false;
+    }
+    m_in += stored_sz;
+    return true;
+  }
+
+public:
+  using endian_type = std::integral_constant<std::endian, Endian>;
+  static constexpr bool stable_data = false;
+
+/**
+ * @brief Construct from a compressed stream.
+ *
+ * @param buf Compressed stream, as created by @c compressing_buffer.
+ *
+ * @param max_block_size Largest uncompressed block size accepted, so that untrusted input
+ * cannot cause an arbitrarily large allocation.
+ *
+ * @param codec Block codec.
+ */
+  explicit decompressing_cursor(std::span<const std::byte> buf, std::size_t max_block_size = 1u << 24,
+                                Codec codec = Codec()) :
+    m_in(buf.data()), m_in_end(buf.data() + buf.size()), m_window(), m_pos(0u),
+    m_max_block(max_block_size), m_err(decode_error::none), m_codec(std::move(codec)) { }
+
+  const std::byte* data() const noexcept { return m_window.data() + m_pos; }
+/**
+ * @brief Return the number of decompressed bytes not yet read, zero once an error has
+ * occurred.
+ */
+  std::size_t remaining() const noexcept { return m_window.size() - m_pos; }
+  void advance(std::size_t sz) noexcept {
+    assert(sz <= remaining());
+    m_pos += sz;
+  }
+/**
+ * @brief Decompress blocks until @c sz bytes can be read, recording an error if the
+ * stream ends first or a block is malformed.
+ */
+  bool ensure(std::size_t sz) {
+    while (m_err == decode_error::none && remaining() < sz) {
+      if (!next_block()) {
+        return false;
+      }
+    }
+    if (m_err != decode_error::none) {
+      return false;
+    }
+    return true;
+  }
+  void fail(decode_error err) noexcept {
+    if (m_err == decode_error::none) {
+      m_err = err;
+    }
+    m_pos = m_window.size();
+    m_in = m_in_end;
+  }
+  bool ok() const noexcept { return m_err == decode_error::none; }
+  decode_error error() const noexcept { return m_err; }
+/**
+ * @brief Return @c true if all of the stream has been read.
+ */
+  bool at_end() const noexcept { return remaining() == 0u && m_in == m_in_end; }
+};
+
+} // end namespace
+
+#endif
+
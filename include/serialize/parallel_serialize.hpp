@@ -0,0 +1,424 @@
+/** @file
+ *
+ * @brief Serialize very large sequences, and decode batches of frames, using multiple
+ * threads.
+ *
+ * The bytes produced are identical to a single threaded @c marshall with the same
+ * format. The sequence is split into one contiguous chunk per thread. For variable size
+ * elements the encoded size of each chunk is computed in parallel, a prefix sum of the
+ * chunk sizes gives the offset of each chunk, and the buffer is resized once. Each
+ * thread then serializes its chunk through a @c write_cursor into its own region of the
+ * buffer, so no synchronization is needed other than joining the threads.
+ *
+ * A batch of frames (see @c marshall_framed) is decoded by first building an index of
+ * the frames with a scan over the lengths (see @c index_frames), then decoding the frames
+ * in parallel, each thread decoding a contiguous range of frames into the corresponding
+ * elements of the output.
+ *
+ * Each function is overloaded on where the threads come from. Given a thread count, the
+ * threads are started for the call and joined before it returns, which costs tens of
+ * microseconds per thread. That is negligible for one very large sequence, but not when
+ * many batches are decoded one after another, so the functions also accept a
+ * @c worker_pool, whose threads are started once and reused by every call.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef PARALLEL_SERIALIZE_HPP_INCLUDED
+#define PARALLEL_SERIALIZE_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <cstdint> // std::uint64_t
+#include <exception>
+#include <ranges>
+#include <algorithm> // std::min, std::max
+#include <cassert>
+
+namespace chops {
+
+/**
+ * @brief Minimum number of elements per thread, smaller sequences use fewer threads.
+ */
+inline constexpr std::size_t parallel_min_chunk = 4096u;
+/**
+ * @brief Minimum number of frames per thread when decoding a batch of frames.
+ */
+inline constexpr std::size_t parallel_min_frames = 256u;
+
+namespace detail {
+
+inline std::size_t num_workers(std::size_t num_threads, std::size_t num_elems, std::size_t min_chunk) noexcept {
+  if (num_threads == 0u) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max(std::size_t{1u}, std::min(num_threads, num_elems / min_chunk));
+}
+
+// first element of chunk i of n
+constexpr std::size_t chunk_begin(std::size_t num_elems, std::size_t i, std::size_t n) noexcept {
+  return static_cast<std::size_t>(static_cast<unsigned long long>(num_elems) * i / n);
+}
+
+} // end detail namespace
+
+/**
+ * @brief A fixed set of threads, reused by the parallel functions across calls.
+ *
+ * Each call of @c run hands one index to each of the pool threads it needs and one to
+ * the calling thread, then waits for all of them to finish. Calls from different threads
+ * are serialized, so one pool can be shared, but then only one call runs at a time.
+ *
+ * Example usage:
+ * @code
+ *   chops::worker_pool pool; // hardware concurrency
+ *   for (const auto& batch : batches) {
+ *     auto err = chops::unmarshall_batch_parallel<std::uint32_t, msg_fmt>(batch, msgs, pool);
+ *     // ...
+ *   }
+ * @endcode
+ *
+ */
+class worker_pool {
+public:
+
+/**
+ * @brief Start the threads of the pool.
+ *
+ * @param num_threads Number of threads including the calling thread, zero for the
+ * hardware concurrency. The pool starts one thread fewer.
+ *
+ */
+  explicit worker_pool(std::size_t num_threads = 0u) {
+    if (num_threads == 0u) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_workers.reserve(num_threads - 1u);
+    for (std::size_t k {1u}; k < num_threads; ++k) {
+      m_workers.emplace_back([this, k] (std::stop_token st) { work(st, k); });
+    }
+  }
+
+  worker_pool(const worker_pool&) = delete;
+  worker_pool& operator=(const worker_pool&) = delete;
+
+/**
+ * @brief Number of threads available to @c run, including the calling thread.
+ */
+  std::size_t num_threads() const noexcept { return m_workers.size() + 1u; }
+
+/**
+ * @brief Run @c func(i) for each @c i in [0, n), @c func(0) on the calling thread, and
+ * wait for all of them to finish.
+ *
+ * @pre @c n is at least one and at most @c num_threads(), and @c func does not throw.
+ *
+ */
+  template <typename F>
+  void run(std::size_t n, F& func) {
+    assert(n >= 1u && n <= num_threads());
+    if (n == 1u) {
+      func(0u);
+      return;
+    }
+    std::lock_guard run_lk(m_run_mutex);
+    {
+      std::lock_guard lk(m_mutex);
+      m_ctx = &func;
+      m_call = [] (void* ctx, std::size_t i) { (*static_cast<F*>(ctx))(i); };
+      m_num = n;
+      m_pending = n - 1u;
+      ++m_gen;
+    }
+    m_start_cv.notify_all();
+    func(0u);
+    std::unique_lock lk(m_mutex);
+    m_done_cv.wait(lk, [this] { return m_pending == 0u; });
+  }
+
+private:
+
+  // thread k runs index k of each call that needs at least k+1 threads
+  void work(std::stop_token st, std::size_t k) {
+    std::uint64_t seen {0u};
+    std::unique_lock lk(m_mutex);
+    while (m_start_cv.wait(lk, st, [&] { return m_gen != seen; })) {
+      seen = m_gen;
+      if (k < m_num) {
+        auto call = m_call;
+        auto ctx = m_ctx;
+        lk.unlock();
+        call(ctx, k);
+        lk.lock();
+        if (--m_pending == 0u) {
+          m_done_cv.notify_one();
+        }
+      }
+    }
+  }
+
+  std::mutex                  m_run_mutex;
+  std::mutex                  m_mutex;
+  std::condition_variable_any m_start_cv;
+  std::condition_variable     m_done_cv;
+  void                        (*m_call)(void*, std::size_t) {nullptr};
+  void*                       m_ctx {nullptr};
+  std::size_t                 m_num {0u};
+  std::size_t                 m_pending {0u};
+  std::uint64_t               m_gen {0u};
+  std::vector<std::jthread>   m_workers; // last, so stopped and joined first
+};
+
+namespace detail {
+
+// run func(i) for i in [0, n), func(0) on the calling thread, rethrowing the first exception,
+// on the threads of the pool or, without a pool, on threads started for this call
+template <typename F>
+void run_workers(worker_pool* pool, std::size_t n, F&& func) {
+  std::vector<std::exception_ptr> errs(n);
+  auto task = [&] (std::size_t i) {
+    try {
+      func(i);
+    }
+    catch (...) {
+      errs[i] = std::current_exception();
+    }
+  };
+  if (pool) {
+    pool->run(n, task);
+  }
+  else {
+    std::vector<std::jthread> threads;
+    threads.reserve(n - 1u);
+    for (std::size_t i {1u}; i < n; ++i) {
+      threads.emplace_back(task, i);
+    }
+    task(0u);
+  } // joined
+  for (auto& err : errs) {
+    if (err) {
+      std::rethrow_exception(err);
+    }
+  }
+}
+
+template <typename CastCnt, typename ElemFmt, typename Buf, typename Ctr>
+Buf& marshall_seq_parallel(worker_pool* pool, Buf& buf, const Ctr& ctr, std::size_t num_threads) {
+  constexpr auto endian = Buf::endian_type::value;
+  auto cnt = static_cast<std::size_t>(std::ranges::size(ctr));
+  check_count<CastCnt>(cnt);
+  auto n = num_workers(num_threads, cnt, parallel_min_chunk);
+  if (n == 1u) {
+    return marshall<seq_fmt<CastCnt, ElemFmt>>(buf, ctr);
+  }
+  auto first = std::ranges::begin(ctr);
+
+  std::vector<std::size_t> offsets(n + 1u, 0u);
+  if constexpr (fixed_size_format<ElemFmt>) {
+    for (std::size_t i {0u}; i <= n; ++i) {
+      offsets[i] = chunk_begin(cnt, i, n) * format_traits<ElemFmt>::fixed_size;
+    }
+  }
+  else {
+    run_workers(pool, n, [&] (std::size_t i) {
+      std::size_t sz {0u};
+      for (auto j = chunk_begin(cnt, i, n); j < chunk_begin(cnt, i+1u, n); ++j) {
+        sz += encoded_size_fmt<ElemFmt>(first[static_cast<std::ptrdiff_t>(j)]);
+      }
+      offsets[i+1u] = sz;
+    });
+    for (std::size_t i {1u}; i <= n; ++i) {
+      offsets[i] += offsets[i-1u];
+    }
+  }
+
+  auto old_sz = static_cast<std::size_t>(buf.size());
+  buf.resize(old_sz + sizeof(CastCnt) + offsets[n]);
+  std::byte* base = buf.data() + old_sz;
+  base += append_val<endian>(base, static_cast<CastCnt>(cnt));
+  run_workers(pool, n, [&] (std::size_t i) {
+    write_cursor<endian> cur(base + offsets[i], offsets[i+1u] - offsets[i]);
+    for (auto j = chunk_begin(cnt, i, n); j < chunk_begin(cnt, i+1u, n); ++j) {
+      marshall_fmt<ElemFmt>(cur, first[static_cast<std::ptrdiff_t>(j)]);
+    }
+    assert(cur.size() == cur.capacity());
+  });
+  return buf;
+}
+
+template <typename Fmt, std::endian Endian, typename Ctr>
+decode_error unmarshall_frames_parallel(worker_pool* pool, std::span<const std::span<const std::byte>> frames,
+                                        Ctr& out, std::size_t num_threads) {
+  auto cnt = frames.size();
+  out.resize(cnt);
+  auto n = num_workers(num_threads, cnt, parallel_min_frames);
+  auto first = std::ranges::begin(out);
+  std::vector<std::size_t> bad(n, cnt);
+  std::vector<decode_error> errs(n, decode_error::none);
+  run_workers(pool, n, [&] (std::size_t i) {
+    for (auto j = chunk_begin(cnt, i, n); j < chunk_begin(cnt, i+1u, n); ++j) {
+      read_cursor<Endian> cur(frames[j]);
+      auto err = try_unmarshall<Fmt>(cur, first[static_cast<std::ptrdiff_t>(j)]);
+      if (err == decode_error::none && cur.remaining() != 0u) {
+        err = decode_error::trailing_bytes;
+      }
+      if (err != decode_error::none) {
+        bad[i] = j;
+        errs[i] = err;
+        return;
+      }
+    }
+  });
+  for (std::size_t i {0u}; i < n; ++i) { // chunks are in frame order
+    if (errs[i] != decode_error::none) {
+      out.resize(bad[i]);
+      return errs[i];
+    }
+  }
+  return decode_error::none;
+}
+
+template <typename CastLen, typename Fmt, std::endian Endian, typename Ctr>
+decode_error unmarshall_batch_parallel(worker_pool* pool, std::span<const std::byte> batch,
+                                       Ctr& out, std::size_t num_threads) {
+  std::vector<std::span<const std::byte>> frames;
+  auto index_err = index_frames<CastLen, Endian>(batch, frames);
+  auto err = unmarshall_frames_parallel<Fmt, Endian>(pool, frames, out, num_threads);
+  return err != decode_error::none ? err : index_err;
+}
+
+} // end detail namespace
+
+/**
+ * @brief Marshall a large sequence using multiple threads, producing the same bytes as
+ * @c marshall with a @c seq_fmt<CastCnt, ElemFmt>.
+ *
+ * Example usage:
+ * @code
+ *   chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+ *   chops::marshall_seq_parallel<std::uint32_t, record_fmt>(buf, records);
+ * @endcode
+ *
+ * @tparam CastCnt Type of the element count, as in @c seq_fmt.
+ *
+ * @tparam ElemFmt Format of each element, as in @c seq_fmt.
+ *
+ * @param buf Buffer to store marshalled values, @c resize is called once.
+ *
+ * @param ctr Random access sequence, which must not be modified while marshalling.
+ *
+ * @param num_threads Maximum number of threads, including the calling thread, zero for
+ * the hardware concurrency. Each thread serializes at least @c parallel_min_chunk elements.
+ * The threads are started for this call, see the @c worker_pool overload to reuse threads.
+ *
+ * @pre Serializing an element must not modify shared state, i.e. the format traits must
+ * be safe to call concurrently for different elements (true for all of the library formats).
+ *
+ * @throw std::length_error If the number of elements does not fit in @c CastCnt.
+ *
+ */
+template <typename CastCnt, typename ElemFmt, supports_endian_expandable_buffer Buf,
+          std::ranges::random_access_range Ctr>
+  requires std::ranges::sized_range<Ctr>
+Buf& marshall_seq_parallel(Buf& buf, const Ctr& ctr, std::size_t num_threads = 0u) {
+  return detail::marshall_seq_parallel<CastCnt, ElemFmt>(nullptr, buf, ctr, num_threads);
+}
+
+/**
+ * @brief Marshall a large sequence on the threads of a @c worker_pool, otherwise the
+ * same as the overload taking a thread count.
+ */
+template <typename CastCnt, typename ElemFmt, supports_endian_expandable_buffer Buf,
+          std::ranges::random_access_range Ctr>
+  requires std::ranges::sized_range<Ctr>
+Buf& marshall_seq_parallel(Buf& buf, const Ctr& ctr, worker_pool& pool) {
+  return detail::marshall_seq_parallel<CastCnt, ElemFmt>(&pool, buf, ctr, pool.num_threads());
+}
+
+/**
+ * @brief Unmarshall frames in parallel, in order, into the elements of a container.
+ *
+ * Each frame is decoded through a @c read_cursor, so the frames may be untrusted, and each
+ * frame must contain exactly one value. Existing elements of the container are decoded
+ * into (see @c unmarshall).
+ *
+ * Example usage:
+ * @code
+ *   std::vector<std::span<const std::byte>> frames;
+ *   chops::index_frames<std::uint32_t, std::endian::big>(batch, frames);
+ *   std::vector<msg> msgs;
+ *   auto err = chops::unmarshall_frames_parallel<msg_fmt, std::endian::big>(frames, msgs);
+ * @endcode
+ *
+ * @param frames The bytes of each frame, e.g. from @c index_frames.
+ *
+ * @param out Resizable random access container, resized to the number of frames.
+ *
+ * @param num_threads Maximum number of threads, including the calling thread, zero for
+ * the hardware concurrency. Each thread decodes at least @c parallel_min_frames frames.
+ * The threads are started for this call, see the @c worker_pool overload to reuse threads.
+ *
+ * @return @c decode_error::none, or the error of the first invalid frame, in which case
+ * @c out is resized to the number of frames before it (i.e. its index).
+ *
+ */
+template <typename Fmt, std::endian Endian = std::endian::little, typename Ctr>
+  requires detail::resizable_sequence<Ctr> && std::ranges::random_access_range<Ctr> &&
+           unmarshallable_with<Fmt, read_cursor<Endian>, std::ranges::range_value_t<Ctr>>
+decode_error unmarshall_frames_parallel(std::span<const std::span<const std::byte>> frames,
+                                        Ctr& out, std::size_t num_threads = 0u) {
+  return detail::unmarshall_frames_parallel<Fmt, Endian>(nullptr, frames, out, num_threads);
+}
+
+/**
+ * @brief Unmarshall frames on the threads of a @c worker_pool, otherwise the same as the
+ * overload taking a thread count.
+ */
+template <typename Fmt, std::endian Endian = std::endian::little, typename Ctr>
+  requires detail::resizable_sequence<Ctr> && std::ranges::random_access_range<Ctr> &&
+           unmarshallable_with<Fmt, read_cursor<Endian>, std::ranges::range_value_t<Ctr>>
+decode_error unmarshall_frames_parallel(std::span<const std::span<const std::byte>> frames,
+                                        Ctr& out, worker_pool& pool) {
+  return detail::unmarshall_frames_parallel<Fmt, Endian>(&pool, frames, out, pool.num_threads());
+}
+
+/**
+ * @brief Index a batch of frames, then unmarshall the frames in parallel.
+ *
+ * @return As for @c unmarshall_frames_parallel, or @c decode_error::truncated if the
+ * frames are valid but the batch ends with an incomplete frame.
+ *
+ */
+template <std::unsigned_integral CastLen, typename Fmt, std::endian Endian = std::endian::little,
+          typename Ctr>
+decode_error unmarshall_batch_parallel(std::span<const std::byte> batch, Ctr& out,
+                                       std::size_t num_threads = 0u) {
+  return detail::unmarshall_batch_parallel<CastLen, Fmt, Endian>(nullptr, batch, out, num_threads);
+}
+
+/**
+ * @brief Index a batch of frames, then unmarshall the frames on the threads of a
+ * @c worker_pool, e.g. when decoding many batches one after another.
+ */
+template <std::unsigned_integral CastLen, typename Fmt, std::endian Endian = std::endian::little,
+          typename Ctr>
+decode_error unmarshall_batch_parallel(std::span<const std::byte> batch, Ctr& out, worker_pool& pool) {
+  return detail::unmarshall_batch_parallel<CastLen, Fmt, Endian>(&pool, batch, out, pool.num_threads());
+}
+
+} // end namespace
+
+#endif
+
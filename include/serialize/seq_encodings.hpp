@@ -0,0 +1,695 @@
+/** @file
+ *
+ * @brief Compact format directives for sequences: frame-of-reference bit packing,
+ * delta (or delta-of-delta) encoding, and run-length encoding.
+ *
+ * Sorted ids and monotonic timestamps are very compressible. Both directives split a
+ * sequence into blocks of 128 values. Each block is written as a reference value and a
+ * bit width, followed by each value (minus the reference) packed into that many bits.
+ * The delta directive packs the differences between consecutive values instead of the
+ * values themselves, so a sequence with a regular stride packs into very few bits.
+ *
+ * The packed bits are written least significant bit first, independent of the buffer
+ * endianness (as with @c append_var_int), while the reference values use the buffer
+ * endianness.
+ *
+ * Element types for the bit packing directives are integral types, or @c std::chrono
+ * durations and time points (the tick count is serialized, without unit conversion).
+ * The run-length directive accepts any fixed size element format.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SEQ_ENCODINGS_HPP_INCLUDED
+#define SEQ_ENCODINGS_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint64_t, etc
+#include <array>
+#include <algorithm> // std::fill_n, std::min
+#include <iterator> // std::next
+#include <limits>
+#include <ranges>
+#include <bit> // std::bit_width
+#include <concepts>
+#include <type_traits>
+
+namespace chops {
+
+/**
+ * @brief Format directive for an integer sequence, serialized with frame-of-reference
+ * bit packing in blocks of 128 values.
+ *
+ * @tparam CastCnt Unsigned integer type of the element count.
+ *
+ * @tparam CastVal Integer type each element is converted to before packing; this
+ * determines the range of values and whether values are signed.
+ *
+ */
+template <std::unsigned_integral CastCnt, std::integral CastVal>
+struct for_seq_fmt { };
+
+/**
+ * @brief Format directive for an integer sequence, serialized as the first value(s)
+ * followed by bit packed differences in blocks of 128 values.
+ *
+ * With an @c Order of 2 the difference between consecutive differences is packed
+ * (delta-of-delta), which is near zero for timestamps with a regular interval.
+ *
+ * @tparam CastCnt Unsigned integer type of the element count.
+ *
+ * @tparam CastVal Integer type each element is converted to; the first @c Order values
+ * are serialized with this type.
+ *
+ * @tparam Order 1 for delta encoding, 2 for delta-of-delta encoding.
+ *
+ */
+template <std::unsigned_integral CastCnt, std::integral CastVal, unsigned Order = 1u>
+  requires (Order == 1u || Order == 2u)
+struct delta_seq_fmt { };
+
+namespace detail {
+
+inline constexpr std::size_t pack_block_size = 128u;
+// reference value and bit width
+inline constexpr std::size_t pack_header_size = sizeof(std::uint64_t) + 1u;
+
+template <typename T>
+concept packable_elem = (std::integral<T> && !std::same_as<T, bool>) || chrono_type<T>;
+
+constexpr std::size_t packed_bytes(std::size_t num, unsigned width) noexcept {
+  return (num * width + 7u) / 8u;
+}
+
+constexpr std::size_t num_blocks(std::size_t num) noexcept {
+  return (num + pack_block_size - 1u) / pack_block_size;
+}
+
+constexpr std::uint64_t zigzag(std::uint64_t val) noexcept {
+  return (val << 1) ^ (std::uint64_t{0u} - (val >> 63));
+}
+
+constexpr std::uint64_t unzigzag(std::uint64_t val) noexcept {
+  return (val >> 1) ^ (std::uint64_t{0u} - (val & 1u));
+}
+
+// tick count of a chrono type, or the integral value
+template <packable_elem T>
+constexpr auto elem_rep(const T& val) noexcept {
+  if constexpr (is_time_point<T>::value) {
+    return val.time_since_epoch().count();
+  }
+  else if constexpr (is_duration<T>::value) {
+    return val.count();
+  }
+  else {
+    return val;
+  }
+}
+
+template <packable_elem T, typename Rep>
+constexpr void set_elem_rep(T& val, Rep rep) noexcept {
+  if constexpr (is_time_point<T>::value || is_duration<T>::value) {
+    val = T(typename T::duration(static_cast<typename T::rep>(rep)));
+  }
+  else {
+    val = static_cast<T>(rep);
+  }
+}
+
+// the value as a 64 bit unsigned integer, sign extended, so differences wrap correctly
+template <std::integral CastVal, packable_elem T>
+constexpr std::uint64_t to_wide(const T& val) noexcept {
+  auto cast_val = static_cast<CastVal>(elem_rep(val));
+  if constexpr (std::is_signed_v<CastVal>) {
+    return static_cast<std::uint64_t>(static_cast<std::int64_t>(cast_val));
+  }
+  else {
+    return static_cast<std::uint64_t>(cast_val);
+  }
+}
+
+template <std::integral CastVal, packable_elem T>
+constexpr void from_wide(std::uint64_t wide, T& val) noexcept {
+  set_elem_rep(val, static_cast<CastVal>(wide));
+}
+
+// order preserving unsigned key, for the minimum value of a block
+template <std::integral CastVal>
+constexpr std::uint64_t to_key(std::uint64_t wide) noexcept {
+  if constexpr (std::is_signed_v<CastVal>) {
+    return wide ^ (std::uint64_t{1u} << 63);
+  }
+  else {
+    return wide;
+  }
+}
+
+template <std::integral CastVal>
+constexpr std::uint64_t from_key(std::uint64_t key) noexcept {
+  return to_key<CastVal>(key);
+}
+
+constexpr unsigned block_width(const std::uint64_t* keys, std::size_t num, std::uint64_t& ref) noexcept {
+  std::uint64_t lo = keys[0];
+  std::uint64_t hi = keys[0];
+  for (std::size_t i {1u}; i < num; ++i) {
+    lo = std::min(lo, keys[i]);
+    hi = std::max(hi, keys[i]);
+  }
+  ref = lo;
+  return static_cast<unsigned>(std::bit_width(hi - lo));
+}
+
+constexpr std::size_t block_size(const std::uint64_t* keys, std::size_t num) noexcept {
+  std::uint64_t ref {0u};
+  return pack_header_size + packed_bytes(num, block_width(keys, num, ref));
+}
+
+template <std::endian Endian>
+constexpr std::size_t pack_block(std::byte* buf, const std::uint64_t* keys, std::size_t num) noexcept {
+  std::uint64_t ref {0u};
+  unsigned width = block_width(keys, num, ref);
+  std::byte* ptr = buf + append_val<Endian>(buf, ref);
+  *ptr++ = static_cast<std::byte>(width);
+  std::size_t nbytes = packed_bytes(num, width);
+  std::fill_n(ptr, nbytes, std::byte{0});
+  for (std::size_t i {0u}; width != 0u && i < num; ++i) {
+    std::uint64_t diff = keys[i] - ref;
+    std::size_t bit = i * width;
+    std::size_t byte = bit / 8u;
+    unsigned shift = static_cast<unsigned>(bit % 8u);
+    std::uint64_t lo_bits = diff << shift;
+    for (std::size_t k {0u}; k < 8u && byte + k < nbytes; ++k) {
+      ptr[byte + k] |= static_cast<std::byte>(lo_bits >> (8u * k));
+    }
+    if (shift + width > 64u) {
+      ptr[byte + 8u] |= static_cast<std::byte>(diff >> (64u - shift));
+    }
+  }
+  return pack_header_size + nbytes;
+}
+
+// a full 64 bit little endian load is used wherever it stays within the packed bytes,
+// with no per value branches other than the loop bound
+constexpr void unpack_block(const std::byte* buf, std::size_t nbytes, unsigned width,
+                            std::uint64_t ref, std::uint64_t* keys, std::size_t num) noexcept {
+  if (width == 0u) {
+    std::fill_n(keys, num, ref);
+    return;
+  }
+  const std::uint64_t mask = (width == 64u) ? ~std::uint64_t{0u} : ((std::uint64_t{1u} << width) - 1u);
+  std::size_t i {0u};
+  if (width <= 56u) {
+    std::size_t num_fast = (nbytes >= 8u) ? std::min(num, ((nbytes - 8u) * 8u) / width + 1u) : 0u;
+    for (; i < num_fast; ++i) {
+      std::size_t bit = i * width;
+      auto word = extract_val<std::endian::little, std::uint64_t>(buf + bit / 8u);
+      keys[i] = ref + ((word >> (bit % 8u)) & mask);
+    }
+  }
+  for (; i < num; ++i) {
+    std::size_t bit = i * width;
+    std::size_t byte = bit / 8u;
+    unsigned shift = static_cast<unsigned>(bit % 8u);
+    std::uint64_t word {0u};
+    for (std::size_t k {0u}; k < 8u && byte + k < nbytes; ++k) {
+      word |= std::to_integer<std::uint64_t>(buf[byte + k]) << (8u * k);
+    }
+    std::uint64_t val = word >> shift;
+    if (shift + width > 64u) {
+      val |= std::to_integer<std::uint64_t>(buf[byte + 8u]) << (64u - shift);
+    }
+    keys[i] = ref + (val & mask);
+  }
+}
+
+// the keys are produced one at a time by a key function, a block at a time
+template <typename Iter, typename KeyFn>
+constexpr std::size_t packed_size(Iter iter, std::size_t num, KeyFn key_fn) {
+  std::array<std::uint64_t, pack_block_size> keys { };
+  std::size_t sz {0u};
+  while (num != 0u) {
+    std::size_t n = std::min(num, pack_block_size);
+    for (std::size_t i {0u}; i < n; ++i, ++iter) {
+      keys[i] = key_fn(*iter);
+    }
+    sz += block_size(keys.data(), n);
+    num -= n;
+  }
+  return sz;
+}
+
+template <std::endian Endian, typename Iter, typename KeyFn>
+constexpr std::byte* pack_blocks(std::byte* ptr, Iter iter, std::size_t num, KeyFn key_fn) {
+  std::array<std::uint64_t, pack_block_size> keys { };
+  while (num != 0u) {
+    std::size_t n = std::min(num, pack_block_size);
+    for (std::size_t i {0u}; i < n; ++i, ++iter) {
+      keys[i] = key_fn(*iter);
+    }
+    ptr += pack_block<Endian>(ptr, keys.data(), n);
+    num -= n;
+  }
+  return ptr;
+}
+
+// each unpacked key is passed to the output function, decoding stops at the first error
+template <supports_endian_extract_buffer Src, typename OutFn>
+constexpr void unpack_blocks(Src& src, std::size_t num, OutFn out_fn) {
+  std::array<std::uint64_t, pack_block_size> keys { };
+  while (num != 0u && decode_ok(src)) {
+    std::size_t n = std::min(num, pack_block_size);
+    if (!has_bytes(src, pack_header_size)) {
+      return;
+    }
+    auto ref = extract_val<Src::endian_type::value, std::uint64_t>(src.data());
+    auto width = std::to_integer<unsigned>(src.data()[sizeof(std::uint64_t)]);
+    if (width > 64u) {
+      fail_decode(src, decode_error::invalid_value);
+      return;
+    }
+    src.advance(pack_header_size);
+    std::size_t nbytes = packed_bytes(n, width);
+    if (!has_bytes(src, nbytes)) {
+      return;
+    }
+    unpack_block(src.data(), nbytes, width, ref, keys.data(), n);
+    src.advance(nbytes);
+    for (std::size_t i {0u}; i < n; ++i) {
+      out_fn(keys[i]);
+    }
+    num -= n;
+  }
+}
+
+template <checked_extract_buffer Src>
+constexpr void validate_blocks(Src& src, std::size_t num) {
+  while (num != 0u && src.ok()) {
+    std::size_t n = std::min(num, pack_block_size);
+    if (!has_bytes(src, pack_header_size)) {
+      return;
+    }
+    auto width = std::to_integer<unsigned>(src.data()[sizeof(std::uint64_t)]);
+    if (width > 64u) {
+      fail_decode(src, decode_error::invalid_value);
+      return;
+    }
+    src.advance(pack_header_size);
+    std::size_t nbytes = packed_bytes(n, width);
+    if (has_bytes(src, nbytes)) {
+      src.advance(nbytes);
+    }
+    num -= n;
+  }
+}
+
+constexpr std::size_t max_packed_size(std::size_t max_cnt) noexcept {
+  return sat_add(sat_mul(num_blocks(max_cnt), pack_header_size), sat_mul(max_cnt, sizeof(std::uint64_t)));
+}
+
+// decode a count, then either resize the container and fill it in place, or insert
+template <typename CastCnt, std::size_t MaxSeeds, std::size_t SeedSize,
+          supports_endian_extract_buffer Src, typename Ctr, typename FillFn>
+constexpr Src& unmarshall_packed(Src& src, Ctr& ctr, FillFn fill_fn) {
+  auto cnt = static_cast<std::size_t>(unserialize_val<CastCnt>(src));
+  // an untrusted count is checked against the minimum size of its blocks before resizing
+  auto num_seeds = std::min(cnt, MaxSeeds);
+  if (!decode_ok(src) ||
+      !has_bytes(src, sat_add(num_seeds * SeedSize, sat_mul(num_blocks(cnt - num_seeds), pack_header_size)))) {
+    ctr.clear();
+    return src;
+  }
+  if constexpr (resizable_sequence<Ctr>) {
+    ctr.resize(cnt);
+    auto it = std::ranges::begin(ctr);
+    fill_fn(cnt, [&it] (auto setter) { setter(*it); ++it; });
+  }
+  else {
+    ctr.clear();
+    fill_fn(cnt, [&ctr, &src] (auto setter) {
+      auto elem = make_elem<typename Ctr::value_type>(src, ctr);
+      setter(elem);
+      ctr.insert(ctr.end(), std::move(elem));
+    });
+  }
+  return src;
+}
+
+} // end detail namespace
+
+template <typename CastCnt, typename CastVal>
+struct format_traits<for_seq_fmt<CastCnt, CastVal>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size =
+    detail::sat_add(sizeof(CastCnt), detail::max_packed_size(std::numeric_limits<CastCnt>::max()));
+
+  static constexpr auto key_fn = [] (const auto& elem) {
+    return detail::to_key<CastVal>(detail::to_wide<CastVal>(elem));
+  };
+
+  template <std::ranges::sized_range Ctr>
+    requires detail::packable_elem<std::ranges::range_value_t<Ctr>>
+  static constexpr std::size_t encoded_size(const Ctr& ctr) {
+    return sizeof(CastCnt) + detail::packed_size(std::ranges::begin(ctr), std::ranges::size(ctr), key_fn);
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+    requires detail::packable_elem<std::ranges::range_value_t<Ctr>>
+  static constexpr Buf& marshall(Buf& buf, const Ctr& ctr) {
+    auto cnt = static_cast<std::size_t>(std::ranges::size(ctr));
+    detail::check_count<CastCnt>(cnt);
+    // sizing pass, then a single resize
+    auto old_sz = buf.size();
+    buf.resize(old_sz + encoded_size(ctr));
+    std::byte* ptr = buf.data() + old_sz;
+    ptr += append_val<Buf::endian_type::value>(ptr, static_cast<CastCnt>(cnt));
+    detail::pack_blocks<Buf::endian_type::value>(ptr, std::ranges::begin(ctr), cnt, key_fn);
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr) { ctr.clear(); } &&
+             detail::packable_elem<typename Ctr::value_type>
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    return detail::unmarshall_packed<CastCnt, 0u, 0u>(src, ctr,
+      [&src] (std::size_t cnt, auto emit) {
+        detail::unpack_blocks(src, cnt, [&emit] (std::uint64_t key) {
+          emit([key] (auto& elem) { detail::from_wide<CastVal>(detail::from_key<CastVal>(key), elem); });
+        });
+      });
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    detail::validate_blocks(src, cnt);
+  }
+};
+
+template <typename CastCnt, typename CastVal, unsigned Order>
+struct format_traits<delta_seq_fmt<CastCnt, CastVal, Order>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size =
+    detail::sat_add(sizeof(CastCnt) + Order * sizeof(CastVal),
+                    detail::max_packed_size(std::numeric_limits<CastCnt>::max()));
+
+  // the residual of each value after the first Order values, as a zigzag encoded difference
+  struct residual_fn {
+    std::uint64_t prev;
+    std::uint64_t prev_delta;
+
+    template <typename T>
+    constexpr std::uint64_t operator()(const T& elem) noexcept {
+      std::uint64_t cur = detail::to_wide<CastVal>(elem);
+      std::uint64_t delta = cur - prev;
+      std::uint64_t res = (Order == 1u) ? delta : delta - prev_delta;
+      prev = cur;
+      prev_delta = delta;
+      return detail::zigzag(res);
+    }
+  };
+
+  template <typename Iter>
+  static constexpr residual_fn start(Iter iter, std::size_t num_seeds) {
+    residual_fn fn { 0u, 0u };
+    for (std::size_t i {0u}; i < num_seeds; ++i, ++iter) {
+      std::uint64_t cur = detail::to_wide<CastVal>(*iter);
+      fn.prev_delta = cur - fn.prev;
+      fn.prev = cur;
+    }
+    return fn;
+  }
+
+  template <std::ranges::sized_range Ctr>
+    requires detail::packable_elem<std::ranges::range_value_t<Ctr>>
+  static constexpr std::size_t encoded_size(const Ctr& ctr) {
+    auto cnt = std::ranges::size(ctr);
+    auto num_seeds = std::min<std::size_t>(cnt, Order);
+    return sizeof(CastCnt) + num_seeds * sizeof(CastVal) +
+           detail::packed_size(std::next(std::ranges::begin(ctr), num_seeds), cnt - num_seeds,
+                               start(std::ranges::begin(ctr), num_seeds));
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+    requires detail::packable_elem<std::ranges::range_value_t<Ctr>>
+  static constexpr Buf& marshall(Buf& buf, const Ctr& ctr) {
+    constexpr auto endian = Buf::endian_type::value;
+    auto cnt = static_cast<std::size_t>(std::ranges::size(ctr));
+    detail::check_count<CastCnt>(cnt);
+    auto num_seeds = std::min<std::size_t>(cnt, Order);
+    auto old_sz = buf.size();
+    buf.resize(old_sz + encoded_size(ctr));
+    std::byte* ptr = buf.data() + old_sz;
+    ptr += append_val<endian>(ptr, static_cast<CastCnt>(cnt));
+    auto iter = std::ranges::begin(ctr);
+    for (std::size_t i {0u}; i < num_seeds; ++i, ++iter) {
+      ptr += append_val<endian>(ptr, static_cast<CastVal>(detail::elem_rep(*iter)));
+    }
+    detail::pack_blocks<endian>(ptr, iter, cnt - num_seeds, start(std::ranges::begin(ctr), num_seeds));
+    return buf;
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr) { ctr.clear(); } &&
+             detail::packable_elem<typename Ctr::value_type>
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    return detail::unmarshall_packed<CastCnt, Order, sizeof(CastVal)>(src, ctr,
+      [&src] (std::size_t cnt, auto emit) {
+        auto num_seeds = std::min<std::size_t>(cnt, Order);
+        std::uint64_t prev {0u};
+        std::uint64_t prev_delta {0u};
+        auto next = [&prev, &prev_delta] (std::uint64_t cur) {
+          prev_delta = cur - prev;
+          prev = cur;
+          return [cur] (auto& elem) { detail::from_wide<CastVal>(cur, elem); };
+        };
+        for (std::size_t i {0u}; i < num_seeds; ++i) {
+          auto seed = detail::unserialize_val<CastVal>(src);
+          emit(next(detail::to_wide<CastVal>(seed)));
+        }
+        detail::unpack_blocks(src, cnt - num_seeds, [&] (std::uint64_t key) {
+          std::uint64_t res = detail::unzigzag(key);
+          emit(next(prev + ((Order == 1u) ? res : prev_delta + res)));
+        });
+      });
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto cnt = static_cast<std::size_t>(detail::unserialize_val<CastCnt>(src));
+    auto num_seeds = std::min<std::size_t>(cnt, Order);
+    if (detail::has_bytes(src, num_seeds * sizeof(CastVal))) {
+      src.advance(num_seeds * sizeof(CastVal));
+      detail::validate_blocks(src, cnt - num_seeds);
+    }
+  }
+};
+
+/**
+ * @brief Format directive for a sequence with long runs of identical values, serialized
+ * as the element count followed by each run: the value, then the run length as a variable
+ * length integer (7 bits per byte, the same encoding as @c append_var_int).
+ *
+ * Two elements are in the same run if they serialize to the same bytes. When decoding,
+ * each run value is extracted once and copied into the destination container.
+ *
+ * @tparam CastCnt Unsigned integer type of the element count and run lengths.
+ *
+ * @tparam ElemFmt Fixed size format of each element.
+ *
+ * @tparam MaxCnt Maximum number of elements. Since a few bytes can expand into a very
+ * long run, the element count of untrusted input is only limited by this value. A larger
+ * sequence throws @c std::length_error when serializing.
+ *
+ */
+template <std::unsigned_integral CastCnt, typename ElemFmt,
+          std::size_t MaxCnt = std::numeric_limits<CastCnt>::max()>
+  requires fixed_size_format<ElemFmt>
+struct rle_seq_fmt { };
+
+namespace detail {
+
+// the comparisons within a chunk have no early exit, so they can be vectorized
+template <typename T>
+constexpr std::size_t run_length(const T* vals, std::size_t num) noexcept {
+  constexpr std::size_t chunk = 16u;
+  const T val = vals[0];
+  std::size_t i {1u};
+  while (i + chunk <= num) {
+    bool same = true;
+    for (std::size_t k {0u}; k < chunk; ++k) {
+      same &= (vals[i + k] == val);
+    }
+    if (!same) {
+      break;
+    }
+    i += chunk;
+  }
+  while (i < num && vals[i] == val) {
+    ++i;
+  }
+  return i;
+}
+
+// calls the run function with the first element of each run and the run length
+template <typename ElemFmt, std::ranges::sized_range Ctr, typename RunFn>
+constexpr void for_each_run(const Ctr& ctr, RunFn run_fn) {
+  if constexpr (is_bulk_convertible<ElemFmt, Ctr>()) {
+    const auto* vals = std::ranges::data(ctr);
+    std::size_t num = std::ranges::size(ctr);
+    for (std::size_t i {0u}; i < num; ) {
+      std::size_t run = run_length(vals + i, num - i);
+      run_fn(vals[i], run);
+      i += run;
+    }
+  }
+  else {
+    // elements are compared by their serialized bytes
+    using traits = format_traits<ElemFmt>;
+    auto it = std::ranges::begin(ctr);
+    auto end = std::ranges::end(ctr);
+    if (it == end) {
+      return;
+    }
+    std::array<std::byte, traits::fixed_size> run_bytes { };
+    std::array<std::byte, traits::fixed_size> elem_bytes { };
+    traits::template append<std::endian::native>(run_bytes.data(), *it);
+    auto run_it = it;
+    std::size_t run {1u};
+    for (++it; it != end; ++it) {
+      traits::template append<std::endian::native>(elem_bytes.data(), *it);
+      if (elem_bytes == run_bytes) {
+        ++run;
+        continue;
+      }
+      run_fn(*run_it, run);
+      run_it = it;
+      run_bytes = elem_bytes;
+      run = 1u;
+    }
+    run_fn(*run_it, run);
+  }
+}
+
+} // end detail namespace
+
+template <typename CastCnt, typename ElemFmt, std::size_t MaxCnt>
+struct format_traits<rle_seq_fmt<CastCnt, ElemFmt, MaxCnt>> {
+  using elem_traits = format_traits<ElemFmt>;
+
+  static constexpr bool is_fixed_size = false;
+  // each element a run of one
+  static constexpr std::size_t max_size =
+    detail::sat_add(sizeof(CastCnt), detail::sat_mul(MaxCnt, elem_traits::fixed_size + 1u));
+
+  template <std::ranges::sized_range Ctr>
+  static constexpr std::size_t encoded_size(const Ctr& ctr) {
+    std::size_t sz { sizeof(CastCnt) };
+    detail::for_each_run<ElemFmt>(ctr, [&sz] (const auto&, std::size_t run) {
+      sz += elem_traits::fixed_size + detail::var_int_size(static_cast<CastCnt>(run));
+    });
+    return sz;
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+  static constexpr Buf& marshall(Buf& buf, const Ctr& ctr) {
+    constexpr auto endian = Buf::endian_type::value;
+    auto cnt = static_cast<std::size_t>(std::ranges::size(ctr));
+    detail::check_count<CastCnt, MaxCnt>(cnt);
+    // sizing pass, then a single resize
+    auto old_sz = buf.size();
+    buf.resize(old_sz + encoded_size(ctr));
+    std::byte* ptr = buf.data() + old_sz;
+    ptr += append_val<endian>(ptr, static_cast<CastCnt>(cnt));
+    detail::for_each_run<ElemFmt>(ctr, [&ptr] (const auto& elem, std::size_t run) {
+      ptr += elem_traits::template append<endian>(ptr, elem);
+      ptr += append_var_int(ptr, static_cast<CastCnt>(run));
+    });
+    return buf;
+  }
+
+  // the run value is extracted once, then copied for the rest of the run
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr) { typename Ctr::value_type; ctr.clear(); ctr.end(); }
+  static constexpr Src& unmarshall(Src& src, Ctr& ctr) {
+    auto cnt = static_cast<std::size_t>(detail::unserialize_val<CastCnt>(src));
+    if (cnt > MaxCnt) {
+      ctr.clear();
+      detail::fail_decode(src, decode_error::count_too_large);
+      return src;
+    }
+    auto next_run = [&src] (typename Ctr::value_type& val, std::size_t left) -> std::size_t {
+      detail::unmarshall_fmt<ElemFmt>(src, val);
+      auto run = static_cast<std::size_t>(detail::unserialize_var_int<CastCnt>(src));
+      if (!detail::decode_ok(src)) {
+        return 0u;
+      }
+      if (run == 0u || run > left) {
+        detail::fail_decode(src, decode_error::invalid_value);
+        return 0u;
+      }
+      return run;
+    };
+    if constexpr (detail::resizable_sequence<Ctr>) {
+      // grown one decoded run at a time, so an untrusted count allocates nothing up front
+      ctr.clear();
+      for (std::size_t done {0u}; done != cnt; ) {
+        auto elem = detail::make_elem<typename Ctr::value_type>(src, ctr);
+        auto run = next_run(elem, cnt - done);
+        if (run == 0u) {
+          break;
+        }
+        ctr.resize(done + run);
+        std::fill_n(std::next(std::ranges::begin(ctr), static_cast<std::ptrdiff_t>(done)), run, elem);
+        done += run;
+      }
+    }
+    else {
+      ctr.clear();
+      for (std::size_t left {cnt}; left != 0u; ) {
+        auto elem = detail::make_elem<typename Ctr::value_type>(src, ctr);
+        auto run = next_run(elem, left);
+        if (run == 0u) {
+          break;
+        }
+        for (std::size_t i {1u}; i < run; ++i) {
+          ctr.insert(ctr.end(), elem);
+        }
+        ctr.insert(ctr.end(), std::move(elem));
+        left -= run;
+      }
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto cnt = static_cast<std::size_t>(detail::unserialize_val<CastCnt>(src));
+    if (cnt > MaxCnt) {
+      detail::fail_decode(src, decode_error::count_too_large);
+      return;
+    }
+    for (std::size_t left {cnt}; left != 0u && src.ok(); ) {
+      detail::validate_fmt<ElemFmt>(src);
+      auto run = static_cast<std::size_t>(detail::unserialize_var_int<CastCnt>(src));
+      if (src.ok() && (run == 0u || run > left)) {
+        detail::fail_decode(src, decode_error::invalid_value);
+      }
+      left -= std::min(run, left);
+    }
+  }
+};
+
+} // end namespace
+
+#endif
+
@@ -0,0 +1,456 @@
+/** @file
+ *
+ * @brief A string interning table, a format directive that decodes strings into
+ * the table instead of allocating a @c std::string for each one, and a dictionary
+ * encoding for sequences of repeated strings.
+ *
+ * Messages often contain a small set of repeating strings (symbols, host names, keys).
+ * When decoding with @c interned_fmt, the serialized bytes are hashed in place and
+ * looked up in a @c string_table; only a string not already in the table is copied (into
+ * the table arena). The decoded value is either a @c std::string_view into the table,
+ * which is stable for the lifetime of the table, or a small integer id.
+ *
+ * @note A @c string_table grows with every distinct string, so a table used for
+ * untrusted input should be cleared (or checked with @c size) periodically.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef STRING_TABLE_HPP_INCLUDED
+#define STRING_TABLE_HPP_INCLUDED
+
+#include "serialize/binary_serialize.hpp"
+
+#include <cstddef> // std::byte, std::size_t
+#include <cstdint> // std::uint32_t
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <optional>
+#include <memory_resource>
+#include <algorithm> // std::copy_n
+#include <concepts>
+#include <ranges>
+#include <cassert>
+
+namespace chops {
+
+/**
+ * @brief A table of distinct strings, each identified by a small integer id.
+ *
+ * The characters of each string are copied once into an arena owned by the table, so
+ * the @c std::string_views returned by the table remain valid until the table is cleared
+ * or destroyed. Ids are assigned in insertion order, starting at zero.
+ *
+ */
+class string_table {
+public:
+  using id_type = std::uint32_t;
+
+private:
+  std::pmr::monotonic_buffer_resource           m_arena;
+  std::unordered_map<std::string_view, id_type> m_index;
+  std::vector<std::string_view>                 m_views;
+
+public:
+
+  string_table() = default;
+/**
+ * @brief Construct a table that allocates its arena from an upstream memory resource.
+ */
+  explicit string_table(std::pmr::memory_resource* upstream) : m_arena(upstream) { }
+
+  string_table(const string_table&) = delete;
+  string_table& operator=(const string_table&) = delete;
+
+/**
+ * @brief Return the id of a string, adding the string to the table if not present.
+ *
+ * The string is hashed in place, and only copied into the table if not already present.
+ */
+  id_type intern(std::string_view str) {
+    if (auto it = m_index.find(str); it != m_index.end()) {
+      return it->second;
+    }
+    std::string_view stored { };
+    if (!str.empty()) {
+      char* ptr = static_cast<char*>(m_arena.allocate(str.size(), alignof(char)));
+      std::copy_n(str.data(), str.size(), ptr);
+      stored = std::string_view(ptr, str.size());
+    }
+    auto id = static_cast<id_type>(m_views.size());
+    m_views.push_back(stored);
+    m_index.emplace(stored, id);
+    return id;
+  }
+
+/**
+ * @brief Return the id of a string if it is in the table, without adding it.
+ */
+  std::optional<id_type> find(std::string_view str) const {
+    if (auto it = m_index.find(str); it != m_index.end()) {
+      return { it->second };
+    }
+    return { };
+  }
+
+/**
+ * @brief Return the string for an id.
+ *
+ * @pre The id must have been returned by @c intern.
+ */
+  std::string_view view(id_type id) const noexcept {
+    assert(id < m_views.size());
+    return m_views[id];
+  }
+
+/**
+ * @brief Return the number of distinct strings in the table.
+ */
+  std::size_t size() const noexcept { return m_views.size(); }
+
+/**
+ * @brief Remove all strings and release the arena, invalidating all views and ids.
+ */
+  void clear() noexcept {
+    m_index.clear();
+    m_views.clear();
+    m_arena.release();
+  }
+};
+
+/**
+ * @brief Concept for an extract buffer that supplies a @c string_table for decoding
+ * @c interned_fmt strings.
+ */
+template <typename Src>
+concept has_string_table =
+  supports_endian_extract_buffer<Src> &&
+  requires (const Src src) {
+    { src.strings() } -> std::same_as<string_table&>;
+  };
+
+/**
+ * @brief An extract buffer (e.g. @c extract_buffer or @c read_cursor) combined with a
+ * @c string_table, used when decoding @c interned_fmt strings.
+ *
+ * The buffer can be combined with a @c resource_buffer by nesting, e.g.
+ * @c interning_buffer<resource_buffer<read_cursor<>>>.
+ *
+ */
+template <supports_endian_extract_buffer Src>
+class interning_buffer : public Src {
+private:
+  string_table* m_table;
+public:
+  interning_buffer(const Src& src, string_table& table) noexcept : Src(src), m_table(&table) { }
+
+/**
+ * @brief Return the table that decoded strings are interned into.
+ */
+  string_table& strings() const noexcept { return *m_table; }
+};
+
+/**
+ * @brief Format directive for an interned string, serialized the same as
+ * @c seq_fmt<CastCnt, char> (a count followed by the characters).
+ *
+ * A string is marshalled from anything convertible to @c std::string_view. It is
+ * unmarshalled (through an @c interning_buffer) into either a @c std::string_view that
+ * refers to the table, or a @c string_table::id_type.
+ *
+ * @tparam CastCnt Unsigned integer type of the character count.
+ *
+ */
+template <std::unsigned_integral CastCnt>
+struct interned_fmt { };
+
+template <typename CastCnt>
+struct format_traits<interned_fmt<CastCnt>> {
+  using seq_traits = format_traits<seq_fmt<CastCnt, char>>;
+
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size = seq_traits::max_size;
+
+  template <typename T>
+    requires std::convertible_to<const T&, std::string_view>
+  static constexpr std::size_t encoded_size(const T& val) {
+    return seq_traits::encoded_size(std::string_view(val));
+  }
+
+  template <supports_endian_expandable_buffer Buf, typename T>
+    requires std::convertible_to<const T&, std::string_view>
+  static constexpr Buf& marshall(Buf& buf, const T& val) {
+    return seq_traits::marshall(buf, std::string_view(val));
+  }
+
+  // the characters are looked up where they are in the buffer, only new strings are copied
+  template <has_string_table Src>
+  static std::optional<string_table::id_type> intern(Src& src) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    if (!detail::has_bytes(src, cnt)) {
+      return { };
+    }
+    auto id = src.strings().intern(std::string_view(reinterpret_cast<const char*>(src.data()), cnt));
+    src.advance(cnt);
+    return { id };
+  }
+
+  template <has_string_table Src>
+  static Src& unmarshall(Src& src, string_table::id_type& val) {
+    if (auto id = intern(src); id) {
+      val = *id;
+    }
+    return src;
+  }
+
+  template <has_string_table Src>
+  static Src& unmarshall(Src& src, std::string_view& val) {
+    if (auto id = intern(src); id) {
+      val = src.strings().view(*id);
+    }
+    return src;
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    seq_traits::validate(src);
+  }
+};
+
+/**
+ * @brief Format directive for a sequence of strings with heavy repetition, serialized as
+ * a dictionary of the distinct strings followed by an index into the dictionary for each
+ * element.
+ *
+ * The serialized form is the number of distinct strings (@c CastCnt), each distinct
+ * string in order of first appearance (a @c CastLen count followed by the characters),
+ * the number of elements (@c CastCnt), then each element as a variable length integer
+ * index (7 bits per byte, the same encoding as @c append_var_int).
+ *
+ * Elements are marshalled from anything convertible to @c std::string_view. When
+ * unmarshalling, each distinct string is looked up once: into @c std::string (or similar)
+ * elements by assignment, reusing the existing element capacity, or (through an
+ * @c interning_buffer) into @c std::string_view elements referring to the table, or into
+ * @c string_table::id_type elements.
+ *
+ * @tparam CastCnt Unsigned integer type of the dictionary and element counts.
+ *
+ * @tparam CastLen Unsigned integer type of the character count of each distinct string.
+ *
+ * A count or string length that does not fit its type throws @c std::length_error when
+ * serializing.
+ *
+ */
+template <std::unsigned_integral CastCnt, std::unsigned_integral CastLen = std::uint16_t>
+struct dict_seq_fmt { };
+
+namespace detail {
+
+template <typename T>
+concept string_like = std::convertible_to<const T&, std::string_view>;
+
+} // end detail namespace
+
+template <typename CastCnt, typename CastLen>
+struct format_traits<dict_seq_fmt<CastCnt, CastLen>> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size = unbounded_size;
+
+  struct dictionary {
+    std::vector<std::string_view> strs;
+    std::vector<std::uint32_t>    indices;
+    std::size_t                   size;
+  };
+
+  // distinct strings in order of first appearance, and the index of each element
+  template <std::ranges::sized_range Ctr>
+  static dictionary build(const Ctr& ctr) {
+    dictionary dict { { }, { }, 2u * sizeof(CastCnt) };
+    std::unordered_map<std::string_view, std::uint32_t> lookup;
+    dict.indices.reserve(std::ranges::size(ctr));
+    for (const auto& elem : ctr) {
+      std::string_view str(elem);
+      auto [it, inserted] = lookup.try_emplace(str, static_cast<std::uint32_t>(dict.strs.size()));
+      if (inserted) {
+        detail::check_count<CastLen>(str.size());
+        dict.strs.push_back(str);
+        dict.size += sizeof(CastLen) + str.size();
+      }
+      dict.indices.push_back(it->second);
+      dict.size += detail::var_int_size(it->second);
+    }
+    detail::check_count<CastCnt>(dict.indices.size()); // at least as many as distinct strings
+    return dict;
+  }
+
+  template <std::ranges::sized_range Ctr>
+    requires detail::string_like<std::ranges::range_value_t<Ctr>>
+  static std::size_t encoded_size(const Ctr& ctr) {
+    return build(ctr).size;
+  }
+
+  template <supports_endian_expandable_buffer Buf, std::ranges::sized_range Ctr>
+    requires detail::string_like<std::ranges::range_value_t<Ctr>>
+  static Buf& marshall(Buf& buf, const Ctr& ctr) {
+    auto dict = build(ctr);
+    constexpr auto endian = Buf::endian_type::value;
+    // single resize for the dictionary and the indices
+    auto old_sz = buf.size();
+    buf.resize(old_sz + dict.size);
+    std::byte* ptr = buf.data() + old_sz;
+    ptr += append_val<endian>(ptr, static_cast<CastCnt>(dict.strs.size()));
+    for (auto str : dict.strs) {
+      ptr += append_val<endian>(ptr, static_cast<CastLen>(str.size()));
+      ptr = std::copy_n(reinterpret_cast<const std::byte*>(str.data()), str.size(), ptr);
+    }
+    ptr += append_val<endian>(ptr, static_cast<CastCnt>(dict.indices.size()));
+    for (auto idx : dict.indices) {
+      ptr += append_var_int(ptr, idx);
+    }
+    return buf;
+  }
+
+  struct extracted_dictionary {
+    std::vector<std::string>      owned; // copies, if the buffer bytes do not stay in place
+    std::vector<std::string_view> strs;
+  };
+
+  // the dictionary strings are viewed in place in the buffer, or copied if a later read
+  // may move the bytes (e.g. a block boundary of a decompressing_cursor)
+  template <supports_endian_extract_buffer Src>
+  static extracted_dictionary extract_dictionary(Src& src) {
+    auto dict_cnt = detail::unserialize_val<CastCnt>(src);
+    extracted_dictionary dict;
+    auto res = detail::reserve_count(src, dict_cnt);
+    if constexpr (has_stable_data<Src>) {
+      dict.strs.reserve(res);
+    }
+    else {
+      dict.owned.reserve(res);
+    }
+    for (CastCnt i {0u}; i < dict_cnt && detail::decode_ok(src); ++i) {
+      auto len = detail::unserialize_val<CastLen>(src);
+      if (!detail::has_bytes(src, len)) {
+        break;
+      }
+      if constexpr (has_stable_data<Src>) {
+        dict.strs.emplace_back(reinterpret_cast<const char*>(src.data()), len);
+      }
+      else {
+        dict.owned.emplace_back(reinterpret_cast<const char*>(src.data()), len);
+      }
+      src.advance(len);
+    }
+    if constexpr (!has_stable_data<Src>) {
+      dict.strs.assign(dict.owned.begin(), dict.owned.end());
+    }
+    return dict;
+  }
+
+  // each element is at least one byte, so an untrusted count is checked before resizing
+  template <supports_endian_extract_buffer Src, typename Ctr, typename Dict, typename Assign>
+  static Src& extract_elements(Src& src, Ctr& ctr, const Dict& dict, Assign assign) {
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    if (!detail::decode_ok(src) || !detail::has_bytes(src, cnt)) {
+      ctr.clear();
+      return src;
+    }
+    auto elem_idx = [&src, &dict] () -> std::optional<std::uint32_t> {
+      auto idx = detail::unserialize_var_int<std::uint32_t>(src);
+      if (detail::decode_ok(src) && idx < dict.size()) {
+        return { idx };
+      }
+      detail::fail_decode(src, decode_error::invalid_value);
+      return { };
+    };
+    if constexpr (detail::resizable_sequence<Ctr>) {
+      ctr.resize(cnt);
+      for (auto& elem : ctr) {
+        auto idx = elem_idx();
+        if (!idx) {
+          break;
+        }
+        assign(elem, dict[*idx]);
+      }
+    }
+    else {
+      ctr.clear();
+      for (CastCnt i {0u}; i < cnt; ++i) {
+        auto idx = elem_idx();
+        if (!idx) {
+          break;
+        }
+        auto elem = detail::make_elem<typename Ctr::value_type>(src, ctr);
+        assign(elem, dict[*idx]);
+        ctr.insert(ctr.end(), std::move(elem));
+      }
+    }
+    return src;
+  }
+
+  template <supports_endian_extract_buffer Src, typename Ctr>
+    requires requires (Ctr ctr, typename Ctr::value_type elem, std::string_view str) {
+      ctr.clear();
+      elem.assign(str.data(), str.size());
+    }
+  static Src& unmarshall(Src& src, Ctr& ctr) {
+    auto dict = extract_dictionary(src);
+    return extract_elements(src, ctr, dict.strs, [] (auto& elem, std::string_view str) {
+      elem.assign(str.data(), str.size());
+    });
+  }
+
+  template <has_string_table Src, typename Ctr>
+    requires requires (Ctr ctr) { ctr.clear(); } &&
+             (std::same_as<typename Ctr::value_type, std::string_view> ||
+              std::same_as<typename Ctr::value_type, string_table::id_type>)
+  static Src& unmarshall(Src& src, Ctr& ctr) {
+    auto dict = extract_dictionary(src);
+    std::vector<string_table::id_type> ids;
+    ids.reserve(dict.strs.size());
+    for (auto str : dict.strs) {
+      ids.push_back(src.strings().intern(str));
+    }
+    return extract_elements(src, ctr, ids, [&src] (auto& elem, string_table::id_type id) {
+      if constexpr (std::same_as<std::remove_cvref_t<decltype(elem)>, std::string_view>) {
+        elem = src.strings().view(id);
+      }
+      else {
+        elem = id;
+      }
+    });
+  }
+
+  template <checked_extract_buffer Src>
+  static constexpr void validate(Src& src) {
+    auto dict_cnt = detail::unserialize_val<CastCnt>(src);
+    for (CastCnt i {0u}; i < dict_cnt && src.ok(); ++i) {
+      auto len = detail::unserialize_val<CastLen>(src);
+      if (detail::has_bytes(src, len)) {
+        src.advance(len);
+      }
+    }
+    auto cnt = detail::unserialize_val<CastCnt>(src);
+    if (!src.ok() || !detail::has_bytes(src, cnt)) {
+      return;
+    }
+    for (CastCnt i {0u}; i < cnt && src.ok(); ++i) {
+      if (detail::unserialize_var_int<std::uint32_t>(src) >= dict_cnt && src.ok()) {
+        detail::fail_decode(src, decode_error::invalid_value);
+      }
+    }
+  }
+};
+
+} // end namespace
+
+#endif
+
@@ -0,0 +1,64 @@
+/** @file
+ *
+ * @brief Test scenarios for @c aggregate_field_count and @c tie_fields.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <optional>
+#include <tuple>
+
+#include "serialize/aggregate_fields.hpp"
+
+struct empty { };
+
+struct simple {
+  int    a;
+  short  b;
+  char   c;
+};
+
+struct mixed {
+  std::string         name;
+  std::optional<int>  opt;
+  simple              nested;
+  std::vector<int>    vec;
+  std::array<int, 4>  arr;
+};
+
+TEST_CASE ( "Aggregate field count", "[aggregate_field_count]" ) {
+  STATIC_REQUIRE (chops::aggregate_field_count<empty> == 0u);
+  STATIC_REQUIRE (chops::aggregate_field_count<simple> == 3u);
+  STATIC_REQUIRE (chops::aggregate_field_count<mixed> == 5u);
+  STATIC_REQUIRE (!chops::field_enumerable<std::string>);
+}
+
+TEST_CASE ( "Tie fields of an aggregate", "[tie_fields]" ) {
+  simple s { 1, 2, 'c' };
+  auto flds = chops::tie_fields(s);
+  REQUIRE (std::get<0>(flds) == 1);
+  REQUIRE (std::get<1>(flds) == 2);
+  REQUIRE (std::get<2>(flds) == 'c');
+  std::get<0>(flds) = 42;
+  REQUIRE (s.a == 42);
+
+  const mixed m { "name", 5, { 3, 4, 'd' }, { 1, 2 }, { 5, 6, 7, 8 } };
+  auto cflds = chops::tie_fields(m);
+  STATIC_REQUIRE (std::is_same_v<decltype(cflds), std::tuple<const std::string&, const std::optional<int>&,
+                                 const simple&, const std::vector<int>&, const std::array<int, 4>&>>);
+  REQUIRE (std::get<0>(cflds) == "name");
+  REQUIRE (std::get<2>(cflds).c == 'd');
+  REQUIRE (std::get<4>(cflds)[3] == 8);
+}
+
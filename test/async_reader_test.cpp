@@ -0,0 +1,350 @@
+/** @file
+ *
+ * @brief Test scenarios for @c async_reader and @c async_task.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <span>
+#include <optional>
+#include <coroutine>
+#include <stdexcept>
+#include <algorithm> // std::min, std::copy_n
+#include <bit> // std::endian
+
+#include "serialize/async_reader.hpp"
+#include "serialize/binary_serialize.hpp"
+
+struct msg {
+  std::uint32_t id;
+  std::string   text;
+  bool operator==(const msg&) const = default;
+};
+
+using msg_fmt = chops::fields_fmt<std::uint32_t, chops::seq_fmt<std::uint16_t, char>>;
+
+using byte_buf = chops::expandable_buffer<std::vector<std::byte>, std::endian::big>;
+
+std::vector<msg> make_msgs(std::uint32_t num) {
+  std::vector<msg> msgs;
+  for (std::uint32_t i {0u}; i < num; ++i) {
+    msgs.push_back(msg { i, std::string((i * 7u) % 300u, static_cast<char>('a' + i % 26u)) });
+  }
+  return msgs;
+}
+
+// in-memory source, returning at most step bytes per read, without suspending
+struct memory_source {
+  std::span<const std::byte> m_bytes;
+  std::size_t                m_step;
+  int                        m_reads = 0;
+
+  struct awaiter {
+    memory_source&       m_src;
+    std::span<std::byte> m_space;
+    bool await_ready() const noexcept { return true; }
+    void await_suspend(std::coroutine_handle<>) const noexcept { }
+    std::size_t await_resume() {
+      auto n = std::min({ m_src.m_step, m_space.size(), m_src.m_bytes.size() });
+      std::copy_n(m_src.m_bytes.data(), n, m_space.data());
+      m_src.m_bytes = m_src.m_bytes.subspan(n);
+      ++m_src.m_reads;
+      return n;
+    }
+  };
+  awaiter read_some(std::span<std::byte> space) { return { *this, space }; }
+};
+
+// source where bytes are delivered by the test, as from an event loop, suspending the
+// reader while no bytes are available
+struct push_source {
+  std::vector<std::byte>  m_pending;
+  bool                    m_closed = false;
+  std::coroutine_handle<> m_waiting;
+
+  struct awaiter {
+    push_source&         m_src;
+    std::span<std::byte> m_space;
+    bool await_ready() const noexcept { return !m_src.m_pending.empty() || m_src.m_closed; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { m_src.m_waiting = h; }
+    std::size_t await_resume() {
+      auto n = std::min(m_space.size(), m_src.m_pending.size());
+      std::copy_n(m_src.m_pending.data(), n, m_space.data());
+      m_src.m_pending.erase(m_src.m_pending.begin(), m_src.m_pending.begin() + static_cast<std::ptrdiff_t>(n));
+      return n;
+    }
+  };
+  awaiter read_some(std::span<std::byte> space) { return { *this, space }; }
+
+  void resume() {
+    if (auto h = std::exchange(m_waiting, { })) {
+      h.resume();
+    }
+  }
+  void deliver(std::span<const std::byte> bytes) {
+    m_pending.insert(m_pending.end(), bytes.begin(), bytes.end());
+    resume();
+  }
+  void close() {
+    m_closed = true;
+    resume();
+  }
+};
+
+// source whose read_some is itself a coroutine
+struct task_source {
+  memory_source m_mem;
+  chops::async_task<std::size_t> read_some(std::span<std::byte> space) {
+    auto n = co_await m_mem.read_some(space);
+    co_return n;
+  }
+};
+
+template <typename Src>
+chops::async_task<chops::decode_error> read_all(chops::async_reader<Src, std::endian::big>& rdr,
+                                                std::vector<msg>& out) {
+  for (;;) {
+    bool end = co_await rdr.at_end();
+    if (end) {
+      co_return chops::decode_error::none;
+    }
+    msg m { };
+    auto err = co_await rdr.template read<msg_fmt>(m);
+    if (err != chops::decode_error::none) {
+      co_return err;
+    }
+    out.push_back(m);
+  }
+}
+
+template <typename Src>
+chops::async_task<chops::decode_error> read_all_framed(chops::async_reader<Src, std::endian::big>& rdr,
+                                                       std::vector<msg>& out) {
+  for (;;) {
+    bool end = co_await rdr.at_end();
+    if (end) {
+      co_return chops::decode_error::none;
+    }
+    msg m { };
+    auto err = co_await rdr.template read_framed<std::uint16_t, msg_fmt>(m);
+    if (err != chops::decode_error::none) {
+      co_return err;
+    }
+    out.push_back(m);
+  }
+}
+
+chops::async_task<int> fails() {
+  throw std::runtime_error("fails");
+  co_return 0;
+}
+
+chops::async_task<int> add_one() {
+  int val = co_await fails();
+  co_return val + 1;
+}
+
+TEST_CASE ( "Async reader, values arriving in small reads", "[async_reader]" ) {
+  auto msgs = make_msgs(200u);
+  byte_buf buf;
+  for (const auto& m : msgs) {
+    chops::marshall<msg_fmt>(buf, m);
+  }
+  std::span<const std::byte> bytes(buf.data(), buf.size());
+
+  for (std::size_t step : { std::size_t{1u}, std::size_t{3u}, std::size_t{64u}, std::size_t{100000u} }) {
+    memory_source src { bytes, step };
+    chops::async_reader<memory_source, std::endian::big> rdr(src, 32u);
+    std::vector<msg> out;
+    auto task = read_all(rdr, out);
+    task.start();
+    REQUIRE (task.done());
+    REQUIRE (task.result() == chops::decode_error::none);
+    REQUIRE (out == msgs);
+    REQUIRE (rdr.buffered().empty());
+  }
+
+  SECTION ("Fixed size values") {
+    byte_buf fbuf;
+    for (std::uint64_t i {0u}; i < 50u; ++i) {
+      chops::marshall<std::uint64_t>(fbuf, i * 1000003u);
+    }
+    memory_source src { std::span<const std::byte>(fbuf.data(), fbuf.size()), 5u };
+    chops::async_reader<memory_source, std::endian::big> rdr(src, 16u);
+    auto task = [] (auto& r) -> chops::async_task<std::uint64_t> {
+      std::uint64_t sum {0u};
+      for (std::uint64_t val {0u}; co_await r.template read<std::uint64_t>(val) == chops::decode_error::none; ) {
+        sum += val;
+      }
+      co_return sum;
+    } (rdr);
+    task.start();
+    REQUIRE (task.done());
+    REQUIRE (task.result() == 1225u * 1000003u);
+  }
+
+  SECTION ("Source that is a coroutine") {
+    task_source src { memory_source { bytes, 7u } };
+    chops::async_reader<task_source, std::endian::big> rdr(src, 128u);
+    std::vector<msg> out;
+    auto task = read_all(rdr, out);
+    task.start();
+    REQUIRE (task.done());
+    REQUIRE (task.result() == chops::decode_error::none);
+    REQUIRE (out == msgs);
+  }
+}
+
+TEST_CASE ( "Async reader, buffered values decoded without waiting", "[async_reader]" ) {
+  const msg m1 { 7u, "buffered" };
+  byte_buf buf;
+  chops::marshall<std::uint64_t>(buf, 42u);
+  chops::marshall<msg_fmt>(buf, m1);
+  chops::marshall_framed<std::uint16_t, msg_fmt>(buf, m1);
+  memory_source src { std::span<const std::byte>(buf.data(), buf.size()), 100000u };
+  chops::async_reader<memory_source, std::endian::big> rdr(src);
+
+  // nothing buffered, so awaiting has to read from the source
+  std::uint64_t val {0u};
+  REQUIRE_FALSE (rdr.read<std::uint64_t>(val).await_ready());
+  REQUIRE_FALSE (rdr.at_end().await_ready());
+  REQUIRE (src.m_reads == 0);
+  auto filled = [] (auto& r) -> chops::async_task<bool> { co_return co_await r.fill(1u); } (rdr);
+  filled.start();
+  REQUIRE (filled.result());
+  REQUIRE (src.m_reads == 1);
+
+  // everything is buffered, each read completes in await_ready, before a coroutine is created
+  auto rd_val = rdr.read<std::uint64_t>(val);
+  REQUIRE (rd_val.await_ready());
+  REQUIRE (rd_val.await_resume() == chops::decode_error::none);
+  REQUIRE (val == 42u);
+  msg out { };
+  auto rd_msg = rdr.read<msg_fmt>(out);
+  REQUIRE (rd_msg.await_ready());
+  REQUIRE (rd_msg.await_resume() == chops::decode_error::none);
+  REQUIRE (out == m1);
+  out = msg { };
+  auto rd_frame = rdr.read_framed<std::uint16_t, msg_fmt>(out);
+  REQUIRE (rd_frame.await_ready());
+  REQUIRE (rd_frame.await_resume() == chops::decode_error::none);
+  REQUIRE (out == m1);
+  REQUIRE (src.m_reads == 1);
+  REQUIRE (rdr.buffered().empty());
+
+  REQUIRE (rdr.try_read<std::uint64_t>(val) == chops::decode_error::truncated);
+  REQUIRE (rdr.try_read_framed<std::uint16_t, msg_fmt>(out) == chops::decode_error::truncated);
+}
+
+TEST_CASE ( "Async reader, framed values from a suspending source", "[async_reader]" ) {
+  auto msgs = make_msgs(100u);
+  byte_buf buf;
+  for (const auto& m : msgs) {
+    chops::marshall_framed<std::uint16_t, msg_fmt>(buf, m);
+  }
+  std::span<const std::byte> bytes(buf.data(), buf.size());
+
+  push_source src;
+  chops::async_reader<push_source, std::endian::big> rdr(src, 64u);
+  std::vector<msg> out;
+  auto task = read_all_framed(rdr, out);
+  task.start();
+  REQUIRE_FALSE (task.done());
+
+  std::size_t sent {0u};
+  while (sent < bytes.size()) {
+    auto n = std::min(std::size_t{11u}, bytes.size() - sent);
+    src.deliver(bytes.subspan(sent, n));
+    sent += n;
+    REQUIRE_FALSE (task.done());
+  }
+  REQUIRE (out == msgs);
+  src.close();
+  REQUIRE (task.done());
+  REQUIRE (task.result() == chops::decode_error::none);
+}
+
+TEST_CASE ( "Async reader, errors", "[async_reader]" ) {
+  byte_buf buf;
+  chops::marshall<msg_fmt>(buf, msg { 1u, "complete" });
+  chops::marshall<msg_fmt>(buf, msg { 2u, "incomplete" });
+  std::span<const std::byte> bytes(buf.data(), buf.size());
+
+  SECTION ("Source ends within a value") {
+    memory_source src { bytes.first(bytes.size() - 3u), 4u };
+    chops::async_reader<memory_source, std::endian::big> rdr(src);
+    std::vector<msg> out;
+    auto task = read_all(rdr, out);
+    task.start();
+    REQUIRE (task.done());
+    REQUIRE (task.result() == chops::decode_error::truncated);
+    REQUIRE (out.size() == 1u);
+    REQUIRE (rdr.buffered().size() == bytes.size() - 3u - 14u); // nothing of the value consumed
+  }
+
+  SECTION ("Value larger than the maximum") {
+    memory_source src { bytes, 4u };
+    chops::async_reader<memory_source, std::endian::big> rdr(src, 4u, 15u);
+    std::vector<msg> out;
+    auto task = read_all(rdr, out);
+    task.start();
+    REQUIRE (task.result() == chops::decode_error::invalid_value);
+    REQUIRE (out.size() == 1u);
+  }
+
+  SECTION ("Invalid values and frames") {
+    using opt_fmt = chops::opt_fmt<std::uint8_t, std::uint32_t>;
+    byte_buf bad;
+    chops::marshall<std::uint8_t>(bad, 2u); // optional flag other than 0 or 1
+    chops::marshall<std::uint32_t>(bad, 5u);
+    memory_source src { std::span<const std::byte>(bad.data(), bad.size()), 1u };
+    chops::async_reader<memory_source, std::endian::big> rdr(src);
+    auto task = [] (auto& r) -> chops::async_task<chops::decode_error> {
+      std::optional<std::uint32_t> val;
+      co_return co_await r.template read<opt_fmt>(val);
+    } (rdr);
+    task.start();
+    REQUIRE (task.result() == chops::decode_error::invalid_value);
+    REQUIRE (rdr.buffered().size() == 1u);
+
+    byte_buf frames;
+    chops::marshall<std::uint16_t>(frames, 6u); // frame with bytes after the value
+    chops::marshall<std::uint32_t>(frames, 1u);
+    chops::marshall<std::uint16_t>(frames, 0u);
+    chops::marshall<std::uint16_t>(frames, 60000u); // frame longer than the maximum
+    memory_source fsrc { std::span<const std::byte>(frames.data(), frames.size()), 3u };
+    chops::async_reader<memory_source, std::endian::big> frdr(fsrc, 8u, 1024u);
+    auto ftask = [] (auto& r) -> chops::async_task<bool> {
+      std::uint32_t val {0u};
+      auto err = co_await r.template read_framed<std::uint16_t, std::uint32_t>(val);
+      if (err != chops::decode_error::trailing_bytes) {
+        co_return false;
+      }
+      r.consume(8u);
+      err = co_await r.template read_framed<std::uint16_t, std::uint32_t>(val);
+      co_return err == chops::decode_error::invalid_value;
+    } (frdr);
+    ftask.start();
+    REQUIRE (ftask.result());
+  }
+
+  SECTION ("Exceptions propagate through awaiting tasks") {
+    auto outer = add_one();
+    outer.start();
+    REQUIRE (outer.done());
+    REQUIRE_THROWS (outer.result());
+  }
+}
+
@@ -0,0 +1,143 @@
+/** @file
+ *
+ * @brief Test scenarios for @c batch_writer.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <span>
+#include <chrono>
+#include <stdexcept>
+#include <bit> // std::endian
+
+#include "serialize/batch_writer.hpp"
+#include "serialize/binary_serialize.hpp"
+
+// manually advanced clock
+struct test_clock {
+  using duration = std::chrono::nanoseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<test_clock>;
+  static constexpr bool is_steady = true;
+  static inline time_point current { };
+  static time_point now() noexcept { return current; }
+};
+
+struct batch {
+  std::vector<std::byte>              bytes;
+  std::vector<std::vector<std::byte>> msgs;
+};
+
+using text_fmt = chops::seq_fmt<std::uint16_t, char>;
+
+// format that throws partway through marshalling a "boom" message
+struct throwing_fmt { };
+
+template <>
+struct chops::format_traits<throwing_fmt> {
+  static constexpr bool is_fixed_size = false;
+  static constexpr std::size_t max_size = chops::unbounded_size;
+
+  static std::size_t encoded_size(const std::string& str) { return chops::encoded_size<text_fmt>(str); }
+  template <chops::supports_endian_expandable_buffer Buf>
+  static Buf& marshall(Buf& buf, const std::string& str) {
+    chops::marshall<text_fmt>(buf, str);
+    if (str == "boom") {
+      throw std::runtime_error("boom");
+    }
+    return buf;
+  }
+};
+
+TEST_CASE ( "Batching writer", "[batch_writer]" ) {
+  using namespace std::chrono_literals;
+
+  std::vector<batch> batches;
+  auto sink = [&batches] (std::span<const std::byte> bytes, std::span<const std::span<const std::byte>> msgs) {
+    batch b { std::vector<std::byte>(bytes.begin(), bytes.end()), { } };
+    for (auto m : msgs) {
+      b.msgs.emplace_back(m.begin(), m.end());
+    }
+    batches.push_back(b);
+  };
+  chops::batch_writer<decltype(sink), std::uint16_t, std::endian::big, test_clock> writer(sink, { 100u, 4u, 5ms });
+
+  // count threshold
+  for (int i {0}; i < 4; ++i) {
+    REQUIRE (writer.append<text_fmt>(std::string(static_cast<std::size_t>(i), 'c')) == static_cast<std::size_t>(i));
+  }
+  REQUIRE (batches.size() == 1u);
+  REQUIRE (writer.count() == 0u);
+  REQUIRE (batches[0].msgs.size() == 4u);
+  REQUIRE (batches[0].bytes.size() == 4u * 4u + 0u + 1u + 2u + 3u);
+  REQUIRE (batches[0].msgs[3].size() == 2u + 3u);
+  std::vector<std::span<const std::byte>> frames;
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(batches[0].bytes, frames) == chops::decode_error::none);
+  REQUIRE (frames.size() == 4u);
+  REQUIRE (std::vector<std::byte>(frames[2].begin(), frames[2].end()) == batches[0].msgs[2]);
+
+  // byte threshold
+  writer.append<text_fmt>(std::string(60u, 'b'));
+  REQUIRE (batches.size() == 1u);
+  writer.append<text_fmt>(std::string(40u, 'b'));
+  REQUIRE (batches.size() == 2u);
+  REQUIRE (batches[1].msgs.size() == 2u);
+
+  // age threshold, checked on append and by poll
+  writer.append<text_fmt>(std::string("x"));
+  test_clock::current += 3ms;
+  REQUIRE (!writer.poll());
+  writer.append<text_fmt>(std::string("y"));
+  REQUIRE (batches.size() == 2u);
+  test_clock::current += 2ms;
+  REQUIRE (writer.append<text_fmt>(std::string("z")) == 2u);
+  REQUIRE (batches.size() == 3u);
+  REQUIRE (batches[2].msgs.size() == 3u);
+
+  writer.append<text_fmt>(std::string("w"));
+  test_clock::current += 4ms;
+  REQUIRE (!writer.poll());
+  test_clock::current += 1ms;
+  REQUIRE (writer.poll());
+  REQUIRE (batches.size() == 4u);
+  REQUIRE (!writer.poll());
+
+  // explicit flush
+  writer.append<text_fmt>(std::string("v"));
+  REQUIRE (writer.size() == 5u);
+  writer.flush();
+  writer.flush();
+  REQUIRE (batches.size() == 5u);
+  REQUIRE (batches[4].bytes.size() == 5u);
+
+  // a throwing message leaves no partial frame in the batch
+  REQUIRE_THROWS (writer.append<throwing_fmt>(std::string("boom")));
+  REQUIRE (writer.count() == 0u);
+  REQUIRE (writer.size() == 0u);
+  REQUIRE (writer.append<throwing_fmt>(std::string("ok")) == 0u);
+  REQUIRE_THROWS (writer.append<throwing_fmt>(std::string("boom")));
+  REQUIRE (writer.append<text_fmt>(std::string("after")) == 1u);
+  REQUIRE (writer.count() == 2u);
+  writer.flush();
+  REQUIRE (batches.size() == 6u);
+  REQUIRE (batches[5].msgs.size() == 2u);
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(batches[5].bytes, frames) == chops::decode_error::none);
+  REQUIRE (frames.size() == 2u);
+  std::string text;
+  chops::read_cursor<std::endian::big> cur(frames[1]);
+  REQUIRE (chops::try_unmarshall<text_fmt>(cur, text) == chops::decode_error::none);
+  REQUIRE (text == "after");
+}
@@ -7,44 +7,55 @@
  *
  * @copyright (c) 2019-2024 by Cliff Green
  *
- * Distributed under the Boost Software License, Version 1.0. 
+ * Distributed under the Boost Software License, Version 1.0.
  * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
  *
  */
 
 #include "catch2/catch_test_macros.hpp"
+#include "catch2/catch_template_test_macros.hpp"
 
 #include <cstddef> // std::byte
 #include <cstdint> // std::uint32_t, etc
 #include <list>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <set>
 #include <array>
 #include <optional>
+#include <variant>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility> // std::pair
+#include <bit> // std::endian
+#include <algorithm> // std::equal
+#include <chrono>
+#include <ratio>
+#include <memory_resource>
+#include <stdexcept> // std::length_error
 
-/* 
-#include "marshall/marshall.hpp"
-#include "marshall/shared_buffer.hpp"
+#include "serialize/binary_serialize.hpp"
+
+#include "buffer/shared_buffer.hpp"
 
 struct loc {
   int    latitude;
   int    longitude;
   short  altitude;
+
+  bool operator==(const loc&) const = default;
 };
 
 namespace hiking {
 
-template <typename Buf>
-Buf& marshall(Buf& buf, const loc& loc) {
-  chops::marshall<std::int32_t>(buf, loc.latitude);
-  chops::marshall<std::int32_t>(buf, loc.longitude);
-  chops::marshall<std::int16_t>(buf, loc.altitude);
-  return buf;
-}
-
 struct trail_stats {
   long                length;
   short               elev;
   std::optional<int>  rating;
+
+  bool operator==(const trail_stats&) const = default;
 };
 
 struct hiking_trail {
@@ -53,27 +64,47 @@ struct hiking_trail {
   loc             trail_head;
   std::list<loc>  intersections;
   trail_stats     stats;
+
+  bool operator==(const hiking_trail&) const = default;
 };
 
-template <typename Buf>
-Buf& marshall(Buf& buf, const trail_stats& ts) {
-  chops::marshall<std::uint64_t>(buf, ts.length);
-  chops::marshall<std::uint16_t>(buf, ts.elev);
-  chops::marshall<std::uint8_t, std::uint16_t>(buf, ts.rating);
-  return buf;
-}
+} // end namespace hiking
 
-template <typename Buf>
-Buf& marshall(Buf& buf, const hiking_trail& ht) {
-  chops::marshall<std::uint16_t>(buf, ht.name);
-  chops::marshall<std::uint8_t>(buf, ht.federal);
-  marshall(buf, ht.trail_head);
-  chops::marshall_seq<std::uint16_t, loc>(buf, ht.intersections.size(), ht.intersections.cbegin());
-  marshall(buf, ht.stats);
-  return buf;
-}
+template <>
+struct chops::serialize_format<loc> {
+  using type = chops::fields_fmt<std::int32_t, std::int32_t, std::int16_t>;
+};
 
-} // end namespace hiking
+template <>
+struct chops::serialize_format<hiking::trail_stats> {
+  using type = chops::fields_fmt<std::uint64_t, std::uint16_t,
+                                 chops::opt_fmt<std::uint8_t, std::uint16_t>>;
+};
+
+template <>
+struct chops::serialize_format<hiking::hiking_trail> {
+  using type = chops::fields_fmt<chops::seq_fmt<std::uint16_t, char>,
+                                 std::uint8_t,
+                                 chops::serialize_format_t<loc>,
+                                 chops::seq_fmt<std::uint16_t, chops::serialize_format_t<loc>>,
+                                 chops::serialize_format_t<hiking::trail_stats>>;
+};
+
+const loc pt1 { 42, 43, 21 };
+const loc pt2 { 62, 63, 11 };
+
+const hiking::trail_stats ts1 { 101, 51, std::make_optional(201) };
+const hiking::trail_stats ts2 { 301, 41, std::nullopt };
+
+const loc inter1 { 1001, 1002, 500 };
+const loc inter2 { 1003, 1004, 501 };
+const loc inter3 { 1005, 1006, 502 };
+const loc inter4 { 1007, 1008, 503 };
+const loc inter5 { 1009, 1010, 505 };
+const loc inter6 { 1011, 1012, 505 };
+
+const hiking::hiking_trail hk1 { "Huge trail", true, pt1, { inter1, inter2, inter3 }, ts1 };
+const hiking::hiking_trail hk2 { "Small trail", false, pt2, { inter3, inter4, inter5, inter6 }, ts2 };
 
 template <typename Buf>
 void test_marshall () {
@@ -81,49 +112,700 @@ void test_marshall () {
   Buf buf;
 
   chops::marshall<std::uint16_t>(buf, 42);
+  REQUIRE (buf.size() == 2u);
+
+  std::vector<int> vi { 10, 11 };
+  chops::marshall_seq<std::uint16_t, std::int32_t>(buf, 2u, vi.cbegin());
+  chops::marshall<chops::seq_fmt<std::uint8_t, std::int16_t>>(buf, vi);
+  REQUIRE (buf.size() == 2u + (2u + 2u * 4u) + (1u + 2u * 2u));
 
-  std::vector<float> vf { 10.0f, 11.0f };
-  chops::marshall_seq<std::uint16_t, double>(buf, 2u, vf.cbegin());
-  chops::marshall_seq<std::uint16_t, double>(buf, 2u, vf.data());
+  chops::marshall<std::uint16_t>(buf, "Hello");
+  chops::marshall<std::uint8_t, std::int32_t>(buf, std::make_optional(77));
 
-  const loc pt1 { 42, 43, 21 };
-  const loc pt2 { 62, 63, 11 };
+  chops::marshall(buf, pt1);
+  chops::marshall(buf, pt2);
+  chops::marshall(buf, ts1);
+  chops::marshall(buf, ts2);
+  chops::marshall(buf, hk1);
+  chops::marshall(buf, hk2);
 
-  hiking::marshall(buf, pt1);
-  hiking::marshall(buf, pt2);
+  chops::extract_buffer<Buf::endian_type::value> src(buf.data(), buf.size());
 
-  const hiking::trail_stats ts1 { 101, 51, std::make_optional(201) };
-  const hiking::trail_stats ts2 { 301, 41, std::make_optional(401) };
+  int i {0};
+  chops::unmarshall<std::uint16_t>(src, i);
+  REQUIRE (i == 42);
 
-  hiking::marshall(buf, ts1);
-  hiking::marshall(buf, ts2);
+  std::vector<int> vi_out;
+  chops::unmarshall<chops::seq_fmt<std::uint16_t, std::int32_t>>(src, vi_out);
+  REQUIRE (vi_out == vi);
+  chops::unmarshall<chops::seq_fmt<std::uint8_t, std::int16_t>>(src, vi_out);
+  REQUIRE (vi_out == vi);
 
-  const loc inter1 { 1001, 1002, 500 };
-  const loc inter2 { 1003, 1004, 501 };
-  const loc inter3 { 1005, 1006, 502 };
-  const loc inter4 { 1007, 1008, 503 };
-  const loc inter5 { 1009, 1010, 505 };
-  const loc inter6 { 1011, 1012, 505 };
+  std::string str;
+  chops::unmarshall<std::uint16_t>(src, str);
+  REQUIRE (str == "Hello");
 
+  std::optional<long> opt;
+  chops::unmarshall<std::uint8_t, std::int32_t>(src, opt);
+  REQUIRE (opt);
+  REQUIRE (*opt == 77);
 
-  const hiking::hiking_trail hk1 { "Huge trail", true, pt1, { inter1, inter2, inter3 }, ts1 };
-  const hiking::hiking_trail hk2 { "Small trail", false, pt2, { inter3, inter4, inter5, inter6 }, ts2 };
+  loc loc_out { };
+  chops::unmarshall(src, loc_out);
+  REQUIRE (loc_out == pt1);
+  chops::unmarshall(src, loc_out);
+  REQUIRE (loc_out == pt2);
 
-  hiking::marshall(buf, hk1);
-  hiking::marshall(buf, hk2);
+  hiking::trail_stats ts_out { };
+  chops::unmarshall(src, ts_out);
+  REQUIRE (ts_out == ts1);
+  chops::unmarshall(src, ts_out);
+  REQUIRE (ts_out == ts2);
 
+  hiking::hiking_trail hk_out { };
+  chops::unmarshall(src, hk_out);
+  REQUIRE (hk_out == hk1);
+  chops::unmarshall(src, hk_out);
+  REQUIRE (hk_out == hk2);
+
+  REQUIRE (src.remaining() == 0u);
 }
 
-TEMPLATE_TEST_CASE ( "Marshall ", "[marshall] [shared_buffer]",
-                     chops::mutable_shared_buffer, std::vector<std::byte>,
-                     chops::fixed_size_byte_array<1000> ) {
+TEMPLATE_TEST_CASE ( "Marshall and unmarshall", "[marshall] [unmarshall]",
+                     (chops::expandable_buffer<chops::mutable_shared_buffer, std::endian::big>),
+                     (chops::expandable_buffer<std::vector<std::byte>, std::endian::little>),
+                     (chops::expandable_buffer<chops::fixed_size_byte_array<1000>, std::endian::big>) ) {
 
   test_marshall<TestType>();
 
 }
 
-*/
+TEST_CASE ( "Fixed size aggregate format", "[marshall] [fields_fmt]" ) {
+
+  using loc_traits = chops::format_traits<chops::serialize_format_t<loc>>;
+  STATIC_REQUIRE (loc_traits::is_fixed_size);
+  STATIC_REQUIRE (loc_traits::fixed_size == 10u);
+  STATIC_REQUIRE (!chops::format_traits<chops::serialize_format_t<hiking::trail_stats>>::is_fixed_size);
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall(buf, pt1);
+  REQUIRE (buf.size() == 10u);
+  auto& v = buf.get_buf();
+  REQUIRE (std::to_integer<int>(v[3]) == 42);
+  REQUIRE (std::to_integer<int>(v[7]) == 43);
+  REQUIRE (std::to_integer<int>(v[9]) == 21);
+}
+
+TEST_CASE ( "Variant format", "[marshall] [unmarshall] [variant_fmt]" ) {
+
+  using var_type = std::variant<int, std::string, loc, std::optional<short>>;
+  using var_fmt = chops::variant_fmt<std::uint8_t, std::int16_t,
+                                     chops::seq_fmt<std::uint8_t, char>,
+                                     chops::serialize_format_t<loc>,
+                                     chops::opt_fmt<std::uint8_t, std::int16_t>>;
+
+  const std::vector<var_type> vars { var_type { 42 }, var_type { "Hello" }, var_type { pt1 },
+                                     var_type { std::make_optional<short>(7) }, var_type { -5 } };
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<var_fmt>(buf, vars[0]);
+  REQUIRE (buf.size() == 3u);
+  REQUIRE (std::to_integer<int>(buf.get_buf()[0]) == 0);
+  chops::marshall<var_fmt>(buf, vars[1]);
+  REQUIRE (std::to_integer<int>(buf.get_buf()[3]) == 1);
+  chops::marshall<chops::seq_fmt<std::uint16_t, var_fmt>>(buf, vars);
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  var_type var_out;
+  chops::unmarshall<var_fmt>(src, var_out);
+  REQUIRE (var_out == vars[0]);
+  chops::unmarshall<var_fmt>(src, var_out);
+  REQUIRE (var_out.index() == 1u);
+  REQUIRE (var_out == vars[1]);
+  std::vector<var_type> vars_out;
+  chops::unmarshall<chops::seq_fmt<std::uint16_t, var_fmt>>(src, vars_out);
+  REQUIRE (vars_out == vars);
+  REQUIRE (src.remaining() == 0u);
+}
+
+struct matrix_msg {
+  std::uint16_t                id;
+  std::array<std::int32_t, 16> cells;
+  std::string                  label;
+  std::pair<short, short>      dims;
+  std::uint8_t                 flags;
+
+  bool operator==(const matrix_msg&) const = default;
+};
+
+template <>
+struct chops::serialize_format<matrix_msg> {
+  using type = chops::fields_fmt<std::uint16_t,
+                                 chops::array_fmt<16u, std::int32_t>,
+                                 chops::seq_fmt<std::uint8_t, char>,
+                                 chops::tuple_fmt<std::uint8_t, std::uint8_t>,
+                                 std::uint8_t>;
+};
+
+TEST_CASE ( "Tuple and array formats", "[marshall] [unmarshall] [tuple_fmt] [array_fmt]" ) {
+
+  using arr_traits = chops::format_traits<chops::array_fmt<16u, std::int32_t>>;
+  STATIC_REQUIRE (arr_traits::is_fixed_size);
+  STATIC_REQUIRE (arr_traits::fixed_size == 64u);
+  using tup_traits = chops::format_traits<chops::tuple_fmt<std::uint8_t, std::int32_t, std::uint16_t>>;
+  STATIC_REQUIRE (tup_traits::is_fixed_size);
+  STATIC_REQUIRE (tup_traits::fixed_size == 7u);
+  using msg_traits = chops::format_traits<chops::serialize_format_t<matrix_msg>>;
+  STATIC_REQUIRE (!msg_traits::is_fixed_size);
+  STATIC_REQUIRE (msg_traits::tuple_traits::run_size(0u) == 66u);
+  STATIC_REQUIRE (msg_traits::tuple_traits::run_size(3u) == 3u);
+
+  matrix_msg msg { 7u, { }, "matrix", { 4, 4 }, 0x5Au };
+  for (int i = 0; i < 16; ++i) {
+    msg.cells[i] = (i - 8) * 1000;
+  }
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+
+  const std::tuple<int, std::string, bool> tup { -3, "abc", true };
+  chops::marshall<chops::tuple_fmt<std::int16_t, chops::seq_fmt<std::uint8_t, char>, std::uint8_t>>(buf, tup);
+  REQUIRE (buf.size() == 2u + 1u + 3u + 1u);
+
+  const std::array<std::string, 2> strs { "one", "two" };
+  chops::marshall<chops::array_fmt<2u, chops::seq_fmt<std::uint8_t, char>>>(buf, strs);
+  REQUIRE (buf.size() == 7u + 8u);
+
+  chops::marshall(buf, msg);
+  REQUIRE (buf.size() == 15u + 2u + 64u + 1u + 6u + 2u + 1u);
+  auto& v = buf.get_buf();
+  REQUIRE (std::to_integer<int>(v[16]) == 7);
+  REQUIRE (std::to_integer<int>(v[17]) == 0xFF); // big endian -8000 is 0xFFFFE0C0
+  REQUIRE (std::to_integer<int>(v[20]) == 0xC0);
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  std::tuple<int, std::string, bool> tup_out;
+  chops::unmarshall<chops::tuple_fmt<std::int16_t, chops::seq_fmt<std::uint8_t, char>, std::uint8_t>>(src, tup_out);
+  REQUIRE (tup_out == tup);
+  std::array<std::string, 2> strs_out;
+  chops::unmarshall<chops::array_fmt<2u, chops::seq_fmt<std::uint8_t, char>>>(src, strs_out);
+  REQUIRE (strs_out == strs);
+  matrix_msg msg_out { };
+  chops::unmarshall(src, msg_out);
+  REQUIRE (msg_out == msg);
+  REQUIRE (src.remaining() == 0u);
+}
+
+TEST_CASE ( "Associative container formats", "[marshall] [unmarshall] [map_fmt]" ) {
+
+  const std::map<int, std::string> m { { 3, "three" }, { 1, "one" }, { 2, "two" } };
+  std::unordered_map<std::uint32_t, int> um;
+  for (std::uint32_t i = 0u; i < 1000u; ++i) {
+    um.emplace(i * 7u, -static_cast<int>(i));
+  }
+  const std::set<short> st { 5, 4, 3, 2, 1 };
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<chops::map_fmt<std::uint8_t, std::int16_t, chops::seq_fmt<std::uint8_t, char>>>(buf, m);
+  // keys are emitted in sorted order
+  REQUIRE (std::to_integer<int>(buf.get_buf()[2]) == 1);
+  chops::marshall<chops::map_fmt<std::uint16_t, std::uint32_t, std::int32_t>>(buf, um);
+  chops::marshall<chops::seq_fmt<std::uint8_t, std::int16_t>>(buf, st);
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  std::map<int, std::string> m_out { { 42, "stale" } };
+  chops::unmarshall<chops::map_fmt<std::uint8_t, std::int16_t, chops::seq_fmt<std::uint8_t, char>>>(src, m_out);
+  REQUIRE (m_out == m);
+  std::unordered_map<std::uint32_t, int> um_out;
+  chops::unmarshall<chops::map_fmt<std::uint16_t, std::uint32_t, std::int32_t>>(src, um_out);
+  REQUIRE (um_out == um);
+  std::set<short> st_out;
+  chops::unmarshall<chops::seq_fmt<std::uint8_t, std::int16_t>>(src, st_out);
+  REQUIRE (st_out == st);
+  REQUIRE (src.remaining() == 0u);
+
+  // an untrusted count beyond the maximum is rejected before any element is decoded
+  using small_map_fmt = chops::map_fmt<std::uint16_t, std::uint32_t, std::int32_t, 100u>;
+  STATIC_REQUIRE (chops::max_encoded_size<small_map_fmt> == 2u + 100u * 8u);
+  auto um_pos = chops::encoded_size<chops::map_fmt<std::uint8_t, std::int16_t, chops::seq_fmt<std::uint8_t, char>>>(m);
+  chops::read_cursor<std::endian::big> cur(buf.data() + um_pos, buf.size() - um_pos);
+  std::unordered_map<std::uint32_t, int> small_out { { 1u, 1 } };
+  REQUIRE (chops::try_unmarshall<small_map_fmt>(cur, small_out) == chops::decode_error::count_too_large);
+  REQUIRE (small_out.empty());
+  chops::read_cursor<std::endian::big> vcur(buf.data() + um_pos, buf.size() - um_pos);
+  REQUIRE (chops::validate<small_map_fmt>(vcur) == chops::decode_error::count_too_large);
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> over_buf;
+  REQUIRE_THROWS_AS (chops::marshall<small_map_fmt>(over_buf, um), std::length_error);
+}
+
+enum class color : int { red, green, blue };
+enum class level : std::uint16_t { low = 1, mid = 500, high = 1000 };
+enum class small : std::uint8_t { a, b, c };
+enum class tiny : std::int8_t { neg = -1, zero, pos };
+
+TEST_CASE ( "Enum and chrono formats", "[marshall] [unmarshall] [enum_fmt] [chrono_fmt]" ) {
+
+  using namespace std::chrono_literals;
+  using sys_micros = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>;
+
+  using color_fmt = chops::enum_fmt<std::uint8_t, color::blue>;
+  using micro_fmt = chops::chrono_fmt<std::int64_t, std::micro>;
+
+  STATIC_REQUIRE (chops::format_traits<color_fmt>::fixed_size == 1u);
+  STATIC_REQUIRE (chops::detail::is_bulk_convertible<micro_fmt, std::vector<sys_micros>>());
+  STATIC_REQUIRE (!chops::detail::is_bulk_convertible<micro_fmt, std::vector<std::chrono::milliseconds>>());
+  STATIC_REQUIRE (chops::detail::is_bulk_convertible<std::uint16_t, std::vector<level>>());
+  STATIC_REQUIRE (!chops::detail::is_bulk_convertible<color_fmt, std::vector<color>>());
+
+  const sys_micros tp { std::chrono::microseconds { 1700000000123456 } };
+  const std::vector<sys_micros> tps { tp, tp + 1s, tp + 2ms, tp + 3us };
+  const std::vector<level> levels { level::low, level::high, level::mid };
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<color_fmt>(buf, color::green);
+  chops::marshall<chops::enum_fmt<std::uint8_t>>(buf, level::low);
+  chops::marshall<std::uint16_t>(buf, level::high);
+  REQUIRE (buf.size() == 4u);
+  REQUIRE (std::to_integer<int>(buf.get_buf()[0]) == 1);
+  REQUIRE (std::to_integer<int>(buf.get_buf()[1]) == 1);
+
+  chops::marshall<micro_fmt>(buf, std::chrono::milliseconds { 1500 });
+  chops::marshall<chops::chrono_fmt<std::uint32_t>>(buf, std::chrono::seconds { 90 });
+  chops::marshall<chops::chrono_fmt<std::int64_t, std::milli>>(buf, tp);
+  chops::marshall<chops::seq_fmt<std::uint16_t, micro_fmt>>(buf, tps);
+  chops::marshall<chops::seq_fmt<std::uint8_t, std::uint16_t>>(buf, levels);
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  color c { };
+  chops::unmarshall<color_fmt>(src, c);
+  REQUIRE (c == color::green);
+  level lv { };
+  chops::unmarshall<chops::enum_fmt<std::uint8_t>>(src, lv);
+  REQUIRE (lv == level::low);
+  chops::unmarshall<std::uint16_t>(src, lv);
+  REQUIRE (lv == level::high);
+
+  std::chrono::milliseconds ms { };
+  chops::unmarshall<micro_fmt>(src, ms);
+  REQUIRE (ms == 1500ms);
+  std::chrono::minutes mins { };
+  chops::unmarshall<chops::chrono_fmt<std::uint32_t, std::ratio<1>>>(src, mins);
+  REQUIRE (mins == 1min); // 90 seconds truncated to minutes
+  sys_micros tp_out { };
+  chops::unmarshall<chops::chrono_fmt<std::int64_t, std::milli>>(src, tp_out);
+  REQUIRE (tp_out == std::chrono::time_point_cast<std::chrono::milliseconds>(tp));
+  std::vector<sys_micros> tps_out;
+  chops::unmarshall<chops::seq_fmt<std::uint16_t, micro_fmt>>(src, tps_out);
+  REQUIRE (tps_out == tps);
+  std::vector<level> levels_out;
+  chops::unmarshall<chops::seq_fmt<std::uint8_t, std::uint16_t>>(src, levels_out);
+  REQUIRE (levels_out == levels);
+  REQUIRE (src.remaining() == 0u);
+}
+
+struct heartbeat {
+  std::uint8_t   msg_type;
+  std::uint32_t  seq_num;
+  color          status;
+};
+
+struct hello_msg {
+  std::string_view            client_name;
+  std::optional<std::int16_t> version;
+  std::array<std::uint16_t, 3> ports;
+};
+
+using heartbeat_fmt = chops::fields_fmt<std::uint8_t, std::uint32_t, chops::enum_fmt<std::uint8_t, color::blue>>;
+using hello_fmt = chops::fields_fmt<chops::seq_fmt<std::uint8_t, char>,
+                                    chops::opt_fmt<std::uint8_t, std::int16_t>,
+                                    chops::array_fmt<3u, std::uint16_t>>;
+
+constexpr heartbeat hb { 1u, 0x01020304u, color::blue };
+constexpr auto hb_frame = chops::serialize_to_array<heartbeat_fmt, std::endian::big>(hb);
+
+constexpr hello_msg hello { "client-1", std::optional<std::int16_t> { 3 }, { 80u, 443u, 8080u } };
+constexpr auto hello_frame = chops::serialize_to_array<hello_fmt, std::endian::little,
+                                                       chops::encoded_size<hello_fmt>(hello)>(hello);
+
+TEST_CASE ( "Compile time serialization", "[serialize_to_array] [encoded_size]" ) {
+
+  STATIC_REQUIRE (hb_frame.size() == 6u);
+  STATIC_REQUIRE (hb_frame[1] == std::byte{0x01});
+  STATIC_REQUIRE (hb_frame[4] == std::byte{0x04});
+  STATIC_REQUIRE (hb_frame[5] == std::byte{0x02});
+
+  STATIC_REQUIRE (hello_frame.size() == 1u + 8u + 1u + 2u + 6u);
+  STATIC_REQUIRE (hello_frame[0] == std::byte{8u});
+  STATIC_REQUIRE (hello_frame[1] == std::byte{'c'});
+  STATIC_REQUIRE (hello_frame[12] == std::byte{80u});
+
+  REQUIRE (chops::encoded_size<chops::serialize_format_t<hiking::hiking_trail>>(hk1) ==
+           2u + 10u + 1u + 10u + 2u + 3u * 10u + 8u + 2u + 1u + 2u);
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall(buf, hk2);
+  REQUIRE (chops::encoded_size<chops::serialize_format_t<hiking::hiking_trail>>(hk2) == buf.size());
+
+  // runtime serialization produces the same bytes as the compile time frame
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::little> hello_buf;
+  chops::marshall<hello_fmt>(hello_buf, hello);
+  REQUIRE (hello_buf.size() == hello_frame.size());
+  REQUIRE (std::equal(hello_frame.cbegin(), hello_frame.cend(), hello_buf.get_buf().cbegin()));
+}
+
+TEST_CASE ( "Maximum encoded size of bounded formats", "[max_encoded_size] [bounded_buffer]" ) {
+
+  using name_fmt = chops::seq_fmt<std::uint8_t, char>;
+  using pts_fmt = chops::seq_fmt<std::uint8_t, chops::serialize_format_t<loc>, 4u>;
+  using msg_fmt = chops::fields_fmt<name_fmt, chops::opt_fmt<std::uint8_t, std::int16_t>,
+                                    chops::variant_fmt<std::uint8_t, std::int64_t, name_fmt>>;
+
+  STATIC_REQUIRE (chops::max_encoded_size<std::int32_t> == 4u);
+  STATIC_REQUIRE (chops::max_encoded_size<name_fmt> == 1u + 255u);
+  STATIC_REQUIRE (chops::max_encoded_size<pts_fmt> == 1u + 4u * 10u);
+  STATIC_REQUIRE (chops::max_encoded_size<msg_fmt> == (1u + 255u) + (1u + 2u) + (1u + 1u + 255u));
+  STATIC_REQUIRE (chops::max_encoded_size<chops::array_fmt<3u, name_fmt>> == 3u * 256u);
+  STATIC_REQUIRE (chops::bounded_format<chops::serialize_format_t<hiking::hiking_trail>>);
+  STATIC_REQUIRE (!chops::bounded_format<chops::seq_fmt<std::uint64_t, std::int32_t>>);
+  STATIC_REQUIRE (!chops::bounded_format<chops::seq_fmt<std::uint8_t, chops::seq_fmt<std::uint64_t, char>>>);
+
+  const std::vector<loc> pts { inter1, inter2, inter3 };
+  chops::bounded_buffer<pts_fmt, std::endian::big> buf;
+  STATIC_REQUIRE (sizeof(buf.get_buf().get_array()) == chops::max_encoded_size<pts_fmt>);
+  chops::marshall<pts_fmt>(buf, pts);
+  REQUIRE (buf.size() == chops::encoded_size<pts_fmt>(pts));
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  std::vector<loc> pts_out;
+  chops::unmarshall<pts_fmt>(src, pts_out);
+  REQUIRE (pts_out == pts);
+
+  // counts beyond the format maximum are checked in all builds, not only with asserts
+  chops::bounded_buffer<pts_fmt, std::endian::big> over_buf;
+  REQUIRE_THROWS_AS (chops::marshall<pts_fmt>(over_buf, std::vector<loc>(5u, inter1)), std::length_error);
+  REQUIRE (over_buf.size() == 0u);
+  using short_fmt = chops::seq_fmt<std::uint16_t, std::uint32_t, 4u>;
+  chops::bounded_buffer<short_fmt> short_buf;
+  REQUIRE_THROWS_AS (chops::marshall<short_fmt>(short_buf, std::vector<std::uint16_t>(64u)), std::length_error);
+  using name_buf_fmt = chops::seq_fmt<std::uint8_t, char>;
+  chops::expandable_buffer<std::vector<std::byte>> name_buf;
+  REQUIRE_THROWS_AS (chops::marshall<name_buf_fmt>(name_buf, std::string(256u, 'a')), std::length_error);
+  chops::fixed_size_byte_array<4u> arr;
+  REQUIRE_THROWS_AS (arr.resize(5u), std::length_error);
+}
+
+TEST_CASE ( "Unchecked write cursor", "[write_cursor]" ) {
+
+  using trail_fmt = chops::serialize_format_t<hiking::hiking_trail>;
+  const std::vector<hiking::hiking_trail> trails { hk1, hk2, hk1 };
+  using trails_fmt = chops::seq_fmt<std::uint16_t, trail_fmt>;
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> exp_buf;
+  chops::marshall<trails_fmt>(exp_buf, trails);
+
+  std::vector<std::byte> vec { std::byte{0xAA} };
+  auto cur = chops::make_write_cursor<std::endian::big>(vec, chops::encoded_size<trails_fmt>(trails));
+  REQUIRE (cur.capacity() == exp_buf.size());
+  chops::marshall<trails_fmt>(cur, trails);
+  REQUIRE (cur.size() == cur.capacity());
+  REQUIRE (vec.size() == exp_buf.size() + 1u);
+  REQUIRE (vec[0] == std::byte{0xAA});
+  REQUIRE (std::equal(exp_buf.get_buf().cbegin(), exp_buf.get_buf().cend(), vec.cbegin() + 1));
+
+  std::array<std::byte, chops::max_encoded_size<chops::serialize_format_t<loc>>> arr { };
+  chops::write_cursor<std::endian::little> arr_cur(arr);
+  chops::marshall(arr_cur, pt2);
+  REQUIRE (arr_cur.size() == arr.size());
+  REQUIRE (arr[0] == std::byte{62});
+}
+
+TEST_CASE ( "Bounds-checked read cursor", "[read_cursor] [try_unmarshall]" ) {
+
+  using trail_fmt = chops::serialize_format_t<hiking::hiking_trail>;
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall(buf, hk1);
+  const auto& bytes = buf.get_buf();
+
+  {
+    chops::read_cursor<std::endian::big> cur(bytes.data(), bytes.size());
+    hiking::hiking_trail trail;
+    REQUIRE (chops::try_unmarshall<trail_fmt>(cur, trail) == chops::decode_error::none);
+    REQUIRE (trail == hk1);
+    REQUIRE (cur.remaining() == 0u);
+  }
+  // every truncation is reported, without reading past the end
+  for (std::size_t sz {0u}; sz < bytes.size(); ++sz) {
+    std::vector<std::byte> part(bytes.cbegin(), bytes.cbegin() + sz);
+    chops::read_cursor<std::endian::big> cur(part);
+    hiking::hiking_trail trail;
+    REQUIRE (chops::try_unmarshall<trail_fmt>(cur, trail) == chops::decode_error::truncated);
+    REQUIRE (!cur.ok());
+    REQUIRE (cur.remaining() == 0u);
+  }
+  {
+    // a huge count in a short buffer
+    const std::array<std::byte, 3> huge { std::byte{0xFF}, std::byte{0xFF}, std::byte{0x01} };
+    chops::read_cursor<std::endian::big> cur(huge);
+    std::string str;
+    REQUIRE (chops::try_unmarshall<chops::seq_fmt<std::uint16_t, char>>(cur, str) ==
+             chops::decode_error::truncated);
+    REQUIRE (str.empty());
+  }
+  {
+    const std::array<std::byte, 3> five { std::byte{5}, std::byte{1}, std::byte{2} };
+    chops::read_cursor<std::endian::big> cur(five);
+    std::vector<std::uint8_t> vec;
+    REQUIRE (chops::try_unmarshall<chops::seq_fmt<std::uint8_t, std::uint8_t, 4u>>(cur, vec) ==
+             chops::decode_error::count_too_large);
+  }
+  {
+    const std::array<std::byte, 3> bad_flag { std::byte{2}, std::byte{0}, std::byte{7} };
+    chops::read_cursor<std::endian::big> cur(bad_flag);
+    std::optional<std::int16_t> opt;
+    REQUIRE (chops::try_unmarshall<chops::opt_fmt<std::uint8_t, std::int16_t>>(cur, opt) ==
+             chops::decode_error::invalid_value);
+    // the first error is sticky
+    std::int16_t val { 0 };
+    REQUIRE (chops::try_unmarshall<std::int16_t>(cur, val) == chops::decode_error::invalid_value);
+  }
+  {
+    const std::array<std::byte, 3> bad_disc { std::byte{2}, std::byte{0}, std::byte{7} };
+    chops::read_cursor<std::endian::big> cur(bad_disc);
+    std::variant<short, loc> var;
+    REQUIRE (chops::try_unmarshall<chops::variant_fmt<std::uint8_t, std::int16_t,
+                                                      chops::serialize_format_t<loc>>>(cur, var) ==
+             chops::decode_error::invalid_discriminant);
+  }
+#ifdef __cpp_lib_expected
+  auto res = chops::try_unmarshall<trail_fmt, hiking::hiking_trail, std::endian::big>(bytes);
+  REQUIRE (res.has_value());
+  REQUIRE (*res == hk1);
+  auto bad = chops::try_unmarshall<trail_fmt, hiking::hiking_trail, std::endian::big>(
+               std::span<const std::byte>(bytes.data(), 5u));
+  REQUIRE (!bad.has_value());
+  REQUIRE (bad.error() == chops::decode_error::truncated);
+#endif
+}
+
+TEST_CASE ( "Single pass validation", "[validate]" ) {
+
+  using trail_fmt = chops::serialize_format_t<hiking::hiking_trail>;
+  using trails_fmt = chops::seq_fmt<std::uint16_t, trail_fmt>;
+  using color_fmt = chops::enum_fmt<std::uint8_t, color::blue>;
+  using colors_fmt = chops::seq_fmt<std::uint8_t, chops::tuple_fmt<std::uint16_t, color_fmt>>;
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<trails_fmt>(buf, std::vector<hiking::hiking_trail> { hk1, hk2 });
+  std::vector<std::byte> bytes = buf.get_buf();
+
+  REQUIRE (chops::validate<trails_fmt, std::endian::big>(bytes) == chops::decode_error::none);
+  for (std::size_t sz {0u}; sz < bytes.size(); ++sz) {
+    REQUIRE (chops::validate<trails_fmt, std::endian::big>(std::span<const std::byte>(bytes.data(), sz)) ==
+             chops::decode_error::truncated);
+  }
+  bytes.push_back(std::byte{0});
+  REQUIRE (chops::validate<trails_fmt, std::endian::big>(bytes) == chops::decode_error::trailing_bytes);
+
+  // consecutive values, validated then decoded through the unchecked path
+  chops::read_cursor<std::endian::big> cur(bytes);
+  REQUIRE (chops::validate<trails_fmt>(cur) == chops::decode_error::none);
+  REQUIRE (chops::validate<std::uint8_t>(cur) == chops::decode_error::none);
+  REQUIRE (cur.remaining() == 0u);
+  chops::extract_buffer<std::endian::big> src(bytes);
+  std::vector<hiking::hiking_trail> trails;
+  chops::unmarshall<trails_fmt>(src, trails);
+  REQUIRE (trails == std::vector<hiking::hiking_trail> { hk1, hk2 });
+
+  // enum values beyond the maximum are rejected, also when decoding through a read cursor
+  const std::array<std::byte, 4> good_clrs { std::byte{1}, std::byte{0}, std::byte{1}, std::byte{2} };
+  REQUIRE (chops::validate<colors_fmt, std::endian::big>(good_clrs) == chops::decode_error::none);
+  const std::array<std::byte, 7> clrs { std::byte{2}, std::byte{0}, std::byte{1}, std::byte{2},
+                                        std::byte{0}, std::byte{2}, std::byte{9} };
+  REQUIRE (chops::validate<colors_fmt, std::endian::big>(clrs) == chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> clr_cur(clrs);
+  std::vector<std::pair<std::uint16_t, color>> clr_vec;
+  REQUIRE (chops::try_unmarshall<colors_fmt>(clr_cur, clr_vec) == chops::decode_error::invalid_value);
+
+  // negative wire values and wire values too wide for the underlying type are not
+  // truncated into range
+  using signed_color_fmt = chops::enum_fmt<std::int8_t, color::blue>;
+  const std::array<std::byte, 1> neg_clr { std::byte{0xFB} };
+  REQUIRE (chops::validate<signed_color_fmt, std::endian::big>(neg_clr) == chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> neg_cur(neg_clr);
+  color neg_out { };
+  REQUIRE (chops::try_unmarshall<signed_color_fmt>(neg_cur, neg_out) == chops::decode_error::invalid_value);
+  const std::array<std::byte, 1> pos_clr { std::byte{2} };
+  REQUIRE (chops::validate<signed_color_fmt, std::endian::big>(pos_clr) == chops::decode_error::none);
+
+  using wide_small_fmt = chops::enum_fmt<std::uint16_t, small::c>;
+  const std::array<std::byte, 2> wide_small { std::byte{1}, std::byte{1} }; // 257
+  REQUIRE (chops::validate<wide_small_fmt, std::endian::big>(wide_small) == chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> wide_cur(wide_small);
+  small wide_out { };
+  REQUIRE (chops::try_unmarshall<wide_small_fmt>(wide_cur, wide_out) == chops::decode_error::invalid_value);
+  const std::array<std::byte, 2> ok_small { std::byte{0}, std::byte{2} };
+  REQUIRE (chops::validate<wide_small_fmt, std::endian::big>(ok_small) == chops::decode_error::none);
+
+  // without a maximum, checked decoding rejects wire values outside the underlying type
+  using tiny_fmt = chops::enum_fmt<std::uint8_t>;
+  const std::array<std::byte, 3> tinies { std::byte{2}, std::byte{1}, std::byte{200} };
+  chops::read_cursor<std::endian::big> tiny_cur(tinies.data() + 1u, 1u);
+  tiny tiny_out { };
+  REQUIRE (chops::try_unmarshall<tiny_fmt>(tiny_cur, tiny_out) == chops::decode_error::none);
+  REQUIRE (tiny_out == tiny::pos);
+  chops::read_cursor<std::endian::big> tiny_bad(tinies.data() + 2u, 1u);
+  REQUIRE (chops::try_unmarshall<tiny_fmt>(tiny_bad, tiny_out) == chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> tiny_seq(tinies);
+  std::vector<tiny> tiny_vec;
+  REQUIRE (chops::try_unmarshall<chops::seq_fmt<std::uint8_t, tiny_fmt>>(tiny_seq, tiny_vec) ==
+           chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> tiny_arr(tinies);
+  std::array<tiny, 3> tiny_out_arr { };
+  REQUIRE (chops::try_unmarshall<chops::array_fmt<3u, tiny_fmt>>(tiny_arr, tiny_out_arr) ==
+           chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> tiny_tup(tinies);
+  std::tuple<std::uint16_t, tiny> tiny_pair { };
+  REQUIRE (chops::try_unmarshall<chops::tuple_fmt<std::uint16_t, tiny_fmt>>(tiny_tup, tiny_pair) ==
+           chops::decode_error::invalid_value);
+
+  const std::array<std::byte, 3> bad_flag { std::byte{0}, std::byte{3}, std::byte{7} };
+  REQUIRE (chops::validate<chops::tuple_fmt<std::uint8_t, chops::opt_fmt<std::uint8_t, std::uint8_t>>,
+                           std::endian::big>(bad_flag) == chops::decode_error::invalid_value);
+}
+
+TEST_CASE ( "Decode into existing containers", "[unmarshall] [seq_fmt]" ) {
+
+  using ints_fmt = chops::seq_fmt<std::uint16_t, std::int32_t>;
+  using str_fmt = chops::seq_fmt<std::uint8_t, char>;
+  using trails_fmt = chops::seq_fmt<std::uint16_t, chops::serialize_format_t<hiking::hiking_trail>>;
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<ints_fmt>(buf, std::vector<int> { 1, 2, 3 });
+  chops::marshall<str_fmt>(buf, std::string_view("Short"));
+  chops::marshall<trails_fmt>(buf, std::vector<hiking::hiking_trail> { hk2 });
+  chops::marshall<chops::opt_fmt<std::uint8_t, str_fmt>>(buf, std::make_optional<std::string>("Opt"));
+
+  std::vector<int> ints(100u, 7);
+  const int* ints_data = ints.data();
+  std::string str(100u, 'x');
+  const char* str_data = str.data();
+  std::vector<hiking::hiking_trail> trails { hk1, hk1 };
+  trails[0].name.resize(100u);
+  const char* name_data = trails[0].name.data();
+  std::optional<std::string> opt { std::string(100u, 'y') };
+  const char* opt_data = opt->data();
+
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  chops::unmarshall<ints_fmt>(src, ints);
+  chops::unmarshall<str_fmt>(src, str);
+  chops::unmarshall<trails_fmt>(src, trails);
+  chops::unmarshall<chops::opt_fmt<std::uint8_t, str_fmt>>(src, opt);
+  REQUIRE (src.remaining() == 0u);
+
+  REQUIRE (ints == std::vector<int> { 1, 2, 3 });
+  REQUIRE (ints.data() == ints_data);
+  REQUIRE (str == "Short");
+  REQUIRE (str.data() == str_data);
+  REQUIRE (trails == std::vector<hiking::hiking_trail> { hk2 });
+  REQUIRE (trails[0].name.data() == name_data);
+  REQUIRE (*opt == "Opt");
+  REQUIRE (opt->data() == opt_data);
+}
+
+struct pmr_trail {
+  std::pmr::string                                 name;
+  std::pmr::vector<std::pmr::string>               tags;
+  std::optional<std::pmr::string>                  note;
+  std::pmr::vector<loc>                            locs;
+  std::variant<int, std::pmr::string>              alt;
+  std::pmr::map<std::pmr::string, std::pmr::string> attrs;
+};
+
+TEST_CASE ( "Decode with a memory resource", "[unmarshall] [resource_buffer]" ) {
+
+  using str_fmt = chops::seq_fmt<std::uint8_t, char>;
+  using pmr_trail_fmt = chops::fields_fmt<str_fmt,
+                                          chops::seq_fmt<std::uint8_t, str_fmt>,
+                                          chops::opt_fmt<std::uint8_t, str_fmt>,
+                                          chops::seq_fmt<std::uint8_t, chops::serialize_format_t<loc>>,
+                                          chops::variant_fmt<std::uint8_t, std::int32_t, str_fmt>,
+                                          chops::map_fmt<std::uint8_t, str_fmt, str_fmt>>;
+
+  // strings long enough to defeat the small string optimization
+  const std::string long_str(40u, 'a');
+  pmr_trail in { std::pmr::string(long_str.c_str()),
+                 { std::pmr::string(long_str.c_str()), "tag" },
+                 std::pmr::string(long_str.c_str()),
+                 { pt1, pt2 },
+                 std::pmr::string(long_str.c_str()),
+                 { { std::pmr::string(long_str.c_str()), std::pmr::string(long_str.c_str()) } } };
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<pmr_trail_fmt>(buf, in);
+
+  std::pmr::monotonic_buffer_resource arena;
+  // any allocation from the default resource throws
+  auto* old_res = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  auto out = chops::make_using_resource<pmr_trail>(&arena);
+  REQUIRE (out.name.get_allocator().resource() == &arena);
+  REQUIRE (out.locs.get_allocator().resource() == &arena);
+  chops::resource_buffer src(chops::read_cursor<std::endian::big>(buf.data(), buf.size()), &arena);
+  REQUIRE (chops::try_unmarshall<pmr_trail_fmt>(src, out) == chops::decode_error::none);
+  std::pmr::set_default_resource(old_res);
+
+  REQUIRE (src.remaining() == 0u);
+  REQUIRE (out.name == in.name);
+  REQUIRE (out.tags == in.tags);
+  REQUIRE (out.tags[0].get_allocator().resource() == &arena);
+  REQUIRE (out.note == in.note);
+  REQUIRE (out.note->get_allocator().resource() == &arena);
+  REQUIRE (out.locs == in.locs);
+  REQUIRE (out.alt == in.alt);
+  REQUIRE (std::get<1>(out.alt).get_allocator().resource() == &arena);
+  REQUIRE (out.attrs == in.attrs);
+  REQUIRE (out.attrs.begin()->second.get_allocator().resource() == &arena);
+}
+
+TEST_CASE ( "Length prefixed frames", "[marshall_framed]" ) {
+
+  using name_fmt = chops::seq_fmt<std::uint8_t, char>;
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall_framed<std::uint16_t, name_fmt>(buf, std::string("abc"));
+  chops::marshall_framed<std::uint16_t, std::uint32_t>(buf, 42u);
+  chops::marshall_framed<std::uint16_t, name_fmt>(buf, std::string());
+  REQUIRE (buf.size() == (2u + 4u) + (2u + 4u) + (2u + 1u));
+  REQUIRE (buf.get_buf()[1] == std::byte{4u});
+
+  std::vector<std::span<const std::byte>> frames;
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(buf.get_buf(), frames) == chops::decode_error::none);
+  REQUIRE (frames.size() == 3u);
+  REQUIRE (frames[1].size() == 4u);
+  REQUIRE (chops::validate<chops::seq_fmt<std::uint8_t, char>, std::endian::big>(frames[2]) == chops::decode_error::none);
+
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(std::span(buf.data(), buf.size() - 1u), frames) ==
+           chops::decode_error::truncated);
+  REQUIRE (frames.size() == 2u);
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(std::span(buf.data(), 1u), frames) ==
+           chops::decode_error::truncated);
+  REQUIRE (frames.empty());
+
+  // an unbounded format is checked when marshalling, a value too long for the length throws
+  using nested_fmt = chops::seq_fmt<std::uint32_t, chops::seq_fmt<std::uint32_t, std::uint64_t>>;
+  static_assert(!chops::bounded_format<nested_fmt>);
+  auto old_sz = buf.size();
+  chops::marshall_framed<std::uint8_t, nested_fmt>(buf, std::vector<std::vector<std::uint64_t>>(1u, { 1u, 2u }));
+  REQUIRE (buf.size() == old_sz + 1u + 4u + 4u + 16u);
+  old_sz = buf.size();
+  REQUIRE_THROWS (chops::marshall_framed<std::uint8_t, nested_fmt>(buf,
+                    std::vector<std::vector<std::uint64_t>>(1u, std::vector<std::uint64_t>(40u))));
+  REQUIRE (buf.size() == old_sz);
 
-TEST_CASE ( "Placeholder", "[placeholder]" ) {
-  REQUIRE (true);
+  // a bounded format whose maximum does not fit the length is checked the same way
+  using str_fmt = chops::seq_fmt<std::uint16_t, char>;
+  static_assert(chops::max_encoded_size<str_fmt> > 255u);
+  chops::marshall_framed<std::uint8_t, str_fmt>(buf, std::string(10u, 'a'));
+  REQUIRE (buf.size() == old_sz + 1u + 2u + 10u);
+  old_sz = buf.size();
+  REQUIRE_THROWS_AS ((chops::marshall_framed<std::uint8_t, str_fmt>(buf, std::string(300u, 'a'))),
+                     std::length_error);
+  REQUIRE (buf.size() == old_sz);
 }
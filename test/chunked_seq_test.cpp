@@ -0,0 +1,283 @@
+/** @file
+ *
+ * @brief Test scenarios for @c chunked_seq_fmt and @c marshall_chunked.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <list>
+#include <string>
+#include <span>
+#include <ranges>
+#include <coroutine>
+#include <exception> // std::terminate
+#include <utility> // std::exchange
+#include <memory> // std::allocator
+#include <algorithm> // std::equal
+#include <bit> // std::endian
+
+#include "serialize/chunked_seq.hpp"
+#include "serialize/hash64.hpp"
+#include "serialize/crc32c.hpp"
+#include "serialize/binary_serialize.hpp"
+
+// minimal single pass coroutine generator, as std::generator is C++ 23
+template <typename T>
+class gen {
+public:
+  struct promise_type {
+    const T* m_val = nullptr;
+    gen get_return_object() { return gen(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return { }; }
+    std::suspend_always final_suspend() noexcept { return { }; }
+    std::suspend_always yield_value(const T& val) noexcept { m_val = &val; return { }; }
+    void return_void() noexcept { }
+    void unhandled_exception() { std::terminate(); }
+  };
+  struct iterator {
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    std::coroutine_handle<promise_type> m_coro;
+    const T& operator*() const { return *m_coro.promise().m_val; }
+    iterator& operator++() { m_coro.resume(); return *this; }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const { return m_coro.done(); }
+  };
+  explicit gen(std::coroutine_handle<promise_type> coro) : m_coro(coro) { }
+  gen(gen&& other) noexcept : m_coro(std::exchange(other.m_coro, { })) { }
+  ~gen() { if (m_coro) { m_coro.destroy(); } }
+  iterator begin() { m_coro.resume(); return { m_coro }; }
+  std::default_sentinel_t end() { return { }; }
+private:
+  std::coroutine_handle<promise_type> m_coro;
+};
+
+// const iterable, single pass range, so elements are staged until the chunk count is known
+struct input_vals {
+  const std::vector<std::uint16_t>& m_vals;
+  struct iterator {
+    using value_type = std::uint16_t;
+    using difference_type = std::ptrdiff_t;
+    const std::uint16_t* m_ptr;
+    const std::uint16_t& operator*() const { return *m_ptr; }
+    iterator& operator++() { ++m_ptr; return *this; }
+    void operator++(int) { ++m_ptr; }
+  };
+  struct sentinel {
+    const std::uint16_t* m_end;
+    bool operator==(const iterator& it) const { return it.m_ptr == m_end; }
+  };
+  iterator begin() const { return { m_vals.data() }; }
+  sentinel end() const { return { m_vals.data() + m_vals.size() }; }
+};
+
+struct row {
+  std::uint32_t id;
+  std::string   name;
+};
+
+using row_fmt = chops::fields_fmt<std::uint32_t, chops::seq_fmt<std::uint8_t, char>>;
+
+gen<row> rows(std::uint32_t num) {
+  for (std::uint32_t i {0u}; i < num; ++i) {
+    row r { i, std::string(i % 20u, 'r') };
+    co_yield r;
+  }
+}
+
+TEST_CASE ( "Chunked sequence format", "[chunked_seq_fmt]" ) {
+  using chunk_fmt = chops::chunked_seq_fmt<std::uint8_t, std::uint16_t, 3u>;
+
+  const std::vector<std::uint16_t> vals { 1u, 2u, 3u, 4u, 5u, 6u, 7u };
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<chunk_fmt>(buf, vals);
+  REQUIRE (buf.size() == chops::encoded_size<chunk_fmt>(vals));
+  REQUIRE (buf.size() == 4u + 7u * 2u);
+  REQUIRE (buf.get_buf()[0] == std::byte{3u});
+  REQUIRE (buf.get_buf()[14] == std::byte{1u});
+  REQUIRE (buf.get_buf()[17] == std::byte{0u});
+  REQUIRE (chops::validate<chunk_fmt, std::endian::big>(buf.get_buf()) == chops::decode_error::none);
+
+  std::vector<std::uint16_t> out(20u, 9u);
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  chops::unmarshall<chunk_fmt>(src, out);
+  REQUIRE (out == vals);
+  std::list<int> lst { 42 };
+  chops::read_cursor<std::endian::big> cur(buf.data(), buf.size());
+  REQUIRE (chops::try_unmarshall<chunk_fmt>(cur, lst) == chops::decode_error::none);
+  REQUIRE (lst == std::list<int> { 1, 2, 3, 4, 5, 6, 7 });
+
+  // exact multiple of the chunk size, and empty
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf2;
+  chops::marshall<chunk_fmt>(buf2, std::vector<std::uint16_t>(6u, 1u));
+  REQUIRE (buf2.size() == 3u + 12u);
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf3;
+  chops::marshall<chunk_fmt>(buf3, std::vector<std::uint16_t>{});
+  REQUIRE (buf3.size() == 1u);
+
+  // untrusted input
+  for (std::size_t i {0u}; i < buf.size(); ++i) {
+    chops::read_cursor<std::endian::big> part(buf.data(), i);
+    REQUIRE (chops::try_unmarshall<chunk_fmt>(part, out) == chops::decode_error::truncated);
+  }
+  using small_fmt = chops::chunked_seq_fmt<std::uint8_t, std::uint16_t, 3u, 5u>;
+  REQUIRE (chops::validate<small_fmt, std::endian::big>(buf.get_buf()) == chops::decode_error::count_too_large);
+
+  // a single pass range produces the same bytes
+  static_assert(!std::ranges::forward_range<const input_vals>);
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf4;
+  chops::marshall<chunk_fmt>(buf4, input_vals { vals });
+  REQUIRE (buf4.get_buf() == buf.get_buf());
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf5;
+  chops::marshall<chunk_fmt>(buf5, input_vals { std::vector<std::uint16_t>(6u, 1u) });
+  REQUIRE (buf5.get_buf() == buf2.get_buf());
+
+  // counts are not back-patched, so a buffer that hashes bytes as they are appended works
+  using big_fmt = chops::chunked_seq_fmt<std::uint16_t, std::uint16_t, 100u>;
+  std::vector<std::uint16_t> many(3000u);
+  for (std::size_t i {0u}; i < many.size(); ++i) {
+    many[i] = static_cast<std::uint16_t>(i * 31u);
+  }
+  for (int single_pass {0}; single_pass < 2; ++single_pass) {
+    chops::hashing_buffer<chops::expandable_buffer<std::vector<std::byte>, std::endian::big>> hbuf;
+    if (single_pass == 0) {
+      chops::marshall<big_fmt>(hbuf, many);
+    }
+    else {
+      chops::marshall<big_fmt>(hbuf, input_vals { many });
+    }
+    auto& bytes = hbuf.get_buf().get_buf();
+    REQUIRE (bytes.size() == chops::encoded_size<big_fmt>(many));
+    REQUIRE (hbuf.digest() == chops::hash64(bytes));
+    std::vector<std::uint16_t> decoded;
+    chops::read_cursor<std::endian::big> hcur(bytes);
+    REQUIRE (chops::try_unmarshall<big_fmt>(hcur, decoded) == chops::decode_error::none);
+    REQUIRE (decoded == many);
+  }
+}
+
+// counts allocations, so that growth of a container decoded chunk by chunk is visible
+template <typename T>
+struct counting_alloc {
+  using value_type = T;
+  std::size_t* m_cnt;
+  explicit counting_alloc(std::size_t* cnt) noexcept : m_cnt(cnt) { }
+  template <typename U>
+  counting_alloc(const counting_alloc<U>& other) noexcept : m_cnt(other.m_cnt) { }
+  T* allocate(std::size_t n) { ++*m_cnt; return std::allocator<T>().allocate(n); }
+  void deallocate(T* p, std::size_t n) noexcept { std::allocator<T>().deallocate(p, n); }
+  bool operator==(const counting_alloc&) const noexcept = default;
+};
+
+TEST_CASE ( "Chunked sequence decoding of a large count", "[chunked_seq_fmt]" ) {
+  using chunk_fmt = chops::chunked_seq_fmt<std::uint8_t, std::uint32_t, 64u>;
+
+  std::vector<std::uint32_t> vals(1000000u);
+  for (std::size_t i {0u}; i < vals.size(); ++i) {
+    vals[i] = static_cast<std::uint32_t>(i * 2654435761u);
+  }
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::little> buf;
+  chops::marshall<chunk_fmt>(buf, vals);
+
+  // capacity grows geometrically, not once per chunk
+  std::size_t num_allocs {0u};
+  std::vector<std::uint32_t, counting_alloc<std::uint32_t>> out { counting_alloc<std::uint32_t>(&num_allocs) };
+  chops::read_cursor<std::endian::little> cur(buf.data(), buf.size());
+  REQUIRE (chops::try_unmarshall<chunk_fmt>(cur, out) == chops::decode_error::none);
+  REQUIRE (cur.remaining() == 0u);
+  REQUIRE (num_allocs < 32u);
+  REQUIRE (std::equal(out.cbegin(), out.cend(), vals.cbegin(), vals.cend()));
+}
+
+struct byte_sink {
+  void operator()(std::span<const std::byte>) const noexcept { }
+};
+
+template <typename Buf>
+concept chunk_marshallable = requires (Buf& buf, const std::vector<std::uint16_t>& vals) {
+  chops::marshall_chunked<std::uint16_t, std::uint16_t>(buf, vals, byte_sink { }, 64u);
+};
+
+TEST_CASE ( "Chunked marshalling of a generator", "[marshall_chunked]" ) {
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<std::uint32_t>(buf, 0xFEEDu); // header sent with the first chunk
+  std::vector<std::byte> out;
+  std::size_t num_chunks {0u};
+  std::size_t max_chunk {0u};
+  auto num = chops::marshall_chunked<std::uint16_t, row_fmt>(buf, rows(10000u),
+      [&] (std::span<const std::byte> bytes) {
+        out.insert(out.end(), bytes.begin(), bytes.end());
+        ++num_chunks;
+        max_chunk = std::max(max_chunk, bytes.size());
+      }, 1024u);
+  REQUIRE (num == 10000u);
+  REQUIRE (num_chunks > 100u);
+  REQUIRE (max_chunk < 1024u + 2u + 4u + 20u + 2u); // memory is bounded by the chunk size
+  REQUIRE (buf.size() == 0u);
+
+  chops::read_cursor<std::endian::big> cur(out);
+  std::uint32_t hdr {0u};
+  chops::unmarshall<std::uint32_t>(cur, hdr);
+  REQUIRE (hdr == 0xFEEDu);
+  std::vector<row> decoded;
+  REQUIRE (chops::try_unmarshall<chops::chunked_seq_fmt<std::uint16_t, row_fmt>>(cur, decoded) ==
+           chops::decode_error::none);
+  REQUIRE (cur.remaining() == 0u);
+  REQUIRE (decoded.size() == 10000u);
+  REQUIRE (decoded[9999].id == 9999u);
+  REQUIRE (decoded[9999].name.size() == 9999u % 20u);
+
+  // a lazy view, and a chunk count limited by the count type
+  std::vector<std::byte> out2;
+  num = chops::marshall_chunked<std::uint8_t, std::uint32_t>(buf,
+      std::views::iota(0u, 1000u) | std::views::filter([] (unsigned i) { return i % 2u == 0u; }),
+      [&] (std::span<const std::byte> bytes) { out2.insert(out2.end(), bytes.begin(), bytes.end()); }, 1u << 20);
+  REQUIRE (num == 500u);
+  REQUIRE (out2.size() == 500u * 4u + 3u); // chunks of 255 and 245, then the zero count
+  std::vector<std::uint32_t> evens;
+  chops::extract_buffer<std::endian::big> src(out2.data(), out2.size());
+  chops::unmarshall<chops::chunked_seq_fmt<std::uint8_t, std::uint32_t>>(src, evens);
+  REQUIRE (evens.size() == 500u);
+  REQUIRE (evens[499] == 998u);
+
+  // each chunk is removed from the buffer, so a buffer that processes bytes as they are
+  // appended is rejected, and the sink checksums the chunks instead
+  using plain_buf = chops::expandable_buffer<std::vector<std::byte>, std::endian::big>;
+  static_assert(chunk_marshallable<plain_buf>);
+  static_assert(!chunk_marshallable<chops::crc32c_buffer<plain_buf>>);
+  static_assert(!chunk_marshallable<chops::hashing_buffer<plain_buf>>);
+  std::vector<std::byte> out3;
+  std::uint32_t crc {0u};
+  chops::marshall_chunked<std::uint16_t, row_fmt>(buf, rows(2000u),
+      [&] (std::span<const std::byte> bytes) {
+        crc = chops::crc32c(bytes, crc);
+        out3.insert(out3.end(), bytes.begin(), bytes.end());
+      }, 256u);
+  REQUIRE (crc == chops::crc32c(out3));
+
+  // the format itself is marshalled through a crc32c_buffer, from a single pass range
+  using crc_fmt = chops::chunked_seq_fmt<std::uint16_t, std::uint16_t, 50u>;
+  std::vector<std::uint16_t> vals(2000u);
+  for (std::size_t i {0u}; i < vals.size(); ++i) {
+    vals[i] = static_cast<std::uint16_t>(i * 7u);
+  }
+  chops::crc32c_buffer<plain_buf> cbuf;
+  chops::marshall<crc_fmt>(cbuf, input_vals { vals });
+  cbuf.append_checksum();
+  chops::crc32c_cursor<std::endian::big> ccur(cbuf.get_buf().get_buf());
+  std::vector<std::uint16_t> checked;
+  REQUIRE (chops::try_unmarshall<crc_fmt>(ccur, checked) == chops::decode_error::none);
+  REQUIRE (ccur.verify() == chops::decode_error::none);
+  REQUIRE (checked == vals);
+}
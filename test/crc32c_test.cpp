@@ -0,0 +1,144 @@
+/** @file
+ *
+ * @brief Test scenarios for @c crc32c, @c crc32c_buffer, and @c crc32c_cursor.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <span>
+#include <stdexcept> // std::length_error
+#include <bit> // std::endian
+
+#include "serialize/crc32c.hpp"
+#include "serialize/binary_serialize.hpp"
+
+std::span<const std::byte> as_bytes(const std::string& str) {
+  return std::as_bytes(std::span(str.data(), str.size()));
+}
+
+struct frame {
+  std::uint16_t              kind;
+  std::string                name;
+  std::vector<std::uint32_t> vals;
+};
+
+using frame_fmt = chops::fields_fmt<std::uint16_t, chops::seq_fmt<std::uint16_t, char>,
+                                    chops::seq_fmt<std::uint32_t, std::uint32_t>>;
+
+TEST_CASE ( "CRC32C checksum", "[crc32c]" ) {
+  // standard check values
+  REQUIRE (chops::crc32c(as_bytes("123456789")) == 0xE3069283u);
+  REQUIRE (chops::crc32c(as_bytes("")) == 0u);
+  REQUIRE (chops::crc32c(std::vector<std::byte>(32u, std::byte{0x00})) == 0x8A9136AAu);
+  REQUIRE (chops::crc32c(std::vector<std::byte>(32u, std::byte{0xFF})) == 0x62A8AB43u);
+
+  std::string text;
+  for (int i {0}; i < 1000; ++i) {
+    text += std::to_string(i * 7919);
+  }
+  auto all = chops::crc32c(as_bytes(text));
+  auto bytes = as_bytes(text);
+  for (std::size_t split : { 0u, 1u, 7u, 8u, 9u, 100u, 1001u }) {
+    REQUIRE (chops::crc32c(bytes.subspan(split), chops::crc32c(bytes.first(split))) == all);
+  }
+  // the portable and hardware implementations agree
+  REQUIRE (~chops::detail::crc32c_sw(~0u, bytes.data(), bytes.size()) == all);
+  STATIC_REQUIRE (chops::detail::crc32c_tables[0][128] == chops::detail::crc32c_poly);
+}
+
+TEST_CASE ( "Checksummed frames", "[crc32c_buffer]" ) {
+
+  std::vector<frame> frames;
+  for (std::uint16_t i {0u}; i < 50u; ++i) {
+    frames.push_back( frame { i, "frame " + std::to_string(i), std::vector<std::uint32_t>(i * 13u, i * 3u) } );
+  }
+
+  chops::crc32c_buffer<chops::expandable_buffer<std::vector<std::byte>, std::endian::big>> buf;
+  std::vector<std::size_t> ends;
+  for (const auto& f : frames) {
+    auto start = buf.size();
+    chops::marshall<frame_fmt>(buf, f);
+    auto crc = buf.append_checksum();
+    ends.push_back(buf.size());
+    auto bytes = std::span<const std::byte>(buf.data() + start, ends.back() - start - 4u);
+    REQUIRE (crc == chops::crc32c(bytes));
+  }
+  const auto& stream = buf.get_buf().get_buf();
+
+  chops::crc32c_cursor<std::endian::big> cur(stream);
+  for (const auto& f : frames) {
+    frame out { };
+    chops::unmarshall<frame_fmt>(cur, out);
+    REQUIRE (cur.verify() == chops::decode_error::none);
+    REQUIRE (out.kind == f.kind);
+    REQUIRE (out.name == f.name);
+    REQUIRE (out.vals == f.vals);
+  }
+  REQUIRE (cur.remaining() == 0u);
+
+  // a flipped bit in any frame is detected
+  for (std::size_t pos : { std::size_t{5u}, std::size_t{40u}, ends[20] - 5u, stream.size() - 1u }) {
+    auto bad = stream;
+    bad[pos] ^= std::byte{0x01};
+    chops::crc32c_cursor<std::endian::big> bad_cur(bad);
+    auto err = chops::decode_error::none;
+    for (std::size_t i {0u}; i < frames.size() && err == chops::decode_error::none; ++i) {
+      frame out { };
+      chops::unmarshall<frame_fmt>(bad_cur, out);
+      err = bad_cur.verify();
+    }
+    REQUIRE (err == chops::decode_error::checksum_mismatch);
+    REQUIRE (bad_cur.remaining() == 0u);
+  }
+
+  chops::crc32c_cursor<std::endian::big> trunc(stream.data(), ends[0] - 2u);
+  frame out { };
+  REQUIRE (chops::try_unmarshall<frame_fmt>(trunc, out) == chops::decode_error::none);
+  REQUIRE (trunc.verify() == chops::decode_error::truncated);
+}
+
+TEST_CASE ( "Checksummed length prefixed frames", "[crc32c_buffer]" ) {
+
+  std::vector<frame> frames;
+  for (std::uint16_t i {0u}; i < 10u; ++i) {
+    frames.push_back( frame { i, "frame " + std::to_string(i), std::vector<std::uint32_t>(i * 7u, i) } );
+  }
+
+  // the length can not be back-patched, so it is computed before the frame is appended
+  chops::crc32c_buffer<chops::expandable_buffer<std::vector<std::byte>, std::endian::big>> buf;
+  for (const auto& f : frames) {
+    chops::marshall_framed<std::uint32_t, frame_fmt>(buf, f);
+    buf.append_checksum();
+  }
+  const auto& stream = buf.get_buf().get_buf();
+
+  chops::crc32c_cursor<std::endian::big> cur(stream);
+  for (const auto& f : frames) {
+    std::uint32_t len {0u};
+    frame out { };
+    chops::unmarshall<std::uint32_t>(cur, len);
+    REQUIRE (len == chops::encoded_size<frame_fmt>(f));
+    chops::unmarshall<frame_fmt>(cur, out);
+    REQUIRE (cur.verify() == chops::decode_error::none);
+    REQUIRE (out.name == f.name);
+    REQUIRE (out.vals == f.vals);
+  }
+  REQUIRE (cur.remaining() == 0u);
+
+  // a value too long for the length throws before anything is appended
+  auto old_sz = buf.size();
+  REQUIRE_THROWS_AS ((chops::marshall_framed<std::uint8_t, frame_fmt>(buf, frames.back())), std::length_error);
+  REQUIRE (buf.size() == old_sz);
+}
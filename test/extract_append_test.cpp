@@ -118,6 +118,31 @@ TEST_CASE ( "Extract values from a buffer", "[extract_val]" ) {
 }
 
 
+TEST_CASE ( "Append and extract arrays of values", "[append_vals] [extract_vals]" ) {
+
+  constexpr std::uint32_t vals[] { 0x04030201u, 0x08070605u, 0x0C0B0A09u };
+  std::byte buf[sizeof(vals)];
+
+  SECTION ("Append_vals and extract_vals, big endian") {
+    REQUIRE (chops::append_vals<std::endian::big>(buf, vals, 3u) == 12u);
+    REQUIRE (std::to_integer<int>(buf[0]) == 0x04);
+    REQUIRE (std::to_integer<int>(buf[3]) == 0x01);
+    REQUIRE (std::to_integer<int>(buf[11]) == 0x09);
+    std::uint32_t out[3] { };
+    REQUIRE (chops::extract_vals<std::endian::big>(buf, out, 3u) == 12u);
+    chops::repeat(3, [&] (int i) { REQUIRE (out[i] == vals[i]); } );
+  }
+  SECTION ("Append_vals and extract_vals, little endian") {
+    REQUIRE (chops::append_vals<std::endian::little>(buf, vals, 3u) == 12u);
+    REQUIRE (std::to_integer<int>(buf[0]) == 0x01);
+    REQUIRE (std::to_integer<int>(buf[3]) == 0x04);
+    REQUIRE (std::to_integer<int>(buf[11]) == 0x0C);
+    std::uint32_t out[3] { };
+    REQUIRE (chops::extract_vals<std::endian::little>(buf, out, 3u) == 12u);
+    chops::repeat(3, [&] (int i) { REQUIRE (out[i] == vals[i]); } );
+  }
+}
+
 template <typename Dest, typename Src>
 void test_round_trip_var_int (Src src, std::size_t exp_sz) {
   std::byte test_buf [10];
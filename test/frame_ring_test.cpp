@@ -0,0 +1,211 @@
+/** @file
+ *
+ * @brief Test scenarios for @c frame_ring.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdexcept> // std::length_error
+#include <bit> // std::endian
+
+#include "serialize/frame_ring.hpp"
+#include "serialize/binary_serialize.hpp"
+
+struct note {
+  std::uint16_t producer;
+  std::uint32_t seq;
+  std::string   text;
+};
+
+using note_fmt = chops::fields_fmt<std::uint16_t, std::uint32_t, chops::seq_fmt<std::uint8_t, char>>;
+
+template <typename Ring>
+std::vector<note> drain(Ring& ring) {
+  std::vector<note> notes;
+  for (auto frames = ring.read(); !frames.empty(); frames = ring.read()) {
+    std::vector<std::span<const std::byte>> index;
+    REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(frames, index) == chops::decode_error::none);
+    for (auto f : index) {
+      chops::read_cursor<std::endian::big> cur(f);
+      note n { };
+      REQUIRE (chops::try_unmarshall<note_fmt>(cur, n) == chops::decode_error::none);
+      REQUIRE (cur.remaining() == 0u);
+      notes.push_back(n);
+    }
+    ring.release(frames.size());
+  }
+  return notes;
+}
+
+TEST_CASE ( "Frame ring, single thread", "[frame_ring]" ) {
+  chops::frame_ring<std::endian::big, std::uint16_t> ring(200u);
+  REQUIRE (ring.capacity() == 256u);
+  REQUIRE (ring.read().empty());
+
+  std::uint32_t pushed {0u};
+  std::uint32_t received {0u};
+  for (int round {0}; round < 50; ++round) {
+    while (ring.try_push<note_fmt>(note { 1u, pushed, std::string(pushed % 37u, 'n') })) {
+      ++pushed;
+    }
+    for (const auto& n : drain(ring)) {
+      REQUIRE (n.seq == received);
+      REQUIRE (n.text.size() == received % 37u);
+      ++received;
+    }
+    REQUIRE (received == pushed);
+  }
+  REQUIRE (pushed > 50u * 4u);
+
+  // serialize in place through the slot cursor
+  auto s = ring.try_reserve(6u);
+  REQUIRE (s);
+  chops::marshall<std::uint16_t>(s->cursor(), std::uint16_t{3u});
+  chops::marshall<std::uint32_t>(s->cursor(), 77u);
+  REQUIRE (ring.read().empty());
+  REQUIRE (s->cursor().size() == 6u);
+  ring.commit(*s);
+  auto frames = ring.read();
+  REQUIRE (frames.size() == 8u);
+  REQUIRE (frames[1] == std::byte{6u});
+  ring.release(frames.size());
+
+  // reserved space is not available until released by the consumer
+  chops::frame_ring<std::endian::big, std::uint16_t> small(256u);
+  auto big = small.try_reserve(200u);
+  REQUIRE (big);
+  REQUIRE (!small.try_reserve(100u));
+  big->cursor().resize(200u);
+  small.commit(*big);
+  REQUIRE (!small.try_reserve(100u));
+  REQUIRE (small.read().size() == 202u);
+  small.release(202u);
+  // the frame does not fit before the end, so it wraps to the start
+  auto wrapped = small.try_reserve(100u);
+  REQUIRE (wrapped);
+  wrapped->cursor().resize(100u);
+  small.commit(*wrapped);
+  frames = small.read();
+  REQUIRE (frames.size() == 102u);
+  REQUIRE (frames[1] == std::byte{100u});
+  small.release(102u);
+  REQUIRE (small.read().empty());
+}
+
+TEST_CASE ( "Frame ring, frame sizes", "[frame_ring]" ) {
+  chops::frame_ring<std::endian::big, std::uint8_t> ring(1024u);
+  REQUIRE_THROWS_AS (ring.try_reserve(256u), std::length_error);
+  REQUIRE_THROWS_AS (ring.try_push<note_fmt>(note { 1u, 0u, std::string(250u, 'n') }), std::length_error);
+  auto s = ring.try_reserve(255u);
+  REQUIRE (s);
+  s->cursor().resize(255u);
+  ring.commit(*s);
+  auto frames = ring.read();
+  REQUIRE (frames.size() == 256u);
+  REQUIRE (frames[0] == std::byte{255u});
+  ring.release(frames.size());
+
+  chops::frame_ring<std::endian::big, std::uint16_t> small(256u);
+  REQUIRE_THROWS_AS (small.try_reserve(255u), std::length_error);
+  REQUIRE (small.try_reserve(254u));
+}
+
+TEST_CASE ( "Frame ring, marshalling throws", "[frame_ring]" ) {
+  // the text count does not fit in a std::uint8_t, which is only found when marshalling
+  const note bad { 1u, 0u, std::string(300u, 'x') };
+
+  chops::frame_ring<std::endian::big, std::uint16_t> ring(1024u);
+  REQUIRE (ring.try_push<note_fmt>(note { 1u, 1u, "a" }));
+  REQUIRE_THROWS_AS (ring.try_push<note_fmt>(bad), std::length_error);
+  REQUIRE (ring.try_push<note_fmt>(note { 1u, 2u, "b" }));
+  auto notes = drain(ring);
+  REQUIRE (notes.size() == 2u);
+  REQUIRE (notes[1].seq == 2u);
+
+  // a cancelled frame that can not be returned is skipped by the consumer
+  chops::frame_ring<std::endian::big, std::uint16_t, true> multi(1024u);
+  const note c { 2u, 3u, "c" };
+  auto first = multi.try_reserve(10u);
+  auto second = multi.try_reserve(chops::encoded_size<note_fmt>(c));
+  REQUIRE (first);
+  REQUIRE (second);
+  multi.cancel(*first);
+  chops::marshall<note_fmt>(second->cursor(), c);
+  multi.commit(*second);
+  notes = drain(multi);
+  REQUIRE (notes.size() == 1u);
+  REQUIRE (notes[0].seq == 3u);
+  REQUIRE_THROWS_AS (multi.try_push<note_fmt>(bad), std::length_error);
+  REQUIRE (multi.try_push<note_fmt>(note { 2u, 4u, "d" }));
+  notes = drain(multi);
+  REQUIRE (notes.size() == 1u);
+  REQUIRE (notes[0].seq == 4u);
+}
+
+// every fail_every-th note of each producer throws when marshalled and is not received
+template <bool MultiProducer>
+void run_threads(std::uint16_t num_producers, std::uint32_t per_producer, std::uint32_t fail_every = 0u) {
+  auto fails = [fail_every] (std::uint32_t i) { return fail_every != 0u && i % fail_every == fail_every - 1u; };
+  chops::frame_ring<std::endian::big, std::uint16_t, MultiProducer> ring(4096u);
+  std::vector<std::jthread> producers;
+  for (std::uint16_t p {0u}; p < num_producers; ++p) {
+    producers.emplace_back([&ring, &fails, p, per_producer] {
+      for (std::uint32_t i {0u}; i < per_producer; ++i) {
+        if (fails(i)) {
+          try {
+            ring.template try_push<note_fmt>(note { p, i, std::string(300u, 'x') });
+          }
+          catch (const std::length_error&) { }
+          continue;
+        }
+        note n { p, i, std::string(i % 50u, static_cast<char>('a' + p)) };
+        while (!ring.template try_push<note_fmt>(n)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::uint32_t expected {0u};
+  for (std::uint32_t i {0u}; i < per_producer; ++i) {
+    expected += fails(i) ? 0u : num_producers;
+  }
+  std::vector<std::uint32_t> next(num_producers, 0u);
+  std::uint32_t total {0u};
+  while (total < expected) {
+    auto notes = drain(ring);
+    for (const auto& n : notes) {
+      REQUIRE (n.producer < num_producers);
+      REQUIRE (n.seq == next[n.producer]); // per producer order is preserved
+      REQUIRE (n.text == std::string(n.seq % 50u, static_cast<char>('a' + n.producer)));
+      ++next[n.producer];
+      while (fails(next[n.producer])) {
+        ++next[n.producer];
+      }
+    }
+    total += static_cast<std::uint32_t>(notes.size());
+    if (notes.empty()) {
+      std::this_thread::yield();
+    }
+  }
+  REQUIRE (ring.read().empty());
+}
+
+TEST_CASE ( "Frame ring, producer and consumer threads", "[frame_ring]" ) {
+  run_threads<false>(1u, 20000u);
+  run_threads<true>(4u, 5000u);
+  run_threads<false>(1u, 20000u, 7u);
+  run_threads<true>(4u, 5000u, 7u);
+}
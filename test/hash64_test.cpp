@@ -0,0 +1,96 @@
+/** @file
+ *
+ * @brief Test scenarios for @c hash64, @c hash64_state, and @c hashing_buffer.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint64_t, etc
+#include <vector>
+#include <string>
+#include <span>
+#include <set>
+#include <bit> // std::endian
+
+#include "serialize/hash64.hpp"
+#include "serialize/binary_serialize.hpp"
+
+std::span<const std::byte> as_bytes(const std::string& str) {
+  return std::as_bytes(std::span(str.data(), str.size()));
+}
+
+struct event {
+  std::uint32_t id;
+  std::string   text;
+};
+
+using event_fmt = chops::fields_fmt<std::uint32_t, chops::seq_fmt<std::uint16_t, char>>;
+
+TEST_CASE ( "64 bit hash", "[hash64]" ) {
+  // reference XXH64 values
+  REQUIRE (chops::hash64(as_bytes("")) == 0xEF46DB3751D8E999ull);
+  REQUIRE (chops::hash64(as_bytes("a")) == 0xD24EC4F1A98C6E5Bull);
+  REQUIRE (chops::hash64(as_bytes("abc")) == 0x44BC2CF5AD770999ull);
+
+  std::string text;
+  for (int i {0}; i < 500; ++i) {
+    text += std::to_string(i * 104729);
+  }
+  auto bytes = as_bytes(text);
+  auto all = chops::hash64(bytes, 17u);
+  REQUIRE (all != chops::hash64(bytes));
+  // any split into updates gives the same hash
+  for (std::size_t step : { 1u, 3u, 8u, 31u, 32u, 33u, 1000u }) {
+    chops::hash64_state state(17u);
+    for (std::size_t pos {0u}; pos < bytes.size(); pos += step) {
+      state.update(bytes.subspan(pos, std::min(step, bytes.size() - pos)));
+    }
+    REQUIRE (state.digest() == all);
+  }
+  // every length around the stripe boundaries
+  std::set<std::uint64_t> hashes;
+  for (std::size_t len {0u}; len <= 70u; ++len) {
+    hashes.insert(chops::hash64(bytes.first(len)));
+  }
+  REQUIRE (hashes.size() == 71u);
+}
+
+TEST_CASE ( "Hashing buffer", "[hashing_buffer]" ) {
+  std::vector<event> events;
+  for (std::uint32_t i {0u}; i < 300u; ++i) {
+    events.push_back( event { i % 100u, std::string(i % 100u * 3u, 'x') } );
+  }
+
+  chops::hashing_buffer<chops::expandable_buffer<std::vector<std::byte>, std::endian::big>> buf(99u);
+  std::set<std::uint64_t> seen;
+  std::size_t dups {0u};
+  for (const auto& e : events) {
+    buf.restart();
+    auto start = buf.size();
+    chops::marshall<event_fmt>(buf, e);
+    auto h = buf.digest();
+    REQUIRE (h == chops::hash64(std::span<const std::byte>(buf.data() + start, buf.size() - start), 99u));
+    if (!seen.insert(h).second) {
+      ++dups;
+    }
+  }
+  REQUIRE (seen.size() == 100u);
+  REQUIRE (dups == 200u);
+
+  // hash of everything appended
+  chops::hashing_buffer<chops::expandable_buffer<std::vector<std::byte>>> all_buf;
+  for (const auto& e : events) {
+    chops::marshall<event_fmt>(all_buf, e);
+  }
+  REQUIRE (all_buf.size() > 2u * chops::hash64_block_size);
+  REQUIRE (all_buf.digest() == chops::hash64(all_buf.get_buf().get_buf()));
+}
@@ -0,0 +1,256 @@
+/** @file
+ *
+ * @brief Test scenarios for the LZ block codec, @c compressing_buffer, and
+ * @c decompressing_cursor.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <optional>
+#include <string_view>
+#include <algorithm> // std::min, std::equal
+#include <bit> // std::endian
+
+#include "serialize/lz_compress.hpp"
+#include "serialize/string_table.hpp"
+#include "serialize/binary_serialize.hpp"
+
+std::vector<std::byte> make_bytes(std::size_t sz, unsigned seed, bool text) {
+  std::vector<std::byte> bytes;
+  std::uint32_t state {seed};
+  const std::string words[] { "alpha ", "beta ", "gamma ", "delta ", "epsilon " };
+  while (bytes.size() < sz) {
+    state = state * 1664525u + 1013904223u;
+    if (text) {
+      for (char c : words[(state >> 16) % 5u]) {
+        bytes.push_back(static_cast<std::byte>(c));
+      }
+    }
+    else {
+      bytes.push_back(static_cast<std::byte>(state >> 24));
+    }
+  }
+  bytes.resize(sz);
+  return bytes;
+}
+
+std::optional<std::vector<std::byte>> round_trip(const std::vector<std::byte>& in, std::size_t& csz) {
+  std::vector<std::byte> comp(chops::lz_compress_bound(in.size()));
+  csz = chops::lz_compress(in.data(), in.size(), comp.data());
+  REQUIRE (csz <= comp.size());
+  std::vector<std::byte> out(in.size());
+  auto res = chops::lz_decompress(comp.data(), csz, out.data(), out.size());
+  if (!res || *res != in.size()) {
+    return { };
+  }
+  return { out };
+}
+
+struct reading {
+  std::uint32_t       id;
+  std::string         site;
+  std::vector<std::int32_t> samples;
+};
+
+using reading_fmt = chops::fields_fmt<std::uint32_t, chops::seq_fmt<std::uint16_t, char>,
+                                      chops::seq_fmt<std::uint16_t, std::int32_t>>;
+
+TEST_CASE ( "LZ block codec", "[lz_compress]" ) {
+  std::size_t csz {0u};
+
+  for (std::size_t sz : { 0u, 1u, 3u, 4u, 5u, 17u, 300u, 70000u }) {
+    auto text = make_bytes(sz, 7u, true);
+    REQUIRE (round_trip(text, csz) == text);
+    auto noise = make_bytes(sz, 9u, false);
+    REQUIRE (round_trip(noise, csz) == noise);
+    REQUIRE (csz <= chops::lz_compress_bound(sz));
+  }
+
+  auto text = make_bytes(100000u, 3u, true);
+  REQUIRE (round_trip(text, csz) == text);
+  REQUIRE (csz < text.size() / 2u);
+
+  // long runs use overlapping matches and extended lengths
+  std::vector<std::byte> run(5000u, std::byte{0x2A});
+  REQUIRE (round_trip(run, csz) == run);
+  REQUIRE (csz < 40u);
+
+  // malformed input is rejected, never read or written out of bounds
+  std::vector<std::byte> comp(chops::lz_compress_bound(text.size()));
+  csz = chops::lz_compress(text.data(), text.size(), comp.data());
+  std::vector<std::byte> out(text.size());
+  REQUIRE (!chops::lz_decompress(comp.data(), csz, out.data(), out.size() - 1u));
+  for (std::size_t i {1u}; i < csz; i += 97u) {
+    auto res = chops::lz_decompress(comp.data(), i, out.data(), out.size());
+    REQUIRE ((!res || *res < text.size()));
+  }
+  for (std::size_t i {0u}; i < csz; i += 13u) {
+    auto bad = comp;
+    bad[i] ^= std::byte{0xFF};
+    auto res = chops::lz_decompress(bad.data(), csz, out.data(), out.size());
+    REQUIRE ((!res || *res <= out.size()));
+  }
+  const std::byte zero_offset[] { std::byte{0x10}, std::byte{0x41}, std::byte{0x00}, std::byte{0x00} };
+  REQUIRE (!chops::lz_decompress(zero_offset, 4u, out.data(), out.size()));
+  REQUIRE (!chops::lz_decompress(zero_offset, 0u, out.data(), out.size()));
+}
+
+TEST_CASE ( "Compressing buffer and decompressing cursor", "[compressing_buffer]" ) {
+
+  std::vector<reading> readings;
+  for (std::uint32_t i {0u}; i < 2000u; ++i) {
+    readings.push_back( reading { i, "site-" + std::to_string(i % 10u), std::vector<std::int32_t>(i % 17u, static_cast<std::int32_t>(i % 4u) - 2) } );
+  }
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> plain;
+  chops::compressing_buffer<std::vector<std::byte>, std::endian::big> buf(4096u);
+  for (const auto& r : readings) {
+    chops::marshall<reading_fmt>(plain, r);
+    chops::marshall<reading_fmt>(buf, r);
+  }
+  REQUIRE (buf.uncompressed_size() == plain.size());
+  const auto& stream = buf.finish();
+  REQUIRE (buf.uncompressed_size() == plain.size());
+  REQUIRE (stream.size() < plain.size() / 2u);
+
+  // values span blocks, which are decompressed as needed
+  chops::decompressing_cursor<std::endian::big> src(stream);
+  for (const auto& r : readings) {
+    reading out { };
+    REQUIRE (chops::try_unmarshall<reading_fmt>(src, out) == chops::decode_error::none);
+    REQUIRE (out.id == r.id);
+    REQUIRE (out.site == r.site);
+    REQUIRE (out.samples == r.samples);
+    REQUIRE (src.remaining() < 4096u + 17u * sizeof(std::int32_t) + 32u);
+  }
+  REQUIRE (src.at_end());
+
+  chops::decompressing_cursor<std::endian::big> vsrc(stream);
+  for (std::size_t i {0u}; i < readings.size(); ++i) {
+    REQUIRE (chops::validate<reading_fmt>(vsrc) == chops::decode_error::none);
+  }
+  REQUIRE (vsrc.at_end());
+
+  // incompressible blocks are stored
+  chops::compressing_buffer<> noise_buf(1024u);
+  auto noise = make_bytes(3000u, 5u, false);
+  chops::marshall_buf(noise_buf, noise.size(), noise.data());
+  const auto& noise_stream = noise_buf.finish();
+  REQUIRE (noise_stream.size() == noise.size() + 8u);
+  chops::decompressing_cursor<> nsrc(noise_stream);
+  REQUIRE (nsrc.ensure(noise.size()));
+  REQUIRE (std::vector<std::byte>(nsrc.data(), nsrc.data() + noise.size()) == noise);
+
+  // errors are reported, not asserted
+  reading out { };
+  chops::decompressing_cursor<std::endian::big> trunc(std::span(stream.data(), stream.size() - 5u));
+  chops::decode_error err {chops::decode_error::none};
+  while (err == chops::decode_error::none) {
+    err = chops::try_unmarshall<reading_fmt>(trunc, out);
+  }
+  REQUIRE (err == chops::decode_error::invalid_value);
+  REQUIRE (trunc.remaining() == 0u);
+
+  auto bad = stream;
+  bad[1] ^= std::byte{0x5A}; // first block header
+  chops::decompressing_cursor<std::endian::big> bad_src(bad);
+  err = chops::decode_error::none;
+  for (std::size_t i {0u}; i < readings.size() && err == chops::decode_error::none; ++i) {
+    err = chops::validate<reading_fmt>(bad_src);
+  }
+  REQUIRE (err == chops::decode_error::invalid_value);
+
+  chops::decompressing_cursor<std::endian::big> small(stream, 1000u);
+  REQUIRE (chops::try_unmarshall<reading_fmt>(small, out) == chops::decode_error::invalid_value);
+
+  std::vector<std::byte> empty;
+  chops::decompressing_cursor<> esrc(empty);
+  REQUIRE (esrc.at_end());
+  REQUIRE (chops::try_unmarshall<reading_fmt>(esrc, out) == chops::decode_error::truncated);
+}
+
+
+// a stateful codec, plugged in to count the blocks compressed and decompressed
+struct counting_codec : chops::lz_codec {
+  int* m_cnt;
+  std::size_t compress(const std::byte* src, std::size_t sz, std::byte* dst) const noexcept {
+    ++*m_cnt;
+    return chops::lz_codec::compress(src, sz, dst);
+  }
+  std::optional<std::size_t> decompress(const std::byte* src, std::size_t sz,
+                                        std::byte* dst, std::size_t dst_cap) const noexcept {
+    ++*m_cnt;
+    return chops::lz_codec::decompress(src, sz, dst, dst_cap);
+  }
+};
+
+TEST_CASE ( "Compressing buffer and decompressing cursor with a codec policy", "[compressing_buffer]" ) {
+
+  static_assert (chops::block_codec<chops::lz_codec>);
+  static_assert (chops::block_codec<counting_codec>);
+
+  int compressed {0};
+  int decompressed {0};
+  chops::compressing_buffer<std::vector<std::byte>, std::endian::big, counting_codec> buf(1024u, counting_codec { { }, &compressed });
+  for (std::uint32_t i {0u}; i < 500u; ++i) {
+    chops::marshall<reading_fmt>(buf, reading { i, "site", std::vector<std::int32_t>(3u, 7) });
+  }
+  const auto& stream = buf.finish();
+  REQUIRE (compressed > 1);
+
+  chops::decompressing_cursor<std::endian::big, counting_codec> src(stream, 1u << 24, counting_codec { { }, &decompressed });
+  for (std::uint32_t i {0u}; i < 500u; ++i) {
+    reading out { };
+    REQUIRE (chops::try_unmarshall<reading_fmt>(src, out) == chops::decode_error::none);
+    REQUIRE (out.id == i);
+  }
+  REQUIRE (src.at_end());
+  REQUIRE (decompressed == compressed);
+}
+
+TEST_CASE ( "Decompressing cursor with a dictionary split across blocks", "[decompressing_cursor]" ) {
+
+  using dict_fmt = chops::dict_seq_fmt<std::uint16_t, std::uint8_t>;
+  static_assert (!chops::has_stable_data<chops::decompressing_cursor<>>);
+  static_assert (chops::has_stable_data<chops::read_cursor<>>);
+
+  std::vector<std::string> hosts;
+  for (int i {0}; i < 400; ++i) {
+    hosts.push_back("host-" + std::to_string(i % 40) + ".example.com");
+  }
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::little> plain;
+  chops::marshall<dict_fmt>(plain, hosts);
+
+  // small pieces and small blocks, so block boundaries fall within the dictionary
+  chops::compressing_buffer<> buf(64u);
+  for (std::size_t i {0u}; i < plain.size(); i += 7u) {
+    chops::marshall_buf(buf, std::min<std::size_t>(7u, plain.size() - i), plain.data() + i);
+  }
+  const auto& stream = buf.finish();
+
+  chops::decompressing_cursor<> src(stream);
+  std::vector<std::string> out;
+  REQUIRE (chops::try_unmarshall<dict_fmt>(src, out) == chops::decode_error::none);
+  REQUIRE (src.at_end());
+  REQUIRE (out == hosts);
+
+  chops::string_table table;
+  std::vector<std::string_view> views;
+  chops::interning_buffer isrc(chops::decompressing_cursor<>(stream), table);
+  REQUIRE (chops::try_unmarshall<dict_fmt>(isrc, views) == chops::decode_error::none);
+  REQUIRE (table.size() == 40u);
+  REQUIRE (std::equal(views.cbegin(), views.cend(), hosts.cbegin(), hosts.cend()));
+}
@@ -0,0 +1,161 @@
+/** @file
+ *
+ * @brief Test scenarios for parallel serialization.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <string>
+#include <optional>
+#include <stdexcept> // std::length_error
+#include <algorithm> // std::equal
+#include <bit> // std::endian
+
+#include "serialize/parallel_serialize.hpp"
+#include "serialize/binary_serialize.hpp"
+
+struct record {
+  std::uint64_t            id;
+  std::string              name;
+  std::optional<std::int16_t> level;
+};
+
+using record_fmt = chops::fields_fmt<std::uint64_t, chops::seq_fmt<std::uint8_t, char>,
+                                     chops::opt_fmt<std::uint8_t, std::int16_t>>;
+
+template <typename ElemFmt, std::endian Endian, typename Ctr>
+void check_parallel(const Ctr& ctr) {
+  chops::expandable_buffer<std::vector<std::byte>, Endian> expected;
+  chops::marshall<chops::seq_fmt<std::uint32_t, ElemFmt>>(expected, ctr);
+  for (std::size_t threads : { 0u, 1u, 2u, 4u, 7u }) {
+    chops::expandable_buffer<std::vector<std::byte>, Endian> buf;
+    chops::marshall<std::uint16_t>(buf, std::uint16_t{0xABCDu}); // existing contents are kept
+    chops::marshall_seq_parallel<std::uint32_t, ElemFmt>(buf, ctr, threads);
+    REQUIRE (buf.size() == expected.size() + 2u);
+    REQUIRE (std::equal(expected.get_buf().begin(), expected.get_buf().end(), buf.get_buf().begin() + 2));
+  }
+}
+
+TEST_CASE ( "Parallel sequence serialization", "[marshall_seq_parallel]" ) {
+
+  std::vector<record> records;
+  for (std::uint64_t i {0u}; i < 50000u; ++i) {
+    records.push_back( record { i * 31u, std::string(i % 23u, static_cast<char>('a' + i % 26u)),
+                       (i % 3u == 0u) ? std::optional<std::int16_t>{} : std::optional<std::int16_t>(static_cast<std::int16_t>(i)) } );
+  }
+  check_parallel<record_fmt, std::endian::big>(records);
+
+  std::vector<std::uint32_t> vals;
+  for (std::uint32_t i {0u}; i < 30001u; ++i) {
+    vals.push_back(i * 2654435761u);
+  }
+  check_parallel<std::uint32_t, std::endian::little>(vals);
+  check_parallel<std::uint32_t, std::endian::big>(vals);
+
+  check_parallel<record_fmt, std::endian::little>(std::vector<record>{});
+  check_parallel<record_fmt, std::endian::little>(std::vector<record>(10u));
+
+  // round trip
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall_seq_parallel<std::uint32_t, record_fmt>(buf, records, 8u);
+  std::vector<record> out;
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  chops::unmarshall<chops::seq_fmt<std::uint32_t, record_fmt>>(src, out);
+  REQUIRE (out.size() == records.size());
+  REQUIRE (out.back().name == records.back().name);
+  REQUIRE (out[300].level == records[300].level);
+
+  // a count that does not fit the count type throws in all builds
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> over_buf;
+  REQUIRE_THROWS_AS ((chops::marshall_seq_parallel<std::uint8_t, std::uint32_t>(over_buf, vals, 4u)), std::length_error);
+  REQUIRE (over_buf.size() == 0u);
+}
+
+TEST_CASE ( "Parallel decoding of frames", "[unmarshall_frames_parallel]" ) {
+
+  std::vector<record> records;
+  for (std::uint64_t i {0u}; i < 5000u; ++i) {
+    records.push_back( record { i, std::string(i % 40u, 'r'),
+                       (i % 2u == 0u) ? std::optional<std::int16_t>{} : std::optional<std::int16_t>(-7) } );
+  }
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  for (const auto& r : records) {
+    chops::marshall_framed<std::uint16_t, record_fmt>(buf, r);
+  }
+  const auto& batch = buf.get_buf();
+
+  for (std::size_t threads : { 0u, 1u, 3u, 16u }) {
+    std::vector<record> out(3u);
+    REQUIRE (chops::unmarshall_batch_parallel<std::uint16_t, record_fmt, std::endian::big>(batch, out, threads) ==
+             chops::decode_error::none);
+    REQUIRE (out.size() == records.size());
+    for (std::size_t i {0u}; i < out.size(); i += 97u) {
+      REQUIRE (out[i].id == records[i].id);
+      REQUIRE (out[i].name == records[i].name);
+      REQUIRE (out[i].level == records[i].level);
+    }
+  }
+
+  // the first invalid frame is reported, and the frames before it are decoded
+  std::vector<std::span<const std::byte>> frames;
+  REQUIRE (chops::index_frames<std::uint16_t, std::endian::big>(batch, frames) == chops::decode_error::none);
+  auto bad = batch;
+  auto bad_frame = static_cast<std::size_t>(frames[3001].data() - batch.data());
+  bad[bad_frame + 8u] = std::byte{0xFF}; // name length past the end of the frame
+  bad[static_cast<std::size_t>(frames[4500].data() - batch.data()) + 8u] = std::byte{0xFF};
+  std::vector<record> out;
+  REQUIRE (chops::unmarshall_batch_parallel<std::uint16_t, record_fmt, std::endian::big>(bad, out, 4u) ==
+           chops::decode_error::truncated);
+  REQUIRE (out.size() == 3001u);
+
+  REQUIRE (chops::unmarshall_batch_parallel<std::uint16_t, record_fmt, std::endian::big>(
+           std::span(batch.data(), batch.size() - 1u), out, 4u) == chops::decode_error::truncated);
+  REQUIRE (out.size() == records.size() - 1u);
+}
+
+TEST_CASE ( "Parallel functions on a reused worker pool", "[worker_pool]" ) {
+
+  chops::worker_pool pool(4u);
+  REQUIRE (pool.num_threads() == 4u);
+
+  std::vector<std::uint32_t> vals;
+  for (std::uint32_t i {0u}; i < 20000u; ++i) {
+    vals.push_back(i * 2654435761u);
+  }
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> expected;
+  chops::marshall<chops::seq_fmt<std::uint32_t, std::uint32_t>>(expected, vals);
+
+  // many batches decoded on the same threads
+  for (std::uint64_t b {0u}; b < 50u; ++b) {
+    chops::expandable_buffer<std::vector<std::byte>, std::endian::big> seq;
+    chops::marshall_seq_parallel<std::uint32_t, std::uint32_t>(seq, vals, pool);
+    REQUIRE (seq.get_buf() == expected.get_buf());
+
+    std::vector<record> records;
+    for (std::uint64_t i {0u}; i < 1200u; ++i) {
+      records.push_back( record { b * 10000u + i, std::string(i % 9u, 'p'), std::optional<std::int16_t>{} } );
+    }
+    chops::expandable_buffer<std::vector<std::byte>, std::endian::little> batch;
+    for (const auto& r : records) {
+      chops::marshall_framed<std::uint16_t, record_fmt>(batch, r);
+    }
+    std::vector<record> out;
+    REQUIRE (chops::unmarshall_batch_parallel<std::uint16_t, record_fmt>(batch.get_buf(), out, pool) ==
+             chops::decode_error::none);
+    REQUIRE (out.size() == records.size());
+    REQUIRE (out.front().id == records.front().id);
+    REQUIRE (out.back().id == records.back().id);
+    REQUIRE (out.back().name == records.back().name);
+  }
+}
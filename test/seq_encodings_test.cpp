@@ -0,0 +1,219 @@
+/** @file
+ *
+ * @brief Test scenarios for the compact sequence format directives.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint32_t, etc
+#include <vector>
+#include <list>
+#include <array>
+#include <set>
+#include <chrono>
+#include <limits>
+#include <stdexcept> // std::length_error
+#include <bit> // std::endian
+
+#include "serialize/seq_encodings.hpp"
+#include "serialize/binary_serialize.hpp"
+
+template <typename Fmt, std::endian Endian, typename Ctr>
+Ctr round_trip(const Ctr& ctr, std::size_t& sz) {
+  chops::expandable_buffer<std::vector<std::byte>, Endian> buf;
+  chops::marshall<Fmt>(buf, ctr);
+  sz = buf.size();
+  REQUIRE (sz == chops::encoded_size<Fmt>(ctr));
+  REQUIRE (chops::validate<Fmt, Endian>(buf.get_buf()) == chops::decode_error::none);
+  Ctr out;
+  chops::read_cursor<Endian> src(buf.data(), buf.size());
+  REQUIRE (chops::try_unmarshall<Fmt>(src, out) == chops::decode_error::none);
+  REQUIRE (src.remaining() == 0u);
+  // every truncation is detected
+  for (std::size_t i {0u}; i < sz; i += 7u) {
+    Ctr part;
+    chops::read_cursor<Endian> part_src(buf.data(), i);
+    REQUIRE (chops::try_unmarshall<Fmt>(part_src, part) == chops::decode_error::truncated);
+  }
+  return out;
+}
+
+TEST_CASE ( "Frame of reference bit packing", "[for_seq_fmt]" ) {
+
+  using ids_fmt = chops::for_seq_fmt<std::uint32_t, std::uint32_t>;
+  using signed_fmt = chops::for_seq_fmt<std::uint16_t, std::int64_t>;
+
+  std::vector<std::uint32_t> ids;
+  for (std::uint32_t i {0u}; i < 1000u; ++i) {
+    ids.push_back(5000000u + (i * 37u) % 1000u);
+  }
+  std::size_t sz {0u};
+  REQUIRE (round_trip<ids_fmt, std::endian::big>(ids, sz) == ids);
+  // 8 blocks of 10 bits per value
+  REQUIRE (sz == 4u + 8u * 9u + 7u * 160u + (1000u - 7u * 128u) * 10u / 8u);
+
+  const std::vector<long long> vals { -5, std::numeric_limits<long long>::min(), 0, 42,
+                                      std::numeric_limits<long long>::max(), -1 };
+  REQUIRE (round_trip<signed_fmt, std::endian::little>(vals, sz) == vals);
+  REQUIRE (sz == 2u + 9u + 6u * 8u);
+
+  const std::vector<int> same(300u, -7);
+  REQUIRE (round_trip<signed_fmt, std::endian::little>(same, sz) == same);
+  REQUIRE (sz == 2u + 3u * 9u);
+
+  const std::vector<int> empty;
+  REQUIRE (round_trip<signed_fmt, std::endian::big>(empty, sz).empty());
+
+  const std::set<unsigned> uset { 3u, 9u, 1000u, 70000u };
+  REQUIRE (round_trip<ids_fmt, std::endian::big>(uset, sz) == uset);
+
+  // every bit width, including the slow path near the end of a block
+  for (unsigned width {0u}; width <= 64u; ++width) {
+    std::vector<std::uint64_t> wide;
+    for (std::uint64_t i {0u}; i < 130u; ++i) {
+      wide.push_back(width == 0u ? 0u : ((i * 0x9E3779B97F4A7C15ull) >> (64u - width)));
+    }
+    REQUIRE (round_trip<chops::for_seq_fmt<std::uint16_t, std::uint64_t>, std::endian::big>(wide, sz) == wide);
+  }
+}
+
+TEST_CASE ( "Delta and delta-of-delta encoding", "[delta_seq_fmt]" ) {
+
+  using sys_micros = std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds>;
+  using ts_fmt = chops::delta_seq_fmt<std::uint32_t, std::int64_t>;
+  using ts2_fmt = chops::delta_seq_fmt<std::uint32_t, std::int64_t, 2u>;
+
+  std::vector<sys_micros> stamps;
+  const sys_micros start { std::chrono::microseconds { 1700000000123456 } };
+  for (int i {0}; i < 1000; ++i) {
+    stamps.push_back(start + std::chrono::milliseconds(i) + std::chrono::microseconds(i % 3));
+  }
+  std::size_t sz {0u};
+  std::size_t sz2 {0u};
+  REQUIRE (round_trip<ts_fmt, std::endian::big>(stamps, sz) == stamps);
+  REQUIRE (round_trip<ts2_fmt, std::endian::big>(stamps, sz2) == stamps);
+  REQUIRE (sz < stamps.size() * 8u / 10u);
+  REQUIRE (sz2 < stamps.size() * 8u / 10u);
+
+  // a regular interval packs into zero bits per value
+  std::vector<sys_micros> regular;
+  for (int i {0}; i < 1000; ++i) {
+    regular.push_back(start + std::chrono::milliseconds(i));
+  }
+  REQUIRE (round_trip<ts_fmt, std::endian::big>(regular, sz) == regular);
+  REQUIRE (sz == 4u + 8u + 8u * 9u);
+  REQUIRE (round_trip<ts2_fmt, std::endian::big>(regular, sz2) == regular);
+  REQUIRE (sz2 == 4u + 2u * 8u + 8u * 9u);
+
+  // a steadily increasing interval packs into zero bits per value with delta-of-delta
+  std::vector<std::int64_t> accel;
+  for (std::int64_t i {0}; i < 1000; ++i) {
+    accel.push_back(i * i * 3);
+  }
+  REQUIRE (round_trip<ts_fmt, std::endian::little>(accel, sz) == accel);
+  REQUIRE (round_trip<ts2_fmt, std::endian::little>(accel, sz2) == accel);
+  REQUIRE (sz2 == 4u + 2u * 8u + 8u * 9u);
+  REQUIRE (sz2 < sz);
+
+  const std::list<int> mixed { 100, -100, 5, std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 0 };
+  REQUIRE (round_trip<chops::delta_seq_fmt<std::uint8_t, std::int32_t>, std::endian::little>(mixed, sz) == mixed);
+  REQUIRE (round_trip<chops::delta_seq_fmt<std::uint8_t, std::int32_t, 2u>, std::endian::little>(mixed, sz) == mixed);
+
+  const std::vector<unsigned> one { 42u };
+  REQUIRE (round_trip<chops::delta_seq_fmt<std::uint8_t, std::uint32_t, 2u>, std::endian::little>(one, sz) == one);
+  REQUIRE (sz == 1u + 4u);
+
+  // an untrusted count is rejected before allocating
+  const std::vector<std::byte> huge { std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF} };
+  std::vector<std::int64_t> out;
+  chops::read_cursor<std::endian::big> src(huge);
+  REQUIRE (chops::try_unmarshall<ts_fmt>(src, out) == chops::decode_error::truncated);
+  REQUIRE (out.capacity() == 0u);
+
+  // a count that does not fit the count type throws in all builds
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::little> over_buf;
+  const std::vector<int> over(256u, 1);
+  using small_delta_fmt = chops::delta_seq_fmt<std::uint8_t, std::int32_t>;
+  using small_for_fmt = chops::for_seq_fmt<std::uint8_t, std::int32_t>;
+  REQUIRE_THROWS_AS (chops::marshall<small_delta_fmt>(over_buf, over), std::length_error);
+  REQUIRE_THROWS_AS (chops::marshall<small_for_fmt>(over_buf, over), std::length_error);
+  REQUIRE (over_buf.size() == 0u);
+}
+
+struct cell {
+  short  row;
+  short  col;
+
+  bool operator==(const cell&) const = default;
+};
+
+TEST_CASE ( "Run-length encoding", "[rle_seq_fmt]" ) {
+
+  using sensor_fmt = chops::rle_seq_fmt<std::uint32_t, std::int16_t>;
+  using cell_fmt = chops::rle_seq_fmt<std::uint16_t, chops::fields_fmt<std::int16_t, std::int16_t>>;
+
+  std::vector<short> sensor(10000u, 0);
+  for (std::size_t i {5000u}; i < 5100u; ++i) {
+    sensor[i] = 7;
+  }
+  sensor[9999u] = -1;
+  std::size_t sz {0u};
+  REQUIRE (round_trip<sensor_fmt, std::endian::big>(sensor, sz) == sensor);
+  // runs of 5000, 100, 4899, 1
+  REQUIRE (sz == 4u + 4u * 2u + 2u + 1u + 2u + 1u);
+
+  const std::list<cell> cells { { 1, 2 }, { 1, 2 }, { 1, 2 }, { 3, 4 }, { 1, 2 } };
+  REQUIRE (round_trip<cell_fmt, std::endian::little>(cells, sz) == cells);
+  REQUIRE (sz == 2u + 3u * (4u + 1u));
+
+  const std::vector<bool> flags { true, true, false, false, false, true };
+  REQUIRE (round_trip<chops::rle_seq_fmt<std::uint8_t, std::uint8_t>, std::endian::little>(flags, sz) == flags);
+
+  const std::vector<int> empty;
+  REQUIRE (round_trip<chops::rle_seq_fmt<std::uint8_t, std::int32_t>, std::endian::big>(empty, sz).empty());
+
+  // a few bytes cannot expand beyond the maximum count
+  using small_fmt = chops::rle_seq_fmt<std::uint32_t, std::uint8_t, 1000u>;
+  std::vector<std::uint8_t> out;
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<chops::rle_seq_fmt<std::uint32_t, std::uint8_t>>(buf, std::vector<std::uint8_t>(2000u, 1u));
+  REQUIRE (buf.size() == 4u + 1u + 2u);
+  chops::read_cursor<std::endian::big> src(buf.data(), buf.size());
+  REQUIRE (chops::try_unmarshall<small_fmt>(src, out) == chops::decode_error::count_too_large);
+  REQUIRE (chops::validate<small_fmt, std::endian::big>(buf.get_buf()) == chops::decode_error::count_too_large);
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> over_buf;
+  REQUIRE_THROWS_AS (chops::marshall<small_fmt>(over_buf, std::vector<std::uint8_t>(1001u, 1u)), std::length_error);
+  REQUIRE (over_buf.size() == 0u);
+
+  // a run longer than the remaining count, and a zero length run
+  auto bad = buf.get_buf();
+  bad[2] = std::byte{0x00};
+  bad[3] = std::byte{0x10};
+  REQUIRE (chops::validate<small_fmt, std::endian::big>(bad) == chops::decode_error::invalid_value);
+  bad[5] = std::byte{0x00};
+  bad[6] = std::byte{0x00};
+  bad.pop_back();
+  chops::read_cursor<std::endian::big> bad_src(bad);
+  REQUIRE (chops::try_unmarshall<small_fmt>(bad_src, out) == chops::decode_error::invalid_value);
+
+  {
+    // a huge count in a short buffer
+    const std::array<std::byte, 9> huge { std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF},
+                                          std::byte{0xFF}, std::byte{0xFF}, std::byte{0xFF}, std::byte{0xF0},
+                                          std::byte{0x01} };
+    chops::read_cursor<std::endian::big> cur(huge);
+    std::vector<std::int32_t> vals;
+    REQUIRE (chops::try_unmarshall<chops::rle_seq_fmt<std::uint64_t, std::int32_t>>(cur, vals) ==
+             chops::decode_error::truncated);
+    REQUIRE (vals.empty());
+  }
+}
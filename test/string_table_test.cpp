@@ -0,0 +1,173 @@
+/** @file
+ *
+ * @brief Test scenarios for @c string_table and the @c interned_fmt format directive.
+ *
+ * @author Cliff Green
+ *
+ * @copyright (c) 2024 by Cliff Green
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <cstddef> // std::byte
+#include <cstdint> // std::uint8_t, etc
+#include <vector>
+#include <string>
+#include <string_view>
+#include <bit> // std::endian
+#include <algorithm> // std::fill
+#include <stdexcept> // std::length_error
+
+#include "serialize/string_table.hpp"
+#include "serialize/binary_serialize.hpp"
+
+struct quote {
+  std::string_view symbol;
+  std::uint32_t    price;
+  std::string_view venue;
+};
+
+using quote_fmt = chops::fields_fmt<chops::interned_fmt<std::uint8_t>, std::uint32_t,
+                                    chops::interned_fmt<std::uint8_t>>;
+
+TEST_CASE ( "String table", "[string_table]" ) {
+  chops::string_table table;
+  auto id1 = table.intern("IBM");
+  std::string tmp { "AAPL" };
+  auto id2 = table.intern(tmp);
+  tmp = "IBM";
+  REQUIRE (table.intern(tmp) == id1);
+  REQUIRE (id1 != id2);
+  REQUIRE (table.size() == 2u);
+  REQUIRE (table.view(id2) == "AAPL");
+  REQUIRE (table.view(id2).data() != tmp.data());
+  REQUIRE (table.find("AAPL") == id2);
+  REQUIRE (!table.find("MSFT"));
+  REQUIRE (table.view(table.intern("")).empty());
+
+  // views remain valid as the table grows
+  auto ibm = table.view(id1);
+  for (int i {0}; i < 1000; ++i) {
+    table.intern(std::to_string(i));
+  }
+  REQUIRE (ibm == "IBM");
+  REQUIRE (table.view(id1).data() == ibm.data());
+  table.clear();
+  REQUIRE (table.size() == 0u);
+}
+
+TEST_CASE ( "Interned string format", "[interned_fmt]" ) {
+
+  using quotes_fmt = chops::seq_fmt<std::uint16_t, quote_fmt>;
+
+  const std::vector<quote> quotes { { "IBM", 100u, "NYSE" }, { "AAPL", 200u, "NASDAQ" },
+                                    { "IBM", 101u, "NYSE" }, { "AAPL", 201u, "NYSE" } };
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<quotes_fmt>(buf, quotes);
+  REQUIRE (buf.size() == chops::encoded_size<quotes_fmt>(quotes));
+  // same wire format as a sequence of chars
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> seq_buf;
+  chops::marshall<chops::seq_fmt<std::uint8_t, char>>(seq_buf, std::string("IBM"));
+  REQUIRE (std::equal(seq_buf.get_buf().cbegin(), seq_buf.get_buf().cend(), buf.get_buf().cbegin() + 2));
+
+  REQUIRE (chops::validate<quotes_fmt, std::endian::big>(buf.get_buf()) == chops::decode_error::none);
+
+  chops::string_table table;
+  std::vector<quote> out;
+  chops::interning_buffer src(chops::extract_buffer<std::endian::big>(buf.data(), buf.size()), table);
+  chops::unmarshall<quotes_fmt>(src, out);
+  REQUIRE (src.remaining() == 0u);
+  REQUIRE (table.size() == 4u);
+  // the views refer to the table, not the buffer
+  std::fill(buf.get_buf().begin(), buf.get_buf().end(), std::byte{0});
+  REQUIRE (out.size() == quotes.size());
+  REQUIRE (out[2].symbol == "IBM");
+  REQUIRE (out[3].venue == "NYSE");
+  REQUIRE (out[0].symbol.data() == out[2].symbol.data());
+  REQUIRE (out[3].price == 201u);
+
+  // decoding to ids, through a bounds-checked cursor
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> sym_buf;
+  chops::marshall<chops::seq_fmt<std::uint8_t, chops::interned_fmt<std::uint8_t>>>(sym_buf,
+      std::vector<std::string> { "MSFT", "IBM", "MSFT" });
+  std::vector<chops::string_table::id_type> ids;
+  chops::interning_buffer cur(chops::read_cursor<std::endian::big>(sym_buf.data(), sym_buf.size()), table);
+  REQUIRE (chops::try_unmarshall<chops::seq_fmt<std::uint8_t, chops::interned_fmt<std::uint8_t>>>(cur, ids) ==
+           chops::decode_error::none);
+  REQUIRE (ids.size() == 3u);
+  REQUIRE (ids[0] == ids[2]);
+  REQUIRE (table.view(ids[0]) == "MSFT");
+  REQUIRE (table.view(ids[1]) == "IBM");
+  REQUIRE (table.size() == 5u);
+
+  chops::interning_buffer short_cur(chops::read_cursor<std::endian::big>(sym_buf.data(), 4u), table);
+  REQUIRE (chops::try_unmarshall<chops::seq_fmt<std::uint8_t, chops::interned_fmt<std::uint8_t>>>(short_cur, ids) ==
+           chops::decode_error::truncated);
+  REQUIRE (table.size() == 5u);
+}
+
+TEST_CASE ( "Dictionary encoded string sequence", "[dict_seq_fmt]" ) {
+
+  using dict_fmt = chops::dict_seq_fmt<std::uint16_t, std::uint8_t>;
+
+  std::vector<std::string> hosts;
+  for (int i {0}; i < 300; ++i) {
+    hosts.push_back(i % 3 == 0 ? "alpha.example.com" : (i % 3 == 1 ? "beta.example.com" : "gamma.example.com"));
+  }
+  hosts.push_back("delta.example.com");
+
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> buf;
+  chops::marshall<dict_fmt>(buf, hosts);
+  // 4 distinct strings, one byte per index
+  REQUIRE (buf.size() == 2u + (4u + 17u + 16u + 17u + 17u) + 2u + 301u);
+  REQUIRE (buf.size() == chops::encoded_size<dict_fmt>(hosts));
+  REQUIRE (buf.size() * 10u < chops::encoded_size<chops::seq_fmt<std::uint16_t,
+                                  chops::seq_fmt<std::uint8_t, char>>>(hosts));
+  REQUIRE (chops::validate<dict_fmt, std::endian::big>(buf.get_buf()) == chops::decode_error::none);
+
+  std::vector<std::string> out(2u, std::string(40u, 'x'));
+  const char* out_data = out[0].data();
+  chops::extract_buffer<std::endian::big> src(buf.data(), buf.size());
+  chops::unmarshall<dict_fmt>(src, out);
+  REQUIRE (src.remaining() == 0u);
+  REQUIRE (out == hosts);
+  REQUIRE (out[0].data() == out_data);
+
+  chops::string_table table;
+  std::vector<std::string_view> views;
+  chops::interning_buffer isrc(chops::read_cursor<std::endian::big>(buf.data(), buf.size()), table);
+  REQUIRE (chops::try_unmarshall<dict_fmt>(isrc, views) == chops::decode_error::none);
+  REQUIRE (table.size() == 4u);
+  REQUIRE (std::equal(views.cbegin(), views.cend(), hosts.cbegin(), hosts.cend()));
+
+  // indices beyond 127 use two bytes
+  std::vector<std::string> many;
+  for (int i {0}; i < 200; ++i) {
+    many.push_back(std::to_string(i));
+  }
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::little> many_buf;
+  chops::marshall<dict_fmt>(many_buf, many);
+  std::vector<std::string> many_out;
+  chops::extract_buffer<std::endian::little> many_src(many_buf.data(), many_buf.size());
+  chops::unmarshall<dict_fmt>(many_src, many_out);
+  REQUIRE (many_out == many);
+
+  // an index outside of the dictionary
+  auto bad = buf.get_buf();
+  bad.back() = std::byte{4};
+  REQUIRE (chops::validate<dict_fmt, std::endian::big>(bad) == chops::decode_error::invalid_value);
+  chops::read_cursor<std::endian::big> bad_cur(bad);
+  REQUIRE (chops::try_unmarshall<dict_fmt>(bad_cur, out) == chops::decode_error::invalid_value);
+  bad.pop_back();
+  REQUIRE (chops::validate<dict_fmt, std::endian::big>(bad) == chops::decode_error::truncated);
+
+  // a string or count that does not fit its type throws in all builds
+  chops::expandable_buffer<std::vector<std::byte>, std::endian::big> over_buf;
+  REQUIRE_THROWS_AS (chops::marshall<dict_fmt>(over_buf, std::vector<std::string>(1u, std::string(256u, 'a'))), std::length_error);
+  REQUIRE_THROWS_AS (chops::marshall<dict_fmt>(over_buf, std::vector<std::string>(65536u, "a")), std::length_error);
+  REQUIRE (over_buf.size() == 0u);
+}